@@ -0,0 +1,97 @@
+﻿/**
+ * @file bench_load.cpp
+ * @brief 启动加载微基准：统计引擎加载数据文件并重放操作日志期间的堆分配次数
+ */
+
+#include "../include/engine.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <new>
+#include <string>
+#include <vector>
+
+namespace {
+    std::atomic<unsigned long long> allocations(0);
+    std::atomic<unsigned long long> allocated_bytes(0);
+
+    void copy_file(const std::string &from, const std::string &to) {
+        std::ifstream in(from, std::ios::binary);
+        std::ofstream out(to, std::ios::binary | std::ios::trunc);
+        out << in.rdbuf();
+    }
+
+    Item make_item(const int code, const int quantity) {
+        Item item{"Summer T-Shirt " + std::to_string(code), code, "Coral Red", quantity, {}};
+        item.brand_list.push_back(Brand{"Cotton House", 2 * code, quantity / 2, 89.99});
+        item.brand_list.push_back(Brand{"Simple Style Clothing Co.", 2 * code + 1, quantity - quantity / 2, 12.5});
+        return item;
+    }
+}
+
+
+// 统计全部经由operator new的堆分配
+void *operator new(const std::size_t size) {
+    ++allocations;
+    allocated_bytes += size;
+    void *p = std::malloc(size == 0 ? 1 : size);
+    if (p == nullptr) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+
+void operator delete(void *p) noexcept {
+    std::free(p);
+}
+
+
+int main(int argc, char *argv[]) {
+    const int count = argc > 1 ? std::stoi(argv[1]) : 100000;
+    const int updates = argc > 2 ? std::stoi(argv[2]) : 20000;
+    const std::string data_path = "bench_load_data.csv";
+    const std::string log_path = "bench_load_log.csv";
+    std::remove(data_path.c_str());
+    std::remove(log_path.c_str());
+
+    // 数据文件一次写入，之后的修改留在日志中，保存关闭前的两个文件供加载使用
+    {
+        Engine engine(16, 1 << 30, log_path, data_path);
+        std::vector<Item> batch;
+        batch.reserve(static_cast<std::size_t>(count));
+        for (int code = 0; code < count; ++code) {
+            batch.push_back(make_item(code, code % 500));
+        }
+        engine.bulk_insert(std::move(batch));
+        for (int i = 0; i < updates; ++i) {
+            engine.update(make_item((i * 7919) % count, i));
+        }
+        copy_file(data_path, data_path + ".saved");
+        copy_file(log_path, log_path + ".saved");
+    }
+    copy_file(data_path + ".saved", data_path);
+    copy_file(log_path + ".saved", log_path);
+
+    allocations = 0;
+    allocated_bytes = 0;
+    const auto start = std::chrono::steady_clock::now();
+    {
+        Engine engine(16, 1 << 30, log_path, data_path);
+        const auto elapsed = std::chrono::steady_clock::now() - start;
+        std::cout << "items: " << count << ", logged updates: " << updates << std::endl
+                  << "load: " << std::chrono::duration<double, std::milli>(elapsed).count() << " ms" << std::endl
+                  << "allocations: " << allocations << " (" << static_cast<double>(allocations) / count
+                  << " per item)" << std::endl
+                  << "allocated bytes: " << allocated_bytes << std::endl;
+    }
+
+    for (const auto &path: {data_path, log_path, data_path + ".saved", log_path + ".saved"}) {
+        std::remove(path.c_str());
+    }
+    return 0;
+}
@@ -0,0 +1,114 @@
+﻿/**
+ * @file bench_parser.cpp
+ * @brief ITEM|/BRAND|行解析微基准：对比原istringstream实现与零拷贝解析器
+ */
+
+#include "../include/datatype.h"
+
+#include <chrono>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+    // 暴露受保护的解析接口
+    struct Parser : ReadLogic {
+        using ReadLogic::parse_item_line;
+        using ReadLogic::parse_brand_line;
+    };
+
+    // 原实现：substr + istringstream + getline + stoi/stof
+    std::string legacy_unescape(const std::string &field) {
+        if (field.size() >= 2 && field.front() == '"' && field.back() == '"') {
+            std::string unescaped;
+            for (size_t i = 1; i < field.size() - 1; ++i) {
+                if (field[i] == '"' && field[i + 1] == '"' && i + 1 < field.size() - 1) {
+                    unescaped += '"';
+                    ++i;
+                } else {
+                    unescaped += field[i];
+                }
+            }
+            return unescaped;
+        }
+        return field;
+    }
+
+    Item legacy_parse_item(const std::string &line) {
+        std::istringstream iss(line.substr(5));
+        std::string token;
+        Item item;
+        std::getline(iss, token, ',');
+        item.name = legacy_unescape(token);
+        std::getline(iss, token, ',');
+        item.code = std::stoi(token);
+        std::getline(iss, token, ',');
+        item.colour = legacy_unescape(token);
+        std::getline(iss, token);
+        item.quantity = std::stoi(token);
+        return item;
+    }
+
+    Brand legacy_parse_brand(const std::string &line) {
+        std::istringstream iss(line.substr(6));
+        std::string token;
+        Brand brand;
+        std::getline(iss, token, ',');
+        brand.name = legacy_unescape(token);
+        std::getline(iss, token, ',');
+        brand.code = std::stoi(token);
+        std::getline(iss, token, ',');
+        brand.quantity = std::stoi(token);
+        std::getline(iss, token);
+        brand.price = std::stof(token);
+        return brand;
+    }
+
+    template<typename Function>
+    double measure(const char *label, const size_t lines, Function function) {
+        const auto start = std::chrono::steady_clock::now();
+        const long long checksum = function();
+        const auto elapsed = std::chrono::steady_clock::now() - start;
+
+        const double ns = std::chrono::duration<double, std::nano>(elapsed).count() / static_cast<double>(lines);
+        std::cout << label << ": " << ns << " ns/line (checksum " << checksum << ")" << std::endl;
+        return ns;
+    }
+}
+
+
+int main(int argc, char *argv[]) {
+    const int count = argc > 1 ? std::stoi(argv[1]) : 200000;
+
+    // 构造与数据文件相同格式的测试行：每个商品两条品牌
+    std::vector<std::string> lines;
+    lines.reserve(static_cast<size_t>(count) * 3);
+    for (int i = 0; i < count; ++i) {
+        lines.push_back("ITEM|Summer T-Shirt " + std::to_string(i) + "," + std::to_string(1000 + i) + ",Coral Red," +
+                        std::to_string(i % 500));
+        lines.push_back("BRAND|Cotton House," + std::to_string(2000 + i) + ",80,89.99");
+        lines.push_back("BRAND|\"Simple \"\"Style\"\"\"," + std::to_string(3000 + i) + ",70,1234.5");
+    }
+
+    const double legacy = measure("istringstream", lines.size(), [&lines] {
+        long long checksum = 0;
+        for (const auto &line: lines) {
+            checksum += line[0] == 'I' ? legacy_parse_item(line).code : legacy_parse_brand(line).code;
+        }
+        return checksum;
+    });
+
+    const double fast = measure("zero-copy    ", lines.size(), [&lines] {
+        long long checksum = 0;
+        for (const auto &line: lines) {
+            checksum += line[0] == 'I'
+                            ? Parser::parse_item_line(line.data(), line.size()).code
+                            : Parser::parse_brand_line(line.data(), line.size()).code;
+        }
+        return checksum;
+    });
+
+    std::cout << "speedup: " << legacy / fast << "x" << std::endl;
+    return 0;
+}
@@ -7,7 +7,10 @@
 #define CACHE_H
 
 #include "datatype.h"
+#include "intern.h"
 
+#include <cstdint>
+#include <memory>
 #include <unordered_map>
 #include <list>
 
@@ -23,8 +26,14 @@ private:
     /// @brief 商品编码到链表迭代器的映射表（key: 商品编码，value: 链表迭代器）
     std::unordered_map<int, std::list<Item>::iterator> code_to_item;
 
-    /// @brief 商品名称到链表迭代器的映射表（key: 商品名称，value: 链表迭代器）
-    std::unordered_map<std::string, std::list<Item>::iterator> name_to_item;
+    /// @brief 商品名称到链表迭代器的映射表（key: 商品名称的驻留编号，value: 链表迭代器）
+    std::unordered_map<std::uint32_t, std::list<Item>::iterator> name_to_item;
+
+    /// @brief 未指定驻留池时自有的驻留池
+    std::unique_ptr<StringPool> own_pool;
+
+    /// @brief 商品名称所在的字符串驻留池
+    StringPool *pool;
 
     /// @brief 维护商品访问顺序的双向链表（最新访问的在前）
     std::list<Item> cache;
@@ -32,6 +41,20 @@ private:
     /// @brief 缓存最大容量限制（默认10）
     int max_cache = 10;
 
+    /**
+     * @brief 记录名称到链表节点的映射
+     * @param name 商品名称
+     * @param iter 链表节点
+     */
+    void put_name(const std::string &name, std::list<Item>::iterator iter);
+
+    /**
+     * @brief 删除指向指定节点的名称映射并归还其驻留引用
+     * @param name 商品名称
+     * @param iter 链表节点
+     */
+    void erase_name(const std::string &name, std::list<Item>::iterator iter);
+
 public:
     /**
      * @brief 构造函数初始化缓存容量
@@ -39,6 +62,13 @@ public:
      */
     explicit LRUCache(int max_cache_number);
 
+    /**
+     * @brief 构造与其他组件共用驻留池的缓存
+     * @param max_cache_number 缓存最大容量
+     * @param shared_pool 字符串驻留池，生命周期不短于本对象
+     */
+    LRUCache(int max_cache_number, StringPool &shared_pool);
+
     /**
      * @brief 插入或更新缓存项
      * @param item 要插入的商品对象
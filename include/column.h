@@ -0,0 +1,127 @@
+﻿/**
+ * @file column.h
+ * @brief 列式内存镜像定义头文件（商品与品牌字段按列连续存放）
+ */
+
+#ifndef COLUMN_H
+#define COLUMN_H
+
+#include "datatype.h"
+#include "intern.h"
+#include "region.h"
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+
+/**
+ * @class ColumnStore
+ * @brief 商品数据的列式镜像，供只涉及少数字段的扫描与聚合使用
+ *
+ * 商品级字段每列一个连续数组，按行号对齐；品牌级字段同样按列存放，每行记录所属商品的行号，
+ * 同一商品的品牌连续存放。色调与品牌名称以引擎共用的字符串驻留池编号存放，比较只需整数相等，
+ * 每个有效行对其编号各持有一次引用，行失效时归还；商品名称已由Index维护，这里不重复存放。
+ * 删除只标记行失效，失效行多于有效行时整体压缩，均摊O(1)
+ */
+class ColumnStore {
+private:
+    /// @brief 商品编码 → 有效行号，节点从当前一代的Region分配
+    using RowIndex = std::unordered_map<int, std::uint32_t, std::hash<int>, std::equal_to<int>,
+                                        RegionAllocator<std::pair<const int, std::uint32_t>>>;
+    std::unique_ptr<Region> generation; ///< 编码索引所在的内存区域，压缩与清空时整体换新
+    RowIndex row_of; ///< 商品编码 → 有效行号
+
+    std::vector<int> codes; ///< 商品编码列
+    std::vector<int> quantities; ///< 商品总库存列
+    std::vector<std::uint32_t> colour_ids; ///< 商品色调列（驻留编号）
+    std::vector<std::uint32_t> brand_begins; ///< 商品第一个品牌所在的品牌行号
+    std::vector<std::uint32_t> brand_counts; ///< 商品关联品牌数量列
+    std::vector<bool> live; ///< 商品行是否有效
+
+    std::vector<std::uint32_t> brand_owners; ///< 品牌所属商品的行号
+    std::vector<int> brand_codes; ///< 品牌编码列
+    std::vector<std::uint32_t> brand_name_ids; ///< 品牌名称列（驻留编号）
+    std::vector<int> brand_quantities; ///< 品牌库存列
+    std::vector<double> brand_prices; ///< 品牌单价列
+
+    StringPool *strings; ///< 色调与品牌名称所在的驻留池
+
+    /**
+     * @brief 归还一行对色调与品牌名称的驻留引用
+     * @param row 行号
+     */
+    void release_row(std::uint32_t row);
+
+    /// @brief 删除失效行，行号随之重新分配；编码索引在新的Region中重建，删除留下的节点随旧Region一次释放
+    void compact();
+
+public:
+    /**
+     * @brief 构造列式镜像
+     * @param pool 字符串驻留池，生命周期不短于本对象
+     */
+    explicit ColumnStore(StringPool &pool);
+
+    /**
+     * @brief 插入或替换商品
+     * @param item 商品数据
+     * @note 编码已存在时原行失效，新数据追加到末尾
+     */
+    void upsert(const Item &item);
+
+    /**
+     * @brief 删除商品
+     * @param code 商品编码
+     * @return 商品存在时返回true
+     */
+    bool remove(int code);
+
+    /// @brief 清空全部数据
+    void clear();
+
+    /// @brief 有效商品数量
+    std::size_t size() const;
+
+    /**
+     * @brief 统计全部商品的总库存
+     * @return 商品总库存之和
+     * @note 只顺序读取库存列与有效标记
+     */
+    long long total_quantity() const;
+
+    /**
+     * @brief 统计全部品牌的库存金额
+     * @return 各品牌单价与库存乘积之和
+     * @note 只顺序读取品牌的单价、库存与所属行号
+     */
+    double stock_value() const;
+
+    /**
+     * @brief 查找库存低于阈值的商品
+     * @param threshold 库存阈值
+     * @return 商品编码，按行号顺序排列
+     */
+    std::vector<int> codes_below_quantity(int threshold) const;
+
+    /**
+     * @brief 查找关联了指定品牌的商品
+     * @param brand_name 品牌名称
+     * @return 商品编码，按行号顺序排列，每个商品一次
+     * @note 名称先换成驻留编号，扫描时只比较整数
+     */
+    std::vector<int> codes_with_brand(const std::string &brand_name) const;
+
+    /**
+     * @brief 按色调汇总库存
+     * @return (色调, 总库存)，按色调首次出现的顺序排列
+     * @note 以驻留编号为键累加，不比较字符串
+     */
+    std::vector<std::pair<std::string, long long>> quantity_by_colour() const;
+};
+
+#endif //COLUMN_H
@@ -6,8 +6,13 @@
 #ifndef DATATYPE_H
 #define DATATYPE_H
 
+#include <cstddef>
 #include <string>
 #include <list>
+#include <vector>
+#include <functional>
+#include <initializer_list>
+#include <utility>
 
 constexpr int MAX_NUMBER = 10; ///< 商品品牌最大数量限制
 
@@ -27,6 +32,103 @@ struct Brand {
 };
 
 
+/**
+ * @class BrandList
+ * @brief 商品关联品牌的小容量内联容器
+ *
+ * 前INLINE_CAPACITY个品牌直接存放在对象内部，不为每个品牌单独分配节点，遍历时连续访问。
+ * 品牌更多的商品整体迁入堆上的连续数组（按MAX_NUMBER预留），迭代接口保持不变
+ */
+class BrandList {
+public:
+    static constexpr std::size_t INLINE_CAPACITY = 2; ///< 内联存储的品牌数量
+
+private:
+    Brand inline_brands[INLINE_CAPACITY]; ///< 内联品牌存储
+    std::vector<Brand> spilled; ///< 超过INLINE_CAPACITY时全部品牌改存于此（前count个有效）
+    std::size_t count = 0; ///< 当前品牌数量
+
+    /// @brief 内联存储已满时将全部品牌迁入堆上数组
+    void spill();
+
+public:
+    using value_type = Brand;
+    using iterator = Brand *;
+    using const_iterator = const Brand *;
+
+    BrandList() = default;
+
+    /**
+     * @brief 以品牌列表初始化
+     * @param brands 品牌数据
+     */
+    BrandList(std::initializer_list<Brand> brands);
+
+    BrandList(const BrandList &other);
+
+    BrandList(BrandList &&other) noexcept;
+
+    BrandList &operator=(const BrandList &other);
+
+    BrandList &operator=(BrandList &&other) noexcept;
+
+    Brand *data() { return spilled.empty() ? inline_brands : spilled.data(); }
+    const Brand *data() const { return spilled.empty() ? inline_brands : spilled.data(); }
+
+    iterator begin() { return data(); }
+    iterator end() { return data() + count; }
+    const_iterator begin() const { return data(); }
+    const_iterator end() const { return data() + count; }
+
+    std::size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+
+    Brand &front() { return data()[0]; }
+    const Brand &front() const { return data()[0]; }
+    Brand &back() { return data()[count - 1]; }
+    const Brand &back() const { return data()[count - 1]; }
+
+    /**
+     * @brief 追加品牌
+     * @param brand 品牌数据
+     */
+    void push_back(const Brand &brand);
+
+    /**
+     * @brief 追加品牌
+     * @param brand 品牌数据
+     */
+    void push_back(Brand &&brand);
+
+    /**
+     * @brief 以参数构造品牌并追加
+     * @param args 品牌字段或品牌对象
+     * @return 新追加的品牌
+     */
+    template<typename... Args>
+    Brand &emplace_back(Args &&... args) {
+        push_back(Brand{std::forward<Args>(args)...});
+        return back();
+    }
+
+    /**
+     * @brief 在末尾追加一个位置并返回其上的品牌对象
+     * @return 新位置上的品牌，保留此前在该位置的字符串容量，调用方须覆盖全部字段
+     */
+    Brand &append();
+
+    /**
+     * @brief 清空全部品牌
+     * @note 已溢出的列表保留堆上的品牌对象与存储方式，之后append()复用其容量
+     */
+    void clear();
+
+    bool operator==(const BrandList &other) const;
+
+    bool operator!=(const BrandList &other) const { return !(*this == other); }
+};
+
+
 /**
  * @struct Item
  * @brief 商品数据结构
@@ -36,25 +138,26 @@ struct Item {
     int code; ///< 商品编码
     std::string colour; ///< 商品色调
     int quantity; ///< 商品总库存
-    std::list<Brand> brand_list; ///< 关联品牌列表（最大10个）
-    int brand_number; ///< 当前关联品牌数量
+    BrandList brand_list; ///< 关联品牌列表（最大10个）
+
+    /// @brief 当前关联品牌数量，由brand_list得出
+    int brand_number() const { return static_cast<int>(brand_list.size()); }
 
     bool operator==(const Item& other) const {
         return code == other.code && name == other.name && colour == other.colour && quantity == other.quantity &&
-            brand_list == other.brand_list && brand_number == other.brand_number;
+            brand_list == other.brand_list;
     }
 };
 
 
-class ReadLogic {
-private:
-    /**
-        * @brief 反转义CSV字段
-        * @param field 转义后的CSV字段
-        * @return 原始字段内容
-        */
-    static std::string unescape_csv_field(const std::string &field);
+/// @brief 逐条访问商品的回调
+using ItemVisitor = std::function<void(const Item &)>;
+
+/// @brief 商品数据来源：按商品编码升序对每个商品调用一次访问回调
+using ItemSource = std::function<void(const ItemVisitor &)>;
 
+
+class ReadLogic {
 protected:
     /**
      * @brief 解析品牌CSV行
@@ -63,28 +166,100 @@ protected:
      */
     static Brand parse_brand_line(const std::string &line);
 
+    /**
+     * @brief 解析品牌CSV行
+     * @param data 行首指针（以"BRAND|"开头）
+     * @param length 行长度（不含换行符）
+     * @return 解析后的Brand对象
+     * @note 直接在原缓冲区上解析，不复制整行；仅带引号的字段需要反转义
+     * @throw std::invalid_argument 数值字段不是数字
+     */
+    static Brand parse_brand_line(const char *data, size_t length);
+
+    /**
+     * @brief 解析品牌CSV行到已有对象
+     * @param data 行首指针（以"BRAND|"开头）
+     * @param length 行长度（不含换行符）
+     * @param brand 输出品牌，覆盖全部字段并复用其名称字符串的容量
+     * @throw std::invalid_argument 数值字段不是数字
+     */
+    static void parse_brand_line(const char *data, size_t length, Brand &brand);
+
     /**
      * @brief 解析商品CSV行
      * @param line CSV格式字符串
      * @return 解析后的Item对象
      */
     static Item parse_item_line(const std::string &line);
+
+    /**
+     * @brief 解析商品CSV行
+     * @param data 行首指针（以"ITEM|"开头）
+     * @param length 行长度（不含换行符）
+     * @return 解析后的Item对象
+     * @note 直接在原缓冲区上解析，不复制整行；仅带引号的字段需要反转义
+     * @throw std::invalid_argument 数值字段不是数字
+     */
+    static Item parse_item_line(const char *data, size_t length);
+
+    /**
+     * @brief 解析商品CSV行到已有对象
+     * @param data 行首指针（以"ITEM|"开头）
+     * @param length 行长度（不含换行符）
+     * @param item 输出商品，覆盖全部字段并清空品牌列表；名称与色调复用已有容量
+     * @note 逐行扫描时反复解析进同一个对象，字符串不必每行重新分配
+     * @throw std::invalid_argument 数值字段不是数字
+     */
+    static void parse_item_line(const char *data, size_t length, Item &item);
+
+    /**
+     * @brief 解析商品负载（ITEM|行及其后的BRAND|行，以换行分隔）
+     * @param data 负载起始地址
+     * @param length 负载字节数
+     * @return 解析后的Item对象
+     * @throw std::invalid_argument 数值字段不是数字
+     */
+    static Item parse_item_payload(const char *data, size_t length);
 };
 
 
 class WriteLogic {
 private:
     /**
-        * @brief 转义CSV字段特殊字符
+        * @brief 转义CSV字段特殊字符并追加到输出缓冲
+        * @param out 输出缓冲
         * @param field 原始字段字符串
-        * @return 转义后的合规CSV字段
         * @details 处理规则：
-        * - 包含逗号、换行符、双引号时添加外围双引号
+        * - 包含逗号、双引号时添加外围双引号
         * - 内部双引号转换为两个连续双引号
         */
-    static std::string escape_csv_field(const std::string &field);
+    static void append_csv_field(std::string &out, const std::string &field);
 
 protected:
+    /**
+     * @brief 将Brand对象序列化为CSV行并追加到输出缓冲
+     * @param out 输出缓冲（不追加换行符）
+     * @param brand 品牌数据对象
+     * @note 数值直接格式化进缓冲，不经过流
+     */
+    static void append_brand_csv(std::string &out, const Brand &brand);
+
+    /**
+     * @brief 将Item对象序列化为CSV行并追加到输出缓冲
+     * @param out 输出缓冲（不追加换行符）
+     * @param item 商品数据对象
+     * @note 关联的Brand数据需单独追加
+     */
+    static void append_item_csv(std::string &out, const Item &item);
+
+    /**
+     * @brief 将商品及其品牌编码为负载并追加到输出缓冲
+     * @param out 输出缓冲
+     * @param item 商品数据对象
+     * @note ITEM|行在前，每个品牌一行BRAND|，以换行分隔，末尾不追加换行符
+     */
+    static void append_item_payload(std::string &out, const Item &item);
+
     /**
      * @brief 序列化Brand对象为CSV行
      * @param brand 品牌数据对象
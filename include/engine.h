@@ -6,17 +6,35 @@
 #ifndef ENGINE_H
 #define ENGINE_H
 
+#include <cstdint>
 #include <functional>
+#include <map>
+#include <memory>
+#include <unordered_map>
+#include <vector>
 
 #include "datatype.h"
 #include "persister.h"
 #include "cache.h"
+#include "column.h"
 #include "index.h"
+#include "intern.h"
+#include "region.h"
 
 
 class Engine;
 
 
+/**
+ * @struct EngineConfig
+ * @brief 数据引擎配置
+ */
+struct EngineConfig {
+    bool demand_paging = false; ///< 大于内存模式：只常驻编码→快照记录目录与名称索引，商品访问时从内存映射的快照读入缓存
+    PersistConfig persist; ///< 持久层配置（按需加载模式下固定为快照格式、前台检查点、不分片）
+};
+
+
 /**
  * @class QueryBuilder
  * @brief 提供链式查询构建功能的工具类
@@ -69,9 +87,139 @@ public:
 class Engine {
 private:
     Persist persist; ///< 持久化操作对象
+    StringPool strings; ///< 字符串驻留池（常驻商品、缓存、索引与列式镜像共用，同一名称只存放一份）
     LRUCache cache; ///< 缓存管理对象
     Index index; ///< 索引管理对象
-    std::list<Item> items; ///< 内存中维护的数据集合
+
+    /**
+     * @struct ResidentBrand
+     * @brief 常驻品牌：名称以驻留编号引用
+     */
+    struct ResidentBrand {
+        std::uint32_t name; ///< 品牌名称（驻留编号）
+        int code; ///< 品牌编码
+        int quantity; ///< 当前库存数量
+        double price; ///< 单品价格
+    };
+
+    /**
+     * @struct ResidentItem
+     * @brief 常驻商品：名称与色调以驻留编号引用，品牌连续存放在品牌数组中
+     */
+    struct ResidentItem {
+        std::uint32_t name; ///< 商品名称（驻留编号）
+        std::uint32_t colour; ///< 商品色调（驻留编号）
+        int code; ///< 商品编码
+        int quantity; ///< 商品总库存
+        std::uint32_t brand_begin; ///< 第一个品牌在品牌数组中的位置
+        std::uint32_t brand_count; ///< 关联品牌数量
+    };
+
+    std::vector<ResidentItem> slots; ///< 内存中维护的商品槽位，按插入顺序排列（按需加载模式下不使用）
+    std::vector<ResidentBrand> brands; ///< 各槽位的品牌，同一商品的品牌连续存放
+    std::vector<bool> live; ///< 各槽位是否有效（删除与更新在原槽位留下墓碑）
+
+    /// @brief 商品编码 → 有效槽位，按编码有序（检查点据此顺序写出，无需排序），节点从当前一代的Region分配
+    using SlotIndex = std::map<int, std::size_t, std::less<int>, RegionAllocator<std::pair<const int, std::size_t>>>;
+    std::unique_ptr<Region> generation; ///< 槽位索引所在的内存区域，槽位压缩时整体换新
+    SlotIndex slot_of; ///< 商品编码 → 有效槽位
+
+    ColumnStore columns; ///< 全部商品的列式镜像（构建后随修改同步）
+    bool columns_built; ///< 列式镜像是否已构建（常驻模式下启动时构建，按需加载模式下首次使用时构建）
+
+    std::string data_path; ///< 数据文件路径
+    bool demand_paging; ///< 是否按需从快照读入商品
+    MappedFile image; ///< 按需加载模式下映射的快照数据文件
+    std::uint64_t image_lsn = 0; ///< 已映射快照所包含的最后一条日志的序列号
+    std::vector<std::pair<int, std::uint32_t>> directory; ///< 快照中的商品编码 → 记录序号（按编码升序，已失效的记录序号为NO_RECORD）
+    std::map<int, Item> dirty; ///< 映射快照之后插入或修改的商品，下一次检查点写入快照
+    bool checkpointed = false; ///< 检查点已读取内存状态，下一次修改前需要重新映射快照
+
+    /**
+     * @brief 将商品转为常驻形式
+     * @param item 商品数据
+     * @return 常驻商品，字符串各持有一次驻留引用，品牌追加到品牌数组末尾
+     */
+    ResidentItem store(const Item &item);
+
+    /**
+     * @brief 由常驻商品还原完整商品
+     * @param record 常驻商品
+     * @param item 输出商品，覆盖全部字段并复用其已有的字符串容量
+     */
+    void resolve(const ResidentItem &record, Item &item) const;
+
+    /**
+     * @brief 由常驻商品还原完整商品
+     * @param record 常驻商品
+     * @return 商品数据
+     */
+    Item resolve(const ResidentItem &record) const;
+
+    /**
+     * @brief 归还常驻商品持有的驻留引用
+     * @param record 常驻商品
+     */
+    void release(const ResidentItem &record);
+
+    /**
+     * @brief 将商品追加到槽位数组末尾
+     * @param item 商品数据
+     * @note 编码已存在时旧槽位先留下墓碑，与逐条插入时持久层的覆盖语义一致
+     */
+    void put_slot(const Item &item);
+
+    /**
+     * @brief 删除商品所在的槽位
+     * @param code 商品编码
+     * @param removed 输出被删除的商品
+     * @return 商品存在时返回true
+     * @note 槽位只标记为墓碑，其余商品的相对顺序不变；墓碑超过有效槽位数时连同品牌数组整体压缩，均摊O(1)
+     */
+    bool remove_slot(int code, Item &removed);
+
+    /**
+     * @brief 按配置调整持久层参数
+     * @param config 引擎配置
+     * @return 按需加载模式下改为快照格式并关闭后台检查点，检查点总在内存状态与日志一致时进行
+     */
+    static PersistConfig persist_config(const EngineConfig &config);
+
+    /**
+     * @brief 映射数据文件并重建编码目录
+     * @note 清空修改表，调用前快照须已包含全部修改
+     */
+    void load_image();
+
+    /**
+     * @brief 检查点写出新快照后重新映射
+     * @note 检查点在追加日志之前读取内存状态，须在应用本次修改之前调用；
+     *       快照未被替换（写入失败）时保留原映射与修改表
+     */
+    void refresh_image();
+
+    /**
+     * @brief 在目录中查找商品
+     * @param code 商品编码
+     * @return 目录项迭代器，不存在或已失效时返回directory.end()
+     */
+    std::vector<std::pair<int, std::uint32_t>>::iterator find_record(int code);
+
+    /**
+     * @brief 按需加载模式下读取完整商品
+     * @param code 商品编码
+     * @param item 输出商品数据
+     * @return 商品存在时返回true
+     * @note 先查修改表，再按目录从快照解码
+     */
+    bool load_item(int code, Item &item);
+
+    /**
+     * @brief 按需加载模式下按编码升序逐条访问全部商品
+     * @param visit 访问回调，返回false时停止
+     * @note 快照中的有效记录与修改表归并，每次只解码一个商品
+     */
+    void for_each_item(const std::function<bool(const Item &)> &visit);
 
     /**
      * @brief 执行查询条件过滤
@@ -91,8 +239,18 @@ public:
      * @param max_log 日志最大条目数
      * @param operation_file_path 操作日志文件路径
      * @param data_file_path 数据文件路径
+     * @param config 引擎配置
+     * @note 按需加载模式下内存占用由缓存容量与检查点间隔决定，与商品总数只通过目录和索引相关
+     *       （调用column_store()之后还包括列式镜像）
+     */
+    Engine(int max_cache, int max_log, const std::string &operation_file_path, const std::string &data_file_path,
+           const EngineConfig &config = EngineConfig());
+
+    /**
+     * @brief 析构函数
+     * @note 在内存数据销毁前关闭持久层，使最终检查点写出完整的内存状态
      */
-    Engine(int max_cache, int max_log, const std::string &operation_file_path, const std::string &data_file_path);
+    ~Engine();
 
     /**
      * @brief 插入新数据项
@@ -101,6 +259,23 @@ public:
      */
     Item insert(Item item);
 
+    /**
+     * @brief 批量插入数据项
+     * @param batch 待插入的Item对象（顺序任意）
+     * @return 实际插入的数量
+     * @note 按编码排序后校验：批内重复的编码只保留第一个，已存在的编码跳过；
+     *       整批与尚未合并的日志一次归并写入数据文件，不逐条追加日志，内存与索引随后整体更新
+     */
+    std::size_t bulk_insert(std::vector<Item> batch);
+
+    /**
+     * @brief 从文件导入数据项
+     * @param file_path CSV数据文件或二进制快照路径（按文件头识别）
+     * @return 实际插入的数量
+     * @note 读取全部商品后按bulk_insert()的规则批量插入
+     */
+    std::size_t import_file(const std::string &file_path);
+
     /**
      * @brief 通过Item对象删除数据
      * @param item 要删除的Item对象
@@ -125,6 +300,13 @@ public:
     /// @brief 创建查询构建器实例
     QueryBuilder select();
 
+    /**
+     * @brief 获取列式镜像
+     * @return 随插入、更新、删除同步的列式镜像，供只涉及少数字段的扫描与聚合使用
+     * @note 按需加载模式下首次调用时解码全部商品构建镜像，此后常驻内存的镜像与商品总数成正比
+     */
+    const ColumnStore &column_store();
+
     /**
      * @brief 通过唯一编码查询数据
      * @param code 要查询的数据项编码
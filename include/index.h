@@ -6,13 +6,19 @@
 #ifndef INDEX_H
 #define INDEX_H
 
+#include "intern.h"
+
+#include <cstdint>
+#include <memory>
 #include <string>
-#include <unordered_map>
+#include <utility>
 #include <vector>
 
 class Index {
 private:
-    std::unordered_map<std::string, int> name_to_code;
+    std::unique_ptr<StringPool> own_pool; ///< 未指定驻留池时自有的驻留池
+    StringPool *pool; ///< 名称所在的字符串驻留池
+    std::vector<std::pair<bool, int>> name_to_code; ///< 名称驻留编号 → (是否已建索引, 编码)，编号密集且可复用，直接按编号定位
 
     /**
      * @brief 将UTF-8字符串转换为宽字符串
@@ -48,7 +54,25 @@ private:
      */
     static int levenshtein(const std::string &s1, const std::string &s2);
 
+    /**
+     * @brief 计算两个字符串视图的编辑距离
+     * @param s1 第一个UTF-8字符串
+     * @param s2 第二个UTF-8字符串
+     * @return 两个字符串的最小编辑操作次数
+     * @note 按字节计算，替换操作权重为2，插入/删除权重为1
+     */
+    static int levenshtein(const StringRef &s1, const StringRef &s2);
+
 public:
+    /// @brief 构造使用自有驻留池的索引
+    Index();
+
+    /**
+     * @brief 构造与其他组件共用驻留池的索引
+     * @param shared_pool 字符串驻留池，生命周期不短于本对象
+     */
+    explicit Index(StringPool &shared_pool);
+
     /**
      * @brief 插入名称与编码的映射关系
      * @param name 要插入的名称（UTF-8编码）
@@ -0,0 +1,144 @@
+﻿/**
+ * @file intern.h
+ * @brief 字符串驻留池定义头文件（字符串在内存块中只存放一份，以整数编号引用）
+ */
+
+#ifndef INTERN_H
+#define INTERN_H
+
+#include "region.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+
+/**
+ * @struct StringRef
+ * @brief 不持有内存的字符串视图
+ */
+struct StringRef {
+    const char *data; ///< 首字符地址
+    std::size_t size; ///< 字节数
+
+    /// @brief 复制为std::string
+    std::string str() const { return std::string(data, size); }
+
+    bool operator==(const StringRef &other) const;
+};
+
+
+/**
+ * @class StringPool
+ * @brief 字符串驻留池
+ *
+ * 字符串内容依次追加到大块内存中，同一字符串只存放一份，持有编号的一方比较字符串时只需比较整数。
+ * 每次intern()为编号增加一次引用，持有方不再使用时以release()归还；引用归零的字符串立即
+ * 不可再查到，其编号留待复用。已归还的字节多于仍被引用的字节时，池把存活的字符串搬入新的
+ * 内存区域并整体释放旧区域，编号保持不变，但此前取得的视图随之失效。
+ * 内容到编号的查找表是开放寻址的编号数组，新增字符串不为查找表单独分配节点
+ */
+class StringPool {
+private:
+    /// @brief 按内容计算视图的哈希值
+    struct RefHash {
+        std::size_t operator()(const StringRef &ref) const;
+    };
+
+    static constexpr std::uint32_t EMPTY_SLOT = 0xFFFFFFFFu; ///< 查找表中从未使用的槽位
+    static constexpr std::uint32_t ERASED_SLOT = 0xFFFFFFFEu; ///< 查找表中已删除的槽位
+    static constexpr std::size_t NOT_FOUND = static_cast<std::size_t>(-1); ///< 查找表中没有该字符串
+
+    Region arena{BLOCK_SIZE}; ///< 字符串内容所在的内存区域
+
+    std::vector<StringRef> refs; ///< 编号 → 视图
+    std::vector<std::uint32_t> counts; ///< 编号 → 引用次数（0表示编号空闲）
+    std::vector<std::uint32_t> free_ids; ///< 引用归零、可复用的编号
+    std::vector<std::uint32_t> table; ///< 按内容哈希线性探测的查找表，槽位存放编号，容量为2的幂
+    std::size_t used_slots = 0; ///< 查找表中存放编号或删除标记的槽位数
+    std::size_t live_count = 0; ///< 仍被引用的字符串数量
+    std::size_t live_bytes = 0; ///< 仍被引用的字符串字节数
+    std::size_t dead_bytes = 0; ///< 已归还但仍占用内存区域的字节数
+
+    /**
+     * @brief 在查找表中定位字符串
+     * @param ref 字符串视图
+     * @return 存放其编号的槽位，不存在时返回NOT_FOUND
+     */
+    std::size_t locate(const StringRef &ref) const;
+
+    /**
+     * @brief 将编号放入查找表
+     * @param id 编号（对应的字符串尚不在表中）
+     * @note 调用方须保证放入后仍有空槽位
+     */
+    void place(std::uint32_t id);
+
+    /// @brief 按存活的字符串数量重建查找表，清除删除标记
+    void rehash();
+
+    /// @brief 将仍被引用的字符串搬入新的内存区域，释放旧区域
+    void compact();
+
+public:
+    static constexpr std::size_t BLOCK_SIZE = 64 * 1024; ///< 第一个内存块的大小
+
+    StringPool() = default;
+
+    StringPool(const StringPool &) = delete;
+
+    StringPool &operator=(const StringPool &) = delete;
+
+    /**
+     * @brief 驻留字符串并增加一次引用
+     * @param value 字符串
+     * @return 编号，首次出现时复制内容并分配编号
+     */
+    std::uint32_t intern(const std::string &value);
+
+    /**
+     * @brief 驻留字符串并增加一次引用
+     * @param data 首字符地址
+     * @param length 字节数
+     * @return 编号，首次出现时复制内容并分配编号
+     */
+    std::uint32_t intern(const char *data, std::size_t length);
+
+    /**
+     * @brief 归还intern()取得的一次引用
+     * @param id 编号
+     * @note 引用归零后字符串从池中移除；可能触发压缩，此前取得的视图失效
+     */
+    void release(std::uint32_t id);
+
+    /**
+     * @brief 查找已驻留字符串的编号
+     * @param value 字符串
+     * @param id 输出编号
+     * @return 池中存在该字符串时返回true，不会新增字符串
+     */
+    bool find(const std::string &value, std::uint32_t &id) const;
+
+    /**
+     * @brief 获取编号对应的视图
+     * @param id 编号
+     * @return 指向池内内容的视图
+     */
+    StringRef view(std::uint32_t id) const;
+
+    /**
+     * @brief 获取编号对应的字符串副本
+     * @param id 编号
+     * @return 字符串
+     */
+    std::string str(std::uint32_t id) const;
+
+    /// @brief 池中仍被引用的字符串数量
+    std::size_t size() const;
+
+    /// @brief 内存区域中已分配的字节数（含已归还、尚未压缩的字符串）
+    std::size_t size_bytes() const;
+};
+
+#endif //INTERN_H
@@ -1,15 +1,56 @@
 ﻿/**
- * @file index.h
- * @brief 索引管理及模糊查询支持头文件
+ * @file persister.h
+ * @brief 数据持久化模块，协调数据文件与操作日志
  */
 
 #ifndef PERSISTER_H
 #define PERSISTER_H
 
 #include "datatype.h"
+#include "region.h"
 #include "storage.h"
 
+#include <functional>
 #include <list>
+#include <map>
+#include <memory>
+#include <vector>
+#include <unordered_set>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+
+/**
+ * @enum ShardScheme
+ * @brief 商品编码到数据分片的划分方式
+ */
+enum class ShardScheme {
+    HASH, ///< 按编码取模，编码连续时各分片均匀
+    RANGE ///< 按编码区间，各分片内的编码互不交叠
+};
+
+
+/**
+ * @struct PersistConfig
+ * @brief 持久化层可选配置
+ */
+struct PersistConfig {
+    LogFormat log_format = LogFormat::TEXT; ///< 新建操作日志时采用的格式（已有日志按文件头识别）
+    DataFormat data_format = DataFormat::CSV; ///< 写入数据文件时采用的格式（读取时按文件头识别）
+    bool background_checkpoint = true; ///< 日志达到阈值后是否轮转日志并由后台线程合并（写入方只追加，不等待合并）
+    int max_checkpoint_lag = 1024; ///< 后台合并未完成时活动日志允许超出阈值的记录数，超出后写入方等待
+    Durability durability = Durability::BUFFERED; ///< 操作日志持久化级别（各级别的丢失窗口见Durability）
+    int group_commit_records = 64; ///< 组提交：攒满多少条记录后提交
+    int group_commit_interval_us = 2000; ///< 组提交：首条记录最多等待多少微秒后提交
+    bool compact_sealed_segments = false; ///< 后台合并前是否先将封存段就地压缩为每个商品一条有效记录
+    std::uint32_t page_size = 4096; ///< 分页数据文件新建时的页大小（字节）
+    unsigned lsm_fanout = 4; ///< LSM格式同一层的段达到多少个后合并为下一层的一个段
+    unsigned shards = 1; ///< 数据分片数，大于1时每个分片有独立的数据文件与操作日志（路径追加.shard<i>）
+    ShardScheme shard_scheme = ShardScheme::HASH; ///< 商品编码到分片的划分方式
+    std::vector<int> shard_bounds; ///< 按区间分片时第2个起各分片的起始编码（严格升序，共shards-1个）
+};
+
 
 /**
  * @class Persist
@@ -19,32 +60,272 @@
  */
 class Persist : public WriteLogic, public ReadLogic {
 private:
-    DataFile data_file; ///< 数据文件存储对象（持久化主存储）
+    /**
+     * @struct PendingItem
+     * @brief 尚未合并进数据文件的日志对单个商品的净效果
+     */
+    struct PendingItem {
+        enum class State {
+            UPDATED, ///< 数据文件中存在该商品时替换为item，否则不存在
+            SET, ///< 商品为item（日志中插入过）
+            DELETED ///< 商品已删除
+        } state;
+        Item item; ///< 最新的商品数据
+    };
+
+    /// @brief 净效果表，节点从一次重放专用的Region分配，重放结束后整体释放
+    using PendingMap = std::map<int, PendingItem, std::less<int>, RegionAllocator<std::pair<const int, PendingItem>>>;
+
+    std::string data_path; ///< 数据文件路径
+    DataFile data_file; ///< 数据文件写入对象（持久化主存储，CSV格式；读取使用独立对象）
+    SnapshotFile snapshot_file; ///< 数据文件写入对象（持久化主存储，二进制快照格式）
+    PagedFile paged_file; ///< 数据文件写入对象（持久化主存储，分页格式，保持打开以复用页目录）
+    LsmStore lsm_store; ///< 数据存储对象（LSM格式，操作日志充当其预写日志，仅在该格式下打开）
+    mutable std::mutex data_mutex; ///< 分页数据文件原地改写与读取互斥（其他格式以原子重命名替换，无需加锁）
+    DataFormat data_format; ///< 写入数据文件时采用的格式
     OperationFile operation_file; ///< 操作日志文件对象（事务日志存储）
     int max_log_row; ///< 操作日志最大行数阈值（触发自动刷新的阈值）
     bool has_closed = false; ///< 资源关闭状态标记（防止重复关闭）
+    ItemSource state_source; ///< 内存数据来源（由上层引擎注册，用于检查点）
+    std::unordered_set<int> dirty_codes; ///< 上次检查点之后被修改过的商品编码
+
+    bool background_checkpoint; ///< 是否启用后台检查点
+    bool compact_sealed_segments; ///< 后台合并前是否就地压缩封存段
+    int max_checkpoint_lag; ///< 后台检查点允许的最大滞后记录数
+    std::thread worker_thread; ///< 后台线程（合并封存段、按时提交组提交缓冲）
+    std::mutex worker_mutex; ///< 保护操作日志及后台线程共享状态
+    std::condition_variable worker_condition; ///< 后台线程状态变化通知
+    bool checkpoint_pending = false; ///< 是否有封存日志段等待后台合并
+    bool commit_scheduled = false; ///< 组提交缓冲是否等待后台按时提交
+    bool stopping = false; ///< 后台线程退出标记
+
+    std::vector<std::unique_ptr<Persist>> shards; ///< 数据分片（为空时本对象直接管理数据文件与操作日志）
+    ShardScheme shard_scheme; ///< 商品编码到分片的划分方式
+    std::vector<int> shard_bounds; ///< 按区间分片时各分片的起始编码
+    std::vector<std::vector<Item>> shard_states; ///< 并行检查点前一次遍历内存数据来源得到的各分片商品
+    bool shard_states_ready = false; ///< shard_states是否可供本次并行检查点使用
 
     /**
     * @brief 操作日志写入核心方法
-    * @param item 需要操作的数据条目
-    * @param keyword 操作类型标识（"[insert]" / "[update]"）
+    * @param operation 需要写入的操作记录
     * @return 操作是否成功
-    * @note 本方法实现：
-    * 1. 构建包含操作类型和条目数据的日志格式
-    * 2. 自动处理关联的品牌数据
-    * 3. 当日志行数超过阈值时触发自动刷新
+    * @note 日志记录数达到阈值时：启用后台检查点则轮转日志并交给后台线程合并；
+    *       否则未注册内存数据来源时在写入后刷新，注册后改为在写入前触发检查点，此时上层内存状态恰好包含日志中的全部操作
     *
-    * @warning 被insert()和update()方法调用，不应直接使用
+    * @warning 被insert()、update()和del()方法调用，不应直接使用
     */
-    bool write_operation(const Item &item, const std::string &keyword);
+    bool write_operation(const Operation &operation);
 
     /**
-    * 应用待处理操作（内部辅助方法）
-    * @param items 当前数据集
-    * @param operation_code 操作类型标记
-    * @param target 待操作数据项
-    */
-    static void apply_pending_operation(std::list<Item> &items, int operation_code, Item &target);
+     * @brief 序列化商品为日志负载
+     * @param item 商品数据
+     * @return ITEM|行及其BRAND|行，以换行分隔
+     */
+    static std::string item_to_payload(const Item &item);
+
+    /**
+     * @brief 从日志负载解析商品
+     * @param payload ITEM|行及其BRAND|行
+     * @return 解析后的Item对象
+     */
+    static Item payload_to_item(const std::string &payload);
+
+    /**
+     * @brief 读取数据文件
+     * @param lsn 输出数据文件所包含的最后一条日志的序列号
+     * @return 数据文件中的全部条目，以商品编码为键
+     * @note 按文件头自动识别CSV或二进制快照格式，流式读取直接建表
+     */
+    std::map<int, Item> read_data(std::uint64_t &lsn) const;
+
+    /**
+     * @brief 以数据文件为基础叠加日志的净效果，按编码升序访问每个商品
+     * @param operations 按写入顺序排列的操作记录（序列号不大于数据文件LSN的被跳过）
+     * @param visit 访问回调
+     * @note 按文件头识别数据文件格式，逐条读取，内存中只保留日志的净效果
+     */
+    void scan_with_overlay(std::list<Operation> operations, const ItemVisitor &visit) const;
+
+    /**
+     * @brief 读取数据文件所包含的最后一条日志的序列号
+     * @return 日志序列号，数据文件未记录时返回0
+     * @note 只读取文件头，不加载数据
+     */
+    std::uint64_t read_data_lsn() const;
+
+    /**
+     * @brief 从数据来源按配置格式写入数据文件
+     * @param source 按编码升序提供全部商品的数据来源
+     * @param lsn 数据来源所包含的最后一条日志的序列号
+     * @return 写入是否成功
+     */
+    bool write_data(const ItemSource &source, std::uint64_t lsn);
+
+    /// @brief 持有锁时执行flush()
+    int flush(std::unique_lock<std::mutex> &lock);
+
+    /// @brief 持有锁时执行checkpoint()
+    int checkpoint(std::unique_lock<std::mutex> &lock);
+
+    /**
+     * @brief 以数据文件为基础合并全部日志（封存段与活动日志）
+     * @param lock 已持有的worker_mutex锁
+     * @return 本次合并的日志条目数量
+     */
+    int merge(std::unique_lock<std::mutex> &lock);
+
+    /**
+     * @brief 将操作记录合并进数据文件
+     * @param operations 待重放的操作记录
+     * @param batch 随同写入的批量插入商品（按编码升序，编码相同时取代已有商品）
+     * @param batch_lsn 批量插入占用的序列号
+     * @return 数据文件写入是否成功
+     * @note 分页格式只改写受影响的页；LSM格式的内存表已包含这些操作，只将其写成新的段；
+     *       其他格式的执行流程：
+     * 1. 将序列号大于数据文件LSN的操作记录折叠为每个商品的净效果
+     * 2. 按编码顺序边读数据文件边归并净效果与批量商品
+     * 3. 归并结果连同新的LSN流式写入临时文件，完成后替换数据文件
+     */
+    bool merge_into_data(std::list<Operation> operations, const std::vector<Item> &batch = std::vector<Item>(),
+                         std::uint64_t batch_lsn = 0);
+
+    /**
+     * @brief 将操作记录原地应用到分页数据文件
+     * @param operations 待重放的操作记录
+     * @param batch 随同写入的批量插入商品
+     * @param batch_lsn 批量插入占用的序列号
+     * @return 数据文件写入是否成功
+     * @note 操作记录折叠为每个商品的净效果后只改写包含这些商品的页
+     */
+    bool merge_into_pages(const std::list<Operation> &operations, const std::vector<Item> &batch,
+                          std::uint64_t batch_lsn);
+
+    /**
+     * @brief 依次读取封存日志段中的操作记录
+     * @param segments 封存段路径，按封存先后排列
+     * @return 按写入顺序排列的操作记录
+     */
+    static std::list<Operation> read_segments(const std::vector<std::string> &segments);
+
+    /**
+     * @brief 轮转日志并请求后台合并
+     * @param lock 已持有的worker_mutex锁
+     * @note 后台合并尚未完成时继续追加到活动日志，
+     *       活动日志超出阈值max_checkpoint_lag条后才等待；
+     *       合并失败时封存段保留，与之后封存的日志段一起重试
+     */
+    void request_checkpoint(std::unique_lock<std::mutex> &lock);
+
+    /**
+     * @brief 等待后台合并完成
+     * @param lock 已持有的worker_mutex锁（等待期间释放）
+     */
+    void wait_for_checkpoint(std::unique_lock<std::mutex> &lock);
+
+    /**
+     * @brief 后台线程主循环
+     * @note 合并封存日志段时不持有锁，前台可继续追加；
+     *       启用compact_sealed_segments时先就地压缩封存段，合并失败保留的日志段也已是压缩后的内容；
+     *       合并成功后整体删除已合并的封存段；
+     *       组提交缓冲到期时持有锁提交，将这段时间内的写入合并为一次write+fsync
+     */
+    void background_worker();
+
+    /**
+     * @brief 日志达到阈值时是否在前台以内存状态执行检查点
+     * @return 已注册内存数据来源且未启用后台检查点时返回true
+     */
+    bool foreground_state_checkpoint() const;
+
+    /// @brief 停止并回收后台线程
+    void stop_worker();
+
+    /**
+     * @brief 压缩操作记录，每个商品只保留最后的有效操作
+     * @param operations 按写入顺序排列的操作记录
+     * @param lsn 数据集已包含的最后一条日志的序列号（不大于它的记录被丢弃）
+     * @return 压缩后的操作记录，按序列号升序排列
+     * @note 重放结果与原记录相同：插入后的更新并入插入，更新后的更新只保留最后一次，
+     *       删除吸收此前的全部操作；删除后再插入时保留删除与插入两条。
+     *       保留下来的记录带有被吸收记录中最大的序列号
+     */
+    static std::list<Operation> compact_operations(const std::list<Operation> &operations, std::uint64_t lsn);
+
+    /**
+     * @brief 就地压缩封存日志段
+     * @param segments 封存段路径
+     * @return 各封存段压缩后的操作记录，按封存先后拼接
+     * @note 每个封存段单独压缩并原子替换，记录条数没有减少时不改写文件
+     */
+    static std::list<Operation> compact_segments(const std::vector<std::string> &segments);
+
+    /**
+     * @brief 将操作记录折叠为每个商品的净效果
+     * @param operations 按写入顺序排列的操作记录
+     * @param lsn 数据文件已包含的最后一条日志的序列号（不大于它的记录被跳过）
+     * @param region 净效果表节点所在的内存区域，生命周期不短于返回的表
+     * @return 按编码排序的净效果表
+     */
+    static PendingMap build_overlay(const std::list<Operation> &operations, std::uint64_t lsn, Region &region);
+
+    /**
+     * @brief 将净效果表与按编码升序访问的数据文件归并
+     * @param scan_base 按编码升序访问数据文件的函数
+     * @param overlay 净效果表
+     * @param visit 按编码升序对每个商品调用一次的访问回调
+     */
+    static void merge_overlay(const ItemSource &scan_base, const PendingMap &overlay,
+                              const ItemVisitor &visit);
+
+    /**
+     * @brief 生成分片文件路径
+     * @param path 未分片时的文件路径
+     * @param index 分片序号
+     * @return 追加.shard<index>后的路径
+     */
+    static std::string shard_path(const std::string &path, std::size_t index);
+
+    /**
+     * @brief 计算商品所属分片
+     * @param code 商品编码
+     * @return 分片序号
+     */
+    std::size_t shard_of(int code) const;
+
+    /**
+     * @brief 每个分片各用一个线程并行执行
+     * @param action 以分片序号调用的操作
+     * @note 等待全部线程结束后重新抛出第一个分片的异常
+     */
+    void for_each_shard(const std::function<void(std::size_t)> &action);
+
+    /**
+     * @brief 在各分片并行执行会写出内存状态的操作
+     * @param action 以分片序号调用的操作（flush、checkpoint或close）
+     * @note 先在调用线程中遍历一次内存数据来源，按分片划分到shard_states，各分片的数据来源只访问自己的部分，
+     *       避免N个分片各自遍历一次全部内存状态；没有分片需要写出内存状态时不做遍历
+     */
+    void for_each_shard_with_state(const std::function<void(std::size_t)> &action);
+
+    /**
+     * @brief 并行打开各分片并完成恢复
+     * @param operation_file_path 未分片时的操作日志路径
+     * @param max_row 每个分片的日志行数阈值
+     * @param config 可选配置
+     * @throw std::invalid_argument 区间分片的边界数量不等于shards-1或不是严格升序
+     * @note 未分片的数据文件或操作日志存在时按分片迁移
+     */
+    void open_shards(const std::string &operation_file_path, int max_row, const PersistConfig &config);
+
+    /**
+     * @brief 将未分片的数据文件与操作日志迁移到各分片
+     * @param operation_file_path 未分片时的操作日志路径
+     * @param config 可选配置
+     * @throw std::runtime_error 有分片写入失败（原文件保留，下次打开时重新迁移）
+     * @note 分片数据文件记录原数据与原日志中最大的序列号；全部写成后才合并并清空原日志，
+     *       再先删日志后删数据文件，中途崩溃可以重新迁移
+     */
+    void migrate_to_shards(const std::string &operation_file_path, const PersistConfig &config);
 
 public:
     /**
@@ -52,8 +333,12 @@ public:
      * @param data_file_path 数据文件存储路径
      * @param operation_file_path 操作日志文件路径
      * @param max_row 日志文件最大行数阈值（达到阈值自动触发flush）
+     * @param config 可选配置（日志格式等）
+     * @note config.shards大于1时本对象只负责路由：各分片是独立的Persist，
+     *       加载、检查点、恢复与关闭在各分片上并行执行
      */
-    Persist(const std::string &data_file_path, const std::string &operation_file_path, int max_row);
+    Persist(const std::string &data_file_path, const std::string &operation_file_path, int max_row,
+            const PersistConfig &config = PersistConfig());
 
     /**
      * @brief 析构函数（自动关闭未关闭的文件资源）
@@ -62,11 +347,23 @@ public:
 
     /**
      * @brief 查询数据集合
-     * @return 返回当前数据文件的全部条目列表
-     * @note 会先执行flush操作确保数据一致性
+     * @return 数据文件叠加尚未合并的操作日志后的全部条目列表（按编码升序）
+     * @note 只重放序列号大于数据文件LSN的日志记录，不写回数据文件
      */
     std::list<Item> select();
 
+    /**
+     * @brief 逐条访问数据集合
+     * @param visit 按编码升序对每个商品调用一次的访问回调
+     * @note 数据文件流式读取，尚未合并的日志折叠为每个商品的净效果后在读取过程中叠加，
+     *       内存占用只与未合并的日志量有关，与数据集大小无关；
+     *       访问期间不持有日志锁，回调中可以调用本对象的其他方法；
+     *       分页格式下访问期间持有数据文件锁，回调中不应调用flush()等写数据文件的方法；
+     *       LSM格式下日志中的操作已在内存表中，直接归并内存表与各段文件；
+     *       分片时各分片并行读取到内存后按编码归并，内存占用与数据集大小成正比
+     */
+    void scan(const ItemVisitor &visit);
+
     /**
      * @brief 插入新条目
      * @param item 要插入的数据条目
@@ -88,20 +385,56 @@ public:
      */
     bool del(int index);
 
+    /**
+     * @brief 批量插入商品
+     * @param batch 待插入的商品（按编码严格升序）
+     * @return 数据文件写入是否成功
+     * @note 不逐条追加日志：尚未合并的日志与整批商品一次归并写入数据文件，
+     *       整批只占用一个序列号，数据文件以该序列号为标记，之后的日志记录都大于它；
+     *       分片时每个分片并行归并属于自己的部分
+     */
+    bool bulk_insert(const std::vector<Item> &batch);
+
+    /**
+     * @brief 注册内存数据来源
+     * @param source 按编码升序提供当前全部商品的数据来源
+     * @note 注册后检查点直接写出内存状态，不再回读数据文件；
+     *       每次检查点仍写出全部商品（O(数据集)），只改写变化部分尚未实现，需要按脏数据量改写时使用分页格式；
+     *       日志达到阈值时，启用后台检查点则只轮转日志，由后台线程流式合并数据文件与封存段，不读取内存状态，
+     *       写入方不等待；未启用时在写入方线程中写出内存状态；flush()、checkpoint()与close()总是写出内存状态；
+     *       数据来源必须在close()之前保持有效；
+     *       分片时flush()、checkpoint()与close()先遍历一次数据来源并按分片划分，各分片并行写出自己的部分；
+     *       单个分片因日志达到阈值触发的检查点在写入方线程中遍历一次数据来源并过滤出该分片的商品
+     */
+    void set_state_source(ItemSource source);
+
     /**
      * @brief 强制刷新操作日志到数据文件
      * @return 本次刷新的日志条目数量
-     * @note 执行流程：
-     * 1. 读取当前数据文件内容
-     * 2. 按顺序重放所有操作日志
-     * 3. 排序后写入数据文件
+     * @note 已注册内存数据来源时执行checkpoint()，否则回读数据文件并重放日志
+     * @throw std::runtime_error 二进制日志中部损坏，数据文件与日志均保持原样
      */
     int flush();
 
+    /**
+     * @brief 以内存状态执行检查点
+     * @return 本次检查点覆盖的日志条目数量
+     * @note 自上次检查点以来没有修改时不写数据文件；
+     *       未注册内存数据来源时退化为回读数据文件并重放日志；
+     *       分页格式下总是按日志只改写脏页，I/O量与修改的商品数成正比
+     */
+    int checkpoint();
+
+    /**
+     * @brief 判断是否有尚未合并进数据文件的日志
+     * @return 活动日志或封存段中有记录时返回true
+     */
+    bool has_pending_log();
+
     /**
      * @brief 关闭文件资源
-     * @return 是否成功执行关闭操作（重复关闭返回false）
-     * @note 关闭前会自动执行flush操作
+     * @return 是否成功执行关闭操作（重复关闭或关闭前的合并失败时返回false）
+     * @note 关闭前会自动执行flush操作；合并失败时日志保持原样
      */
     bool close();
 };
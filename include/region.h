@@ -0,0 +1,121 @@
+﻿/**
+ * @file region.h
+ * @brief 区域分配器定义头文件（一批对象从少量大块内存中顺序分配，整体一次释放）
+ */
+
+#ifndef REGION_H
+#define REGION_H
+
+#include <cstddef>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+
+/**
+ * @class Region
+ * @brief 单调增长的内存区域
+ *
+ * 分配只移动当前块内的游标，块用完时分配下一个更大的块（大小逐次翻倍，有上限）。
+ * 单个对象不单独释放，区域析构或release()时全部块一次归还。
+ * 适合生命周期相同的一批对象，例如一次加载或一次日志重放的中间状态；不是线程安全的
+ */
+class Region {
+private:
+    std::vector<std::unique_ptr<char[]>> blocks; ///< 已分配的内存块
+    char *cursor = nullptr; ///< 当前块中下一次分配的位置
+    std::size_t remaining = 0; ///< 当前块剩余的字节数
+    std::size_t next_block; ///< 下一个块的大小
+    std::size_t bytes = 0; ///< 已分配给对象的字节数
+
+public:
+    static constexpr std::size_t BLOCK_SIZE = 64 * 1024; ///< 第一个块的默认大小
+    static constexpr std::size_t MAX_BLOCK_SIZE = 4 * 1024 * 1024; ///< 块大小翻倍的上限
+
+    /**
+     * @brief 构造内存区域
+     * @param first_block 第一个块的大小（字节）
+     * @note 构造时不分配内存，第一次分配时才申请第一个块
+     */
+    explicit Region(std::size_t first_block = BLOCK_SIZE);
+
+    Region(const Region &) = delete;
+
+    Region &operator=(const Region &) = delete;
+
+    Region(Region &&) = default;
+
+    Region &operator=(Region &&) = default;
+
+    /**
+     * @brief 分配内存
+     * @param size 字节数
+     * @param alignment 对齐要求（2的幂）
+     * @return 分配的首地址
+     * @note 超过块大小上限的请求独占一块，当前块继续用于后续的小对象
+     */
+    void *allocate(std::size_t size, std::size_t alignment);
+
+    /// @brief 归还全部块，之前分配的对象全部失效
+    void release();
+
+    /// @brief 已分配的块数
+    std::size_t block_count() const;
+
+    /// @brief 已分配给对象的字节数
+    std::size_t size_bytes() const;
+};
+
+
+/**
+ * @class RegionAllocator
+ * @brief 从Region分配的标准库分配器
+ *
+ * deallocate()不做任何事，内存随Region整体释放；容器移动赋值与交换时分配器随之转移，
+ * 因此容器可以整体换到另一个Region上
+ */
+template<typename T>
+class RegionAllocator {
+public:
+    using value_type = T;
+    using propagate_on_container_copy_assignment = std::true_type;
+    using propagate_on_container_move_assignment = std::true_type;
+    using propagate_on_container_swap = std::true_type;
+
+    template<typename U>
+    struct rebind {
+        using other = RegionAllocator<U>;
+    };
+
+    Region *region; ///< 所使用的内存区域
+
+    /**
+     * @brief 构造分配器
+     * @param source 内存区域，生命周期不短于使用本分配器的容器
+     */
+    explicit RegionAllocator(Region &source) noexcept : region(&source) {
+    }
+
+    template<typename U>
+    RegionAllocator(const RegionAllocator<U> &other) noexcept : region(other.region) {
+    }
+
+    T *allocate(const std::size_t n) {
+        return static_cast<T *>(region->allocate(n * sizeof(T), alignof(T)));
+    }
+
+    void deallocate(T *, std::size_t) noexcept {
+    }
+
+    template<typename U>
+    bool operator==(const RegionAllocator<U> &other) const noexcept {
+        return region == other.region;
+    }
+
+    template<typename U>
+    bool operator!=(const RegionAllocator<U> &other) const noexcept {
+        return region != other.region;
+    }
+};
+
+#endif //REGION_H
@@ -8,9 +8,17 @@
 
 #include "../include/datatype.h"
 
+#include <cstdint>
 #include <string>
 #include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <vector>
 #include <fstream>
+#include <chrono>
+#include <functional>
 
 
 /**
@@ -21,6 +29,7 @@ class BaseFile {
 private:
     std::string path;
     bool has_file_object = false;
+    bool binary_mode = false; ///< 是否以二进制模式打开（不做换行符转换）
     std::fstream file_object;
 
 protected:
@@ -38,12 +47,35 @@ protected:
      */
     bool set_file_path(std::string new_file_path);
 
+    /**
+     * @brief 获取文件路径
+     * @return 当前文件路径
+     */
+    const std::string &get_file_path() const;
+
+    /**
+     * @brief 设置文件打开模式
+     * @param enable true时以二进制模式打开文件，保证读写偏移与字节数一致
+     * @note 仅对之后的open_file_object()/clear_file_context()生效
+     */
+    void set_binary_mode(bool enable);
+
     /**
      * @brief 清空文件内容
      * @note 会立即清空文件所有内容
      */
     void clear_file_context();
 
+    /**
+     * @brief 原子替换文件内容
+     * @param writer 向临时文件写入新内容的回调，返回false表示放弃本次写入
+     * @return 新内容已落盘并替换原文件时返回true
+     * @note 新内容先写入"<路径>.tmp"并fsync，再重命名覆盖原文件；
+     *       替换完成前原文件保持不变，读者总能看到完整的上一代或新一代内容。
+     *       调用时会先关闭本对象的文件流
+     */
+    bool replace_file_content(const std::function<bool(std::ostream &)> &writer);
+
     /**
       * @brief 重置文件流状态
       * @details 执行以下清理操作：
@@ -53,6 +85,13 @@ protected:
       */
     void reduction();
 
+    /**
+     * @brief 列出与指定文件同目录、名为"<文件名>.<序号>"的文件序号
+     * @param path 文件路径
+     * @return 升序排列的序号
+     */
+    static std::vector<unsigned long> list_numbered_files(const std::string &path);
+
 public:
     /**
      * @brief 构造函数
@@ -66,13 +105,13 @@ public:
         * @return 成功打开返回true，文件已打开或路径无效时返回false
         * @note 以读写模式打开文件，保留原有内容
         */
-    bool open_file_object();
+    virtual bool open_file_object();
 
     /**
      * @brief 关闭文件流
      * @return 成功关闭返回true，文件未打开时返回false
      */
-    bool close_file_object();
+    virtual bool close_file_object();
 
     /**
      * @brief 析构函数
@@ -93,13 +132,24 @@ public:
     /**
      * @brief 写入完整商品数据
      * @param items 商品数据列表
+     * @param lsn 数据所包含的最后一条日志的序列号（为0时不写LSN|行）
      * @return 写入成功返回true，文件未打开或写入失败返回false
      * @details 写入流程：
      * 1. 清空文件内容
-     * 2. 按层次写入Item及其关联的Brand数据
-     * 3. 每个Item后跟其brand_list中的所有Brand记录
+     * 2. 写入LSN|行
+     * 3. 按层次写入Item及其关联的Brand数据
+     * 4. 每个Item后跟其brand_list中的所有Brand记录
      */
-    bool write(const std::list<Item> &items);
+    bool write(const std::list<Item> &items, std::uint64_t lsn = 0);
+
+    /**
+     * @brief 从数据来源写入完整商品数据
+     * @param source 按编码升序提供全部商品的数据来源
+     * @param lsn 数据所包含的最后一条日志的序列号（为0时不写LSN|行）
+     * @return 写入成功返回true，文件未打开或写入失败返回false
+     * @note 无需先将数据集合拷贝为列表
+     */
+    bool write(const ItemSource &source, std::uint64_t lsn = 0);
 };
 
 
@@ -108,17 +158,102 @@ public:
  * @brief CSV数据读取操作类
  */
 class ReadDataFile : virtual public BaseFile, public ReadLogic{
+private:
+    /**
+     * @struct ParsedText
+     * @brief 区段文本缓冲中的一个字段
+     */
+    struct ParsedText {
+        size_t offset; ///< 在文本缓冲中的起始位置
+        size_t length; ///< 字节数
+    };
+
+    /**
+     * @struct ParsedBrand
+     * @brief 已解析的品牌，名称存放在区段文本缓冲中
+     */
+    struct ParsedBrand {
+        ParsedText name; ///< 品牌名称
+        int code; ///< 品牌编码
+        int quantity; ///< 当前库存数量
+        double price; ///< 单品价格
+    };
+
+    /**
+     * @struct ParsedItem
+     * @brief 已解析的商品，名称与色调存放在区段文本缓冲中，品牌连续存放在品牌数组中
+     */
+    struct ParsedItem {
+        ParsedText name; ///< 商品名称
+        ParsedText colour; ///< 商品色调
+        int code; ///< 商品编码
+        int quantity; ///< 商品总库存
+        size_t brand_begin; ///< 第一个品牌在品牌数组中的位置
+        size_t brand_count; ///< 关联品牌数量
+    };
+
+    /**
+     * @struct ParsedRange
+     * @brief 一个区段的解析结果
+     * @note 字符串全部拼接在一个文本缓冲中，数组与缓冲跨窗口复用，不为每个商品单独分配内存
+     */
+    struct ParsedRange {
+        std::string text; ///< 本窗口各字段的文本依次拼接
+        std::vector<ParsedItem> items; ///< 本窗口解析出的商品
+        std::vector<ParsedBrand> brands; ///< 各商品的品牌
+    };
+
+    /**
+     * @brief 解析一段数据文件内容
+     * @param begin 起始位置（位于行首）
+     * @param end 结束位置（位于行首或内容末尾）
+     * @param range 解析结果，覆盖此前的内容
+     * @note 区段内第一个ITEM|行之前的BRAND|行没有所属商品，被忽略
+     */
+    static void parse_range(const char *begin, const char *end, ParsedRange &range);
+
+    /**
+     * @brief 并行解析一个读取窗口并按文件顺序访问其中的商品
+     * @param data 窗口起始位置（位于行首）
+     * @param size 窗口字节数，末尾为完整商品的结束位置
+     * @param workers 区段数，即解析线程数
+     * @param parts 各区段的解析结果，跨窗口复用
+     * @param item 还原商品用的对象，跨窗口复用其字符串容量
+     * @param visit 商品访问回调，只在当前线程调用
+     */
+    static void parse_window(const char *data, size_t size, unsigned int workers,
+                             std::vector<ParsedRange> &parts, Item &item, const ItemVisitor &visit);
+
 public:
     using BaseFile::BaseFile;
 
     /**
      * @brief 读取完整商品数据
+     * @param workers 解析线程数，为0时按CPU核数与文件大小自动选择
      * @return 包含所有商品及其品牌数据的列表
      * @details 解析规则：
      * - 每个Item行后跟若干Brand行构成完整商品数据
      * - 自动建立Item与Brand的关联关系
+     * @note 基于scan实现，结果与逐行读取完全一致
+     */
+    std::list<Item> read(unsigned int workers = 0);
+
+    /**
+     * @brief 逐条访问完整商品数据
+     * @param visit 按文件顺序对每个商品调用一次的访问回调
+     * @param workers 解析线程数，为0时按CPU核数与文件大小自动选择
+     * @return 文件未打开时返回false
+     * @note 每轮读入workers个区段大小的窗口，按ITEM|行切分后并行解析，
+     *       再在当前线程按文件顺序访问；内存占用只与线程数有关，与文件大小无关
      */
-    std::list<Item> read();
+    bool scan(const ItemVisitor &visit, unsigned int workers = 0);
+
+    /**
+     * @brief 读取数据所包含的最后一条日志的序列号
+     * @return 首行LSN|记录的序列号，没有该行时返回0
+     * @note 只读取文件首行
+     */
+    std::uint64_t read_lsn();
 };
 
 
@@ -141,39 +276,906 @@ public:
 };
 
 
+/**
+ * @enum DataFormat
+ * @brief 数据文件格式
+ */
+enum class DataFormat {
+    CSV, ///< 文本格式：ITEM|/BRAND| 行，逐字段解析
+    SNAPSHOT, ///< 二进制快照：定长商品/品牌记录 + 字符串堆，内存映射后直接加载
+    PAGED, ///< 分页格式：定长页 + 编码→页目录，检查点只重写包含脏商品的页
+    LSM ///< 日志结构合并：内存表 + 不可变有序段文件，检查点只写出内存表，段在后台分层合并
+};
+
+
+/**
+ * @class MappedFile
+ * @brief 只读内存映射文件
+ */
+class MappedFile {
+private:
+    const char *data_pointer = nullptr; ///< 映射区起始地址
+    size_t data_size = 0; ///< 映射区字节数
+#ifdef _WIN32
+    void *file_handle = nullptr; ///< 文件句柄
+    void *mapping_handle = nullptr; ///< 映射对象句柄
+#endif
+
+public:
+    MappedFile() = default;
+
+    MappedFile(const MappedFile &) = delete;
+
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    /**
+     * @brief 析构函数
+     * @note 自动解除映射
+     */
+    ~MappedFile();
+
+    /**
+     * @brief 以只读方式映射整个文件
+     * @param path 文件路径
+     * @return 映射成功返回true，文件不存在或为空时返回false
+     */
+    bool map(const std::string &path);
+
+    /// @brief 解除映射
+    void unmap();
+
+    /// @brief 获取映射区起始地址
+    const char *data() const;
+
+    /// @brief 获取映射区字节数
+    size_t size() const;
+};
+
+
+/**
+ * @class SnapshotFile
+ * @brief 二进制快照文件操作类
+ *
+ * 文件布局：
+ * | 文件头 | 商品记录数组 | 品牌记录数组 | 字符串堆 |
+ * 商品与品牌均为定长记录，字符串以(偏移, 长度)引用字符串堆，
+ * 读取时整体内存映射，按记录直接拷贝字段，无需逐字段文本解析
+ */
+class SnapshotFile final : public BaseFile {
+public:
+    /**
+     * @brief 构造函数
+     * @param file_path 快照文件路径
+     */
+    explicit SnapshotFile(std::string file_path);
+
+    /**
+     * @brief 写入完整商品数据
+     * @param items 商品数据列表
+     * @param lsn 快照所包含的最后一条日志的序列号
+     * @return 写入成功返回true，写入失败返回false
+     * @note 整个快照先在内存中编码，再一次性写入
+     */
+    bool write(const std::list<Item> &items, std::uint64_t lsn = 0);
+
+    /**
+     * @brief 从数据来源写入完整商品数据
+     * @param source 按编码升序提供全部商品的数据来源
+     * @param lsn 快照所包含的最后一条日志的序列号
+     * @return 写入成功返回true，写入失败返回false
+     */
+    bool write(const ItemSource &source, std::uint64_t lsn = 0);
+
+    /**
+     * @brief 读取完整商品数据
+     * @return 包含所有商品及其品牌数据的列表
+     * @note 通过内存映射读取，无需事先调用open_file_object()
+     */
+    std::list<Item> read() const;
+
+    /**
+     * @brief 读取完整商品数据及其日志序列号
+     * @param lsn 输出快照所包含的最后一条日志的序列号
+     * @return 包含所有商品及其品牌数据的列表
+     * @note 商品与序列号取自同一次映射，快照在读取期间被替换时两者仍属于同一代
+     */
+    std::list<Item> read(std::uint64_t &lsn) const;
+
+    /**
+     * @brief 逐条访问完整商品数据
+     * @param visit 按快照顺序对每个商品调用一次的访问回调
+     * @return 快照无效时返回false
+     */
+    bool scan(const ItemVisitor &visit) const;
+
+    /**
+     * @brief 逐条访问已映射快照中的商品数据
+     * @param image 已映射的快照文件
+     * @param visit 按快照顺序对每个商品调用一次的访问回调
+     * @return 快照无效时返回false
+     * @note 由调用方持有映射，可先读取序列号再访问，两者属于同一代快照
+     */
+    static bool scan(const MappedFile &image, const ItemVisitor &visit);
+
+    /**
+     * @brief 获取已映射快照中的商品数
+     * @param image 已映射的快照文件
+     * @return 商品记录数，快照无效时返回0
+     */
+    static std::uint32_t item_count(const MappedFile &image);
+
+    /**
+     * @brief 按记录序号读取已映射快照中的一个商品
+     * @param image 已映射的快照文件
+     * @param index 记录序号
+     * @param item 输出商品数据
+     * @return 快照或记录无效时返回false
+     * @note 定长记录按序号直接定位，只解码这一个商品
+     */
+    static bool read_item(const MappedFile &image, std::uint32_t index, Item &item);
+
+    /**
+     * @brief 按记录序号读取已映射快照中商品的编码与名称
+     * @param image 已映射的快照文件
+     * @param index 记录序号
+     * @param code 输出商品编码
+     * @param name 输出商品名称
+     * @return 快照或记录无效时返回false
+     * @note 不解码颜色与品牌，用于建立目录与名称索引
+     */
+    static bool read_key(const MappedFile &image, std::uint32_t index, int &code, std::string &name);
+
+    /**
+     * @brief 读取已映射快照所包含的最后一条日志的序列号
+     * @param image 已映射的快照文件
+     * @return 文件头中记录的序列号，快照无效时返回0
+     */
+    static std::uint64_t read_lsn(const MappedFile &image);
+
+    /**
+     * @brief 读取快照所包含的最后一条日志的序列号
+     * @return 文件头中记录的序列号，文件无效时返回0
+     * @note 只读取文件头
+     */
+    std::uint64_t read_lsn() const;
+
+    /**
+     * @brief 判断文件是否为二进制快照
+     * @param path 文件路径
+     * @return 文件以快照魔数开头时返回true
+     */
+    static bool is_snapshot(const std::string &path);
+
+    /**
+     * @brief 将CSV数据文件转换为二进制快照
+     * @param csv_path CSV数据文件路径
+     * @param snapshot_path 输出快照路径
+     * @return 转换成功返回true
+     */
+    static bool convert_from_csv(const std::string &csv_path, const std::string &snapshot_path);
+
+    /**
+     * @brief 将二进制快照转换为CSV数据文件
+     * @param snapshot_path 快照文件路径
+     * @param csv_path 输出CSV数据文件路径
+     * @return 转换成功返回true
+     */
+    static bool convert_to_csv(const std::string &snapshot_path, const std::string &csv_path);
+};
+
+
+/**
+ * @class PagedFile
+ * @brief 分页数据文件操作类
+ *
+ * 文件由定长页组成，第0页为文件头，其余为数据页。数据页以16字节页头开始：
+ * | CRC32 u32 | 页类型 u16 | 记录数 u16 | 已用字节 u32 | 连续页数 u32 |
+ * 普通页依次存放多条记录，每条记录为 | 负载长度 u32 | 商品编码 i32 | 负载 |，
+ * 负载为商品的ITEM|行及其BRAND|行；单页放不下的商品独占一段连续页。
+ *
+ * 打开时扫描全部页头，在内存中建立编码→页目录与每页的空闲空间表，
+ * 之后的检查点只读取并重写包含脏商品的页，I/O量与修改的商品数成正比。
+ * 被改写的页先写入"<路径>.journal"并落盘，再原地覆盖；
+ * 崩溃后再次打开时按日志重做，数据页不会出现写了一半的状态
+ */
+class PagedFile final : public BaseFile, public ReadLogic, public WriteLogic {
+private:
+    std::uint32_t page_size; ///< 页大小（已有文件以文件头为准）
+    std::uint32_t page_count = 0; ///< 页数（含文件头页）
+    std::uint64_t last_lsn = 0; ///< 数据所包含的最后一条日志的序列号
+    std::map<int, std::uint32_t> directory; ///< 商品编码 → 所在页（连续页时为首页）
+    std::vector<std::uint32_t> free_space; ///< 每页剩余可用字节数（文件头页与连续页为0）
+    std::set<std::pair<std::uint32_t, std::uint32_t>> free_pages; ///< (剩余字节数, 页号)，按所需空间查找可用页
+    std::uint32_t written_pages = 0; ///< 上一次写入改写的页数
+
+    /**
+     * @brief 更新页的剩余可用字节数
+     * @param number 页号（超出当前页表时扩展）
+     * @param bytes 剩余可用字节数
+     */
+    void set_free_space(std::uint32_t number, std::uint32_t bytes);
+
+    /// @brief 获取重做日志路径
+    std::string journal_path() const;
+
+    /**
+     * @brief 按重做日志补写上一次未完成的页改写
+     * @note 日志不完整时说明原地改写尚未开始，直接丢弃
+     */
+    void recover();
+
+    /**
+     * @brief 读取文件头并扫描全部数据页
+     * @return 文件有效时返回true
+     */
+    bool load();
+
+    /**
+     * @brief 读取一页
+     * @param number 页号
+     * @param page 输出页内容
+     * @return 读取完整且校验通过返回true
+     */
+    bool read_page(std::uint32_t number, std::string &page);
+
+    /**
+     * @brief 先写重做日志，再原地改写页并更新文件头
+     * @param pages 待写入的完整页（页号 → 页内容）
+     * @return 写入成功返回true
+     */
+    bool write_pages(const std::map<std::uint32_t, std::string> &pages);
+
+    /// @brief 按当前页数与序列号编码文件头页
+    std::string encode_header() const;
+
+public:
+    /**
+     * @brief 构造函数
+     * @param file_path 数据文件路径
+     * @param page_size 新建文件时采用的页大小（字节）
+     */
+    explicit PagedFile(std::string file_path, std::uint32_t page_size = 4096);
+
+    /**
+     * @brief 打开数据文件并建立页目录
+     * @return 成功打开有效的分页文件返回true
+     * @note 存在重做日志时先完成上一次中断的改写
+     */
+    bool open_file_object() override;
+
+    /**
+     * @brief 整体写入完整商品数据
+     * @param source 按编码升序提供全部商品的数据来源
+     * @param lsn 数据所包含的最后一条日志的序列号
+     * @return 写入成功返回true
+     * @note 用于首次写入或由其他格式转换，原子替换整个文件后重新打开
+     */
+    bool write(const ItemSource &source, std::uint64_t lsn = 0);
+
+    /**
+     * @brief 只改写受影响的页
+     * @param changes 变化的商品（编码 → 新数据，为nullptr时删除）
+     * @param lsn 改写后数据所包含的最后一条日志的序列号
+     * @return 写入成功返回true，文件未打开时返回false
+     * @note 商品优先留在原页，放不下时移入有空闲空间的页，没有时追加新页；
+     *       写入失败时重新打开文件，页目录与磁盘内容保持一致
+     */
+    bool apply(const std::map<int, const Item *> &changes, std::uint64_t lsn);
+
+    /**
+     * @brief 判断商品是否存在
+     * @param code 商品编码
+     * @return 页目录中存在该编码时返回true
+     */
+    bool contains(int code) const;
+
+    /// @brief 获取数据所包含的最后一条日志的序列号
+    std::uint64_t get_last_lsn() const;
+
+    /// @brief 获取页数（含文件头页）
+    std::uint32_t get_page_count() const;
+
+    /// @brief 获取上一次写入改写的页数（含文件头页）
+    std::uint32_t get_written_pages() const;
+
+    /**
+     * @brief 按编码升序逐条访问已映射分页文件中的商品
+     * @param image 已映射的分页文件
+     * @param visit 访问回调
+     * @return 文件无效时返回false
+     * @note 先扫描页头收集记录位置并按编码排序，再逐条解析，只保留位置表
+     */
+    static bool scan(const MappedFile &image, const ItemVisitor &visit);
+
+    /**
+     * @brief 读取已映射分页文件所包含的最后一条日志的序列号
+     * @param image 已映射的分页文件
+     * @return 文件头中记录的序列号，文件无效时返回0
+     */
+    static std::uint64_t read_lsn(const MappedFile &image);
+
+    /**
+     * @brief 判断文件是否为分页数据文件
+     * @param path 文件路径
+     * @return 文件以分页格式魔数开头时返回true
+     */
+    static bool is_paged(const std::string &path);
+};
+
+
+/**
+ * @enum LogFormat
+ * @brief 操作日志文件格式
+ */
+enum class LogFormat {
+    TEXT, ///< 文本格式：[insert]/[update]/[delete]N 标记行后跟 ITEM|/BRAND| 行
+    BINARY ///< 二进制格式：每条记录为 长度 + 类型 + 商品编码 + 负载 + CRC32 组成的帧
+};
+
+
+/**
+ * @enum OperationType
+ * @brief 操作日志记录类型
+ */
+enum class OperationType : unsigned char {
+    INSERT_ITEM = 1, ///< 插入商品
+    UPDATE_ITEM = 2, ///< 更新商品
+    DELETE_ITEM = 3 ///< 删除商品
+};
+
+
+/**
+ * @struct Operation
+ * @brief 单条操作日志记录
+ */
+struct Operation {
+    OperationType type; ///< 操作类型
+    int code; ///< 目标商品编码
+    std::string payload; ///< 商品数据（ITEM|行及其BRAND|行，以换行分隔；删除操作为空）
+    std::uint64_t lsn; ///< 日志序列号（追加时为0则自动分配；旧格式日志读出为0）
+};
+
+
+/**
+ * @enum Durability
+ * @brief 操作日志持久化级别
+ */
+enum class Durability {
+    SYNC, ///< 每条记录写入后立即fsync，不丢失已返回的写入
+    GROUP, ///< 组提交：记录先进入内存缓冲，攒满N条或首条等待超过T微秒后一次write+fsync，
+           ///< 崩溃时最多丢失最近一组（不超过N条、T微秒内）的记录
+    BUFFERED ///< 每条记录写入操作系统缓冲但不fsync，进程崩溃不丢失，系统掉电可能丢失
+};
+
+
 /**
  * @class OperationFile
  * @brief 操作日志文件管理类
+ *
+ * 在内存中维护记录数量、文件字节长度以及每条记录的起始偏移，
+ * 打开文件时扫描一次重建，之后的追加操作为O(1)，无需重新扫描日志。
+ *
+ * 二进制格式文件以8字节魔数开头，其后每条记录布局为：
+ * | 负载长度 u32 | 类型 u8 | 商品编码 i32 | 负载 | CRC32 u32 |
+ * 长度前缀使回放可以整条跳过记录，CRC用于检测尾部写入不完整的记录
  */
-class OperationFile final : public BaseFile {
+class OperationFile final : public BaseFile, public ReadLogic {
+private:
+    LogFormat format; ///< 当前文件的日志格式
+    LogFormat preferred_format; ///< 新建或清空日志时采用的格式
+    std::streamoff tail_offset = 0; ///< 日志文件当前字节长度（即下一次追加的位置）
+    std::vector<std::streamoff> record_offsets; ///< 每条操作记录的起始偏移
+    std::vector<unsigned long> sealed_numbers; ///< 已封存日志段的序号（升序）
+    std::streamoff frame_head_size = 0; ///< 二进制帧头字节数（随文件头版本不同）
+    std::uint64_t last_lsn = 0; ///< 已分配的最大日志序列号（清空或轮转后保留）
+
+    Durability durability = Durability::BUFFERED; ///< 持久化级别
+    int group_records = 1; ///< 组提交的最大记录数
+    std::chrono::microseconds group_interval{0}; ///< 组提交的最长等待时间
+    std::string pending; ///< 组提交缓冲（逻辑上位于文件末尾，尚未写入）
+    int pending_records = 0; ///< 组提交缓冲中的记录数
+    std::chrono::steady_clock::time_point pending_since; ///< 组提交缓冲中首条记录的写入时间
+    int sync_fd = -1; ///< 同步日志使用的文件描述符（首次同步时打开，关闭日志时释放）
+
+    /**
+     * @brief 按持久化级别写入一段已编码的日志
+     * @param bytes 日志字节
+     * @param records 其中包含的记录数
+     * @return 写入成功返回true
+     */
+    bool write_bytes(const std::string &bytes, int records);
+
+    /**
+     * @brief 通过常驻的描述符将日志同步到磁盘
+     * @return 同步成功返回true
+     * @note 不必每次按路径重新打开文件
+     */
+    bool sync();
+
+    /// @brief 释放同步使用的文件描述符
+    void release_sync_descriptor();
+
+    /// @brief 扫描日志所在目录，重建封存段序号表
+    void load_segments();
+
+    /**
+     * @brief 扫描日志文件，重建记录偏移表与文件长度
+     * @note 仅在打开文件时调用；会根据文件头识别日志格式，
+     *       二进制格式下发现尾部记录不完整时将其截断
+     * @throw std::runtime_error 损坏的记录之后仍有完整的记录（日志中部损坏），文件保持原样
+     */
+    void rebuild_index();
+
+    /// @brief 文本格式下重建偏移表
+    void rebuild_text_index();
+
+    /// @brief 二进制格式下按长度前缀逐帧跳读重建偏移表
+    void rebuild_binary_index();
+
+    /**
+     * @brief 读取指定偏移处的二进制记录
+     * @param offset 记录起始偏移
+     * @param operation 输出的操作记录
+     * @return 记录完整且校验通过返回true
+     */
+    bool read_frame(std::streamoff offset, Operation &operation);
+
+    /**
+     * @brief 查找指定范围内第一条完整且校验通过的二进制记录
+     * @param from 查找起点（含）
+     * @param end 查找终点（不含）
+     * @param operation 输出找到的记录
+     * @return 记录的起始偏移，不存在时返回-1
+     * @note 只在发现损坏记录时调用，用于区分撕裂的尾部与日志中部的损坏
+     */
+    std::streamoff find_valid_frame(std::streamoff from, std::streamoff end, Operation &operation);
+
+    /**
+     * @brief 将文件截断到指定长度并同步内存状态
+     * @param length 截断后的文件长度
+     */
+    void truncate_to(std::streamoff length);
+
+    /**
+     * @brief 将操作记录转换为文本格式
+     * @param operation 操作记录
+     * @param lsn 日志序列号（为0时标记行不带"@序列号"）
+     * @return 不含结尾空行的文本记录
+     */
+    static std::string to_text(const Operation &operation, std::uint64_t lsn);
+
+    /**
+     * @brief 将操作记录编码为二进制帧
+     * @param operation 操作记录
+     * @param lsn 日志序列号
+     * @return 按当前文件头版本编码的完整二进制帧
+     */
+    std::string to_frame(const Operation &operation, std::uint64_t lsn) const;
+
 public:
-    using BaseFile::BaseFile;
+    /**
+     * @brief 构造函数
+     * @param file_path 日志文件路径
+     * @param format 新建日志时采用的格式（已有日志按文件头自动识别）
+     * @note 日志文件以二进制模式打开，记录偏移即为文件字节偏移
+     */
+    explicit OperationFile(std::string file_path, LogFormat format = LogFormat::TEXT);
+
+    /**
+     * @brief 析构函数
+     * @note 提交组提交缓冲中尚未写入的记录
+     */
+    ~OperationFile() override;
+
+    /**
+     * @brief 打开日志文件并重建记录索引
+     * @return 成功打开返回true，文件已打开或路径无效时返回false
+     * @throw std::runtime_error 二进制日志中部损坏，文件保持原样且不处于打开状态
+     */
+    bool open_file_object() override;
+
+    /**
+     * @brief 提交缓冲后关闭日志文件
+     * @return 成功关闭返回true，文件未打开时返回false
+     */
+    bool close_file_object() override;
+
+    /**
+     * @brief 设置持久化级别
+     * @param mode 持久化级别
+     * @param records 组提交的最大记录数（仅GROUP级别有效）
+     * @param interval_us 组提交的最长等待微秒数（仅GROUP级别有效）
+     */
+    void set_durability(Durability mode, int records, int interval_us);
+
+    /**
+     * @brief 提交组提交缓冲
+     * @return 缓冲为空或写入并fsync成功时返回true
+     * @note 缓冲中的全部记录以一次write()写入并执行一次fsync；
+     *       写入或fsync失败时这一组记录从偏移表与文件中移除
+     */
+    bool commit();
 
     /**
-     * @brief 追加操作记录
+     * @brief 获取组提交缓冲中的记录数
+     * @return 尚未写入文件的记录数
+     */
+    int pending_size() const;
+
+    /**
+     * @brief 获取组提交缓冲的提交截止时间
+     * @return 首条缓冲记录的写入时间加上组提交等待时间
+     */
+    std::chrono::steady_clock::time_point commit_deadline() const;
+
+    /**
+     * @brief 追加原始文本行
      * @param line 操作日志内容
-     * @return 写入成功返回true，文件未打开时返回false
-     * @note 自动添加换行符
+     * @return 写入成功返回true，文件未打开或日志为二进制格式时返回false
+     * @note 自动添加换行符，同时增量更新记录计数与偏移表
      */
     bool append(const std::string &line);
 
+    /**
+     * @brief 追加一条操作记录
+     * @param operation 操作记录
+     * @return 写入成功返回true，文件未打开时返回false
+     * @note 整条记录先在内存中编码，再以一次write()写入；
+     *       operation.lsn为0时分配下一个日志序列号
+     */
+    bool append(const Operation &operation);
+
+    /**
+     * @brief 获取已分配的最大日志序列号
+     * @return 最后一条记录的序列号，尚未分配时返回0
+     */
+    std::uint64_t get_last_lsn() const;
+
+    /**
+     * @brief 推进日志序列号
+     * @param lsn 已被数据文件或封存段使用的序列号
+     * @note 之后追加的记录序列号均大于lsn；lsn小于当前值时不变
+     */
+    void advance_lsn(std::uint64_t lsn);
+
+    /**
+     * @brief 读取全部操作记录
+     * @return 按写入顺序排列的操作记录
+     * @note 二进制格式直接按帧头取得类型与编码，无需解析负载
+     * @throw std::runtime_error 二进制日志中某条记录校验失败，异常信息给出其偏移与序列号缺口
+     */
+    std::list<Operation> read_operations();
+
     /**
      * @brief 弹出最后一条操作记录
      * @return 被移除的操作记录内容
-     * @warning 文件未打开时返回空字符串
-     * @note 会物理删除文件最后一行
+     * @warning 文件未打开时返回"FOE"，日志为空时返回"FIE"
+     * @note 文本格式删除文件最后一行，二进制格式删除最后一帧；
+     *       两者都只读取被删除的部分，再将文件截断到其起始偏移
      */
     std::string pop();
 
     /**
      * @brief 清空所有操作记录
-     * @return 被清除的操作记录列表
-     * @note 清空后文件内容为空
+     * @return 被清除的操作记录列表（二进制记录以文本格式返回）
+     * @note 需要返回原有内容，耗时与日志长度成正比；只需丢弃日志时使用reset()
      */
     std::list<std::string> clear();
 
+    /**
+     * @brief 丢弃活动日志段中的所有操作记录
+     * @note 与clear()不同，不读取原有内容，清空后改用构造时指定的格式；
+     *       不影响已封存的日志段
+     */
+    void reset();
+
+    /**
+     * @brief 以给定操作记录整体替换日志内容
+     * @param operations 新的操作记录（保留各自的序列号）
+     * @return 替换成功返回true
+     * @note 新内容写入临时文件并落盘后再原子重命名覆盖原文件，崩溃时原文件保持完整；
+     *       沿用当前日志格式，二进制格式统一改写为带序列号的新版帧头
+     */
+    bool rewrite(const std::list<Operation> &operations);
 
- int size();
+    /**
+     * @brief 轮转日志
+     * @return 轮转成功返回true
+     * @note 活动日志段整体重命名为下一个编号的封存段"<日志路径>.<序号>"，
+     *       随后在原路径打开一个空日志段，不复制任何内容
+     */
+    bool rotate();
+
+    /**
+     * @brief 获取已封存的日志段
+     * @return 封存段路径，按封存先后排列
+     */
+    std::vector<std::string> sealed_segments() const;
+
+    /**
+     * @brief 删除最早封存的若干日志段
+     * @param count 删除的日志段数量
+     * @note 已合并进数据文件的日志段整体删除，不读取其内容
+     */
+    void remove_sealed(std::size_t count);
+
+    /**
+     * @brief 获取指定编号的封存段路径
+     * @param number 封存段序号
+     * @return "<日志路径>.<序号>"
+     */
+    std::string segment_path(unsigned long number) const;
+
+    /**
+     * @brief 获取当前日志格式
+     * @return 当前文件的日志格式
+     */
+    LogFormat get_format() const;
+
+    /**
+     * @brief 获取操作记录数量
+     * @return 操作记录条数
+     * @note 直接返回内存中维护的计数，O(1)
+     */
+    int size() const;
+
+    /**
+     * @brief 获取日志文件字节长度
+     * @return 当前日志文件的字节数
+     */
+    std::streamoff length() const;
+
+    /**
+     * @brief 获取每条操作记录的起始偏移
+     * @return 按写入顺序排列的偏移表
+     */
+    const std::vector<std::streamoff> &offsets() const;
+};
+
+
+/**
+ * @enum LsmEntryType
+ * @brief LSM内存表与段文件中单个商品的记录类型
+ */
+enum class LsmEntryType : unsigned char {
+    SET = 1, ///< 商品为负载中的数据
+    UPDATED = 2, ///< 更旧的层中存在该商品时替换为负载中的数据，否则不存在
+    DELETED = 3 ///< 商品已删除（墓碑）
+};
+
+
+/**
+ * @struct LsmEntry
+ * @brief LSM内存表中单个商品的记录
+ */
+struct LsmEntry {
+    LsmEntryType type; ///< 记录类型
+    std::string payload; ///< 商品数据（ITEM|行及其BRAND|行；删除时为空）
+};
+
+
+/**
+ * @struct RunCursor
+ * @brief 段文件的顺序读取位置
+ */
+struct RunCursor {
+    int code = 0; ///< 当前记录的商品编码
+    LsmEntryType type = LsmEntryType::SET; ///< 当前记录的类型
+    const char *payload = nullptr; ///< 当前记录的负载（指向映射区）
+    std::uint32_t length = 0; ///< 当前记录的负载字节数
+    size_t offset = 0; ///< 下一条记录的偏移，为0时从第一条开始
+};
+
+/// @brief 逐条访问LSM记录的回调（编码、类型、负载、负载字节数）
+using EntryVisitor = std::function<void(int, LsmEntryType, const char *, std::uint32_t)>;
+
+/// @brief 按编码升序向回调提供全部记录的数据来源
+using EntrySource = std::function<void(const EntryVisitor &)>;
+
+
+/**
+ * @class SortedRun
+ * @brief LSM不可变有序段文件
+ *
+ * 文件以8字节魔数开头，其后记录按商品编码严格升序排列，每条记录为：
+ * | 类型 u8 | 商品编码 i32 | 负载长度 u32 | 负载 |
+ * 文件以 | 记录数 u32 | CRC32 u32 | 结尾。写入后不再修改，读取通过内存映射完成。
+ * 段被合并后标记为废弃，最后一个持有者释放时删除文件，正在扫描的读者不受影响
+ */
+class SortedRun final : public BaseFile {
+private:
+    MappedFile image; ///< 已映射的段文件
+    std::uint32_t count = 0; ///< 记录数
+    bool obsolete = false; ///< 是否已被合并，析构时删除文件
+
+public:
+    /**
+     * @brief 构造函数
+     * @param file_path 段文件路径
+     */
+    explicit SortedRun(std::string file_path);
+
+    /**
+     * @brief 析构函数
+     * @note 已废弃的段在解除映射后删除文件
+     */
+    ~SortedRun() override;
+
+    /**
+     * @brief 写入段文件并映射
+     * @param source 按编码严格升序提供记录的数据来源
+     * @return 写入并映射成功返回true
+     * @note 先写临时文件并落盘，再重命名为段文件
+     */
+    bool write(const EntrySource &source);
+
+    /**
+     * @brief 映射已有段文件并校验
+     * @return 文件完整且校验通过返回true
+     */
+    bool load();
+
+    /**
+     * @brief 读取下一条记录
+     * @param cursor 读取位置，成功时更新为该记录
+     * @return 已无更多记录时返回false
+     */
+    bool next(RunCursor &cursor) const;
+
+    /// @brief 标记段已被合并，最后一个持有者释放时删除文件
+    void mark_obsolete();
+
+    /// @brief 获取记录数
+    std::uint32_t size() const;
+};
+
+
+/**
+ * @class LsmStore
+ * @brief 日志结构合并存储
+ *
+ * 操作日志充当预写日志：每条已写入日志的操作同时进入内存表，
+ * 检查点将内存表写成一个不可变的有序段文件（第0层），不读取也不改写已有数据。
+ * 同一层的段达到fanout个后合并为下一层的一个段，每条记录在每一层只被重写一次，
+ * 写放大由层数决定而不随每次检查点的数据量增长；合并到最旧的段时丢弃墓碑。
+ *
+ * 数据文件路径保存清单（文本），记录段文件序号、层号及段所包含的最后一条日志的序列号；
+ * 段文件名为"<路径>.run.<序号>"，清单以原子重命名替换，不在清单中的段文件在打开时删除
+ */
+class LsmStore final : public BaseFile, public ReadLogic, public WriteLogic {
+private:
+    /**
+     * @struct RunSlot
+     * @brief 清单中的一个段
+     */
+    struct RunSlot {
+        std::shared_ptr<SortedRun> run; ///< 段文件
+        unsigned long number; ///< 段文件序号
+        unsigned level; ///< 所在层
+    };
+
+    mutable std::mutex store_mutex; ///< 保护内存表、段列表与清单
+    std::mutex flush_mutex; ///< 同一时刻只有一次内存表落盘
+    std::mutex compaction_mutex; ///< 同一时刻只有一次段合并
+    std::map<int, LsmEntry> memtable; ///< 内存表（尚未落盘的修改）
+    std::shared_ptr<const std::map<int, LsmEntry>> immutable; ///< 正在写出的内存表，写出期间仍可读取
+    std::vector<RunSlot> runs; ///< 段列表，由新到旧排列，同一层的段相邻
+    std::uint64_t last_lsn = 0; ///< 段文件所包含的最后一条日志的序列号
+    std::uint64_t memtable_lsn = 0; ///< 内存表所包含的最后一条日志的序列号
+    unsigned long next_number = 1; ///< 下一个段文件序号
+    unsigned fanout; ///< 同一层触发合并的段数
+    bool is_open = false; ///< 是否已读取清单
+
+    /**
+     * @brief 获取段文件路径
+     * @param number 段文件序号
+     */
+    std::string run_path(unsigned long number) const;
+
+    /**
+     * @brief 按当前段列表原子替换清单
+     * @return 写入成功返回true
+     * @note 调用方须持有store_mutex
+     */
+    bool write_manifest();
+
+    /**
+     * @brief 查找最浅一层达到fanout的段
+     * @param first 输出该层第一个段在段列表中的下标
+     * @param last 输出该层最后一个段之后的下标
+     * @return 存在需要合并的层时返回true
+     * @note 调用方须持有store_mutex
+     */
+    bool find_compaction(size_t &first, size_t &last) const;
+
+public:
+    /**
+     * @brief 构造函数
+     * @param file_path 清单文件路径（即数据文件路径）
+     * @param fanout 同一层触发合并的段数（至少为2）
+     */
+    explicit LsmStore(std::string file_path, unsigned fanout = 4);
+
+    /**
+     * @brief 读取清单并映射全部段文件
+     * @return 清单存在且全部段文件有效时返回true
+     * @note 不创建缺失的文件；删除上一次中断的写入或合并遗留的段文件
+     */
+    bool open_file_object() override;
+
+    /**
+     * @brief 关闭存储
+     * @return 存储已打开时返回true，否则返回false
+     * @note 丢弃内存表，段文件在最后一个读者释放后解除映射
+     */
+    bool close_file_object() override;
+
+    /**
+     * @brief 以完整商品数据替换全部内容
+     * @param source 按编码升序提供全部商品的数据来源
+     * @param lsn 数据所包含的最后一条日志的序列号
+     * @return 写入成功返回true
+     * @note 用于由其他格式转换，写出一个位于最深层的基础段；成功后存储处于打开状态
+     */
+    bool write(const ItemSource &source, std::uint64_t lsn = 0);
+
+    /**
+     * @brief 将已写入日志的操作加入内存表
+     * @param operation 操作记录
+     * @param lsn 操作的日志序列号
+     */
+    void apply(const Operation &operation, std::uint64_t lsn);
+
+    /**
+     * @brief 将内存表写成第0层的段文件并更新清单
+     * @return 写入成功或内存表为空时返回true
+     * @note 写出期间不持有锁，新的操作进入新的内存表；失败时内存表内容保留
+     */
+    bool flush();
+
+    /// @brief 判断是否有某一层的段数达到fanout
+    bool needs_compaction() const;
+
+    /**
+     * @brief 将最浅一层达到fanout的段合并为下一层的一个段
+     * @return 完成一次合并返回true，无需合并或写入失败时返回false
+     * @note 合并期间不持有锁，读者与内存表落盘不受影响
+     */
+    bool compact();
+
+    /**
+     * @brief 按编码升序逐条访问当前全部商品
+     * @param visit 访问回调
+     * @note 在锁内取得内存表副本与段列表后归并，回调期间不持有锁
+     */
+    void scan(const ItemVisitor &visit) const;
+
+    /// @brief 获取段文件所包含的最后一条日志的序列号
+    std::uint64_t get_last_lsn() const;
+
+    /// @brief 获取段文件数
+    size_t run_count() const;
+
+    /**
+     * @brief 读取清单中记录的序列号
+     * @param path 清单文件路径
+     * @return 序列号，文件不是有效清单时返回0
+     */
+    static std::uint64_t read_lsn(const std::string &path);
+
+    /**
+     * @brief 判断文件是否为LSM清单
+     * @param path 文件路径
+     * @return 文件以清单魔数行开头时返回true
+     */
+    static bool is_lsm(const std::string &path);
+
+    /**
+     * @brief 删除清单对应的全部段文件
+     * @param path 清单文件路径
+     * @note 用于数据文件已被其他格式替换之后
+     */
+    static void remove_runs(const std::string &path);
 };
 
 #endif //STORAGE_H
@@ -1,14 +1,20 @@
 ﻿#include "../include/cache.h"
 
+#include <iterator>
 #include <stdexcept>
 
 
 // 构造函数初始化缓存最大容量
-LRUCache::LRUCache(const int max_cache_number) {
+LRUCache::LRUCache(const int max_cache_number) : own_pool(new StringPool()), pool(own_pool.get()) {
     max_cache = max_cache_number;   // 设置缓存容量上限
 }
 
 
+LRUCache::LRUCache(const int max_cache_number, StringPool &shared_pool) : pool(&shared_pool) {
+    max_cache = max_cache_number;
+}
+
+
 // 根据商品编码查询（会更新访问顺序）
 Item LRUCache::select(const int index) {
     if (!code_to_item.count(index)) {
@@ -24,12 +30,13 @@ Item LRUCache::select(const int index) {
 
 // 根据商品名称查询（会更新访问顺序）
 Item LRUCache::select(const std::string &name) {
-    if (!name_to_item.count(name)) {
+    std::uint32_t id = 0;
+    if (!pool->find(name, id) || !name_to_item.count(id)) {
         throw std::out_of_range("No such item");
     }
 
     // 将找到的元素移动到链表头部（表示最近使用）
-    const auto iter = name_to_item.at(name);
+    const auto iter = name_to_item.at(id);
     cache.splice(cache.begin(), cache, iter);  // 链表节点转移操作
     return *iter;
 }
@@ -44,7 +51,7 @@ bool LRUCache::del(const int index) {
     // 同时删除两个哈希表的映射关系
     const auto iter = code_to_item.at(index);
     code_to_item.erase(index);
-    name_to_item.erase(iter->name);  // 通过迭代器获取商品名称
+    erase_name(iter->name, iter);  // 通过迭代器获取商品名称
 
     cache.erase(iter);// 从链表移除
     return true;
@@ -53,14 +60,16 @@ bool LRUCache::del(const int index) {
 
 // 根据名称删除缓存项
 bool LRUCache::del(const std::string &name) {
-    if (!name_to_item.count(name)) {
+    std::uint32_t id = 0;
+    if (!pool->find(name, id) || !name_to_item.count(id)) {
         return false;
     }
 
     // 删除双哈希表映射
-    const auto iter = name_to_item.at(name);
+    const auto iter = name_to_item.at(id);
     code_to_item.erase(iter->code);  // 通过迭代器获取商品编码
-    name_to_item.erase(name);
+    name_to_item.erase(id);
+    pool->release(id);
 
     cache.erase(iter);
     return true;
@@ -72,26 +81,53 @@ void LRUCache::insert(const Item &item) {
     // 存在则更新值并移动位置
     if (code_to_item.count(item.code)) {
         const auto iter = code_to_item.at(item.code);
+        if (iter->name != item.name) {
+            erase_name(iter->name, iter);  // 改名后旧名称不再指向该商品
+        }
         *iter = item;  // 直接修改链表节点值
         cache.splice(cache.begin(), cache, iter);  // 移动到头部
 
-        name_to_item.erase(item.name);
-        name_to_item[item.name] = code_to_item[item.code];
+        put_name(item.name, iter);
         return;
     }
 
     // 插入新元素到链表头部
     cache.emplace_front(item);
     code_to_item[item.code] = cache.begin();   // 记录编码映射
-    name_to_item[item.name] = cache.begin();   // 记录名称映射
+    put_name(item.name, cache.begin());        // 记录名称映射
 
     // 缓存淘汰机制：超过容量时移除末尾元素
     if (cache.size() > max_cache) {
-        const Item value = cache.back();  // 获取要被淘汰的元素
+        const auto last = std::prev(cache.end());  // 获取要被淘汰的元素
 
         // 清理两个哈希表的映射关系
-        code_to_item.erase(value.code);
-        name_to_item.erase(value.name);
+        code_to_item.erase(last->code);
+        erase_name(last->name, last);
         cache.pop_back();  // 移除链表末尾
     }
 }
+
+
+// 名称映射的每个键持有一次驻留引用
+void LRUCache::put_name(const std::string &name, const std::list<Item>::iterator iter) {
+    const auto inserted = name_to_item.emplace(pool->intern(name), iter);
+    if (!inserted.second) {
+        inserted.first->second = iter;
+        pool->release(inserted.first->first);
+    }
+}
+
+
+void LRUCache::erase_name(const std::string &name, const std::list<Item>::iterator iter) {
+    std::uint32_t id = 0;
+    if (!pool->find(name, id)) {
+        return;
+    }
+
+    // 同名的其他商品占用该名称时保留映射
+    const auto found = name_to_item.find(id);
+    if (found != name_to_item.end() && found->second == iter) {
+        name_to_item.erase(found);
+        pool->release(id);
+    }
+}
@@ -0,0 +1,208 @@
+﻿#include "../include/column.h"
+
+
+ColumnStore::ColumnStore(StringPool &pool)
+    : generation(new Region()),
+      row_of(0, std::hash<int>(), std::equal_to<int>(), RowIndex::allocator_type(*generation)), strings(&pool) {
+}
+
+
+void ColumnStore::upsert(const Item &item) {
+    remove(item.code);
+
+    row_of[item.code] = static_cast<std::uint32_t>(codes.size());
+    codes.push_back(item.code);
+    quantities.push_back(item.quantity);
+    colour_ids.push_back(strings->intern(item.colour));
+    brand_begins.push_back(static_cast<std::uint32_t>(brand_owners.size()));
+    brand_counts.push_back(static_cast<std::uint32_t>(item.brand_list.size()));
+    live.push_back(true);
+
+    // 同一商品的品牌连续追加，所属行号即刚追加的商品行
+    const auto owner = static_cast<std::uint32_t>(codes.size() - 1);
+    for (const auto &brand : item.brand_list) {
+        brand_owners.push_back(owner);
+        brand_codes.push_back(brand.code);
+        brand_name_ids.push_back(strings->intern(brand.name));
+        brand_quantities.push_back(brand.quantity);
+        brand_prices.push_back(brand.price);
+    }
+}
+
+
+bool ColumnStore::remove(const int code) {
+    const auto found = row_of.find(code);
+    if (found == row_of.end()) {
+        return false;
+    }
+
+    release_row(found->second);
+    live[found->second] = false;
+    row_of.erase(found);
+
+    if (codes.size() - row_of.size() > row_of.size()) {
+        compact();
+    }
+    return true;
+}
+
+
+void ColumnStore::release_row(const std::uint32_t row) {
+    strings->release(colour_ids[row]);
+    for (std::uint32_t i = brand_begins[row]; i < brand_begins[row] + brand_counts[row]; ++i) {
+        strings->release(brand_name_ids[i]);
+    }
+}
+
+
+void ColumnStore::compact() {
+    std::unique_ptr<Region> next_generation(new Region());
+    RowIndex next_row_of(row_of.size(), std::hash<int>(), std::equal_to<int>(),
+                         RowIndex::allocator_type(*next_generation));
+
+    // 有效行与其品牌原地前移，驻留编号不变
+    std::uint32_t row = 0;
+    std::uint32_t brand_row = 0;
+    for (std::uint32_t old_row = 0; old_row < codes.size(); ++old_row) {
+        if (!live[old_row]) {
+            continue;
+        }
+
+        const std::uint32_t begin = brand_begins[old_row];
+        codes[row] = codes[old_row];
+        quantities[row] = quantities[old_row];
+        colour_ids[row] = colour_ids[old_row];
+        brand_begins[row] = brand_row;
+        brand_counts[row] = brand_counts[old_row];
+        next_row_of.emplace(codes[row], row);
+
+        for (std::uint32_t i = begin; i < begin + brand_counts[old_row]; ++i, ++brand_row) {
+            brand_owners[brand_row] = row;
+            brand_codes[brand_row] = brand_codes[i];
+            brand_name_ids[brand_row] = brand_name_ids[i];
+            brand_quantities[brand_row] = brand_quantities[i];
+            brand_prices[brand_row] = brand_prices[i];
+        }
+        ++row;
+    }
+
+    codes.resize(row);
+    quantities.resize(row);
+    colour_ids.resize(row);
+    brand_begins.resize(row);
+    brand_counts.resize(row);
+    live.assign(row, true);
+
+    brand_owners.resize(brand_row);
+    brand_codes.resize(brand_row);
+    brand_name_ids.resize(brand_row);
+    brand_quantities.resize(brand_row);
+    brand_prices.resize(brand_row);
+
+    row_of = std::move(next_row_of);
+    generation = std::move(next_generation);
+}
+
+
+void ColumnStore::clear() {
+    for (const auto &entry : row_of) {
+        release_row(entry.second);
+    }
+    std::unique_ptr<Region> next_generation(new Region());
+    row_of = RowIndex(0, std::hash<int>(), std::equal_to<int>(), RowIndex::allocator_type(*next_generation));
+    generation = std::move(next_generation);
+    codes.clear();
+    quantities.clear();
+    colour_ids.clear();
+    brand_begins.clear();
+    brand_counts.clear();
+    live.clear();
+    brand_owners.clear();
+    brand_codes.clear();
+    brand_name_ids.clear();
+    brand_quantities.clear();
+    brand_prices.clear();
+}
+
+
+std::size_t ColumnStore::size() const {
+    return row_of.size();
+}
+
+
+long long ColumnStore::total_quantity() const {
+    long long total = 0;
+    for (std::size_t row = 0; row < quantities.size(); ++row) {
+        if (live[row]) {
+            total += quantities[row];
+        }
+    }
+    return total;
+}
+
+
+double ColumnStore::stock_value() const {
+    double total = 0;
+    for (std::size_t row = 0; row < brand_prices.size(); ++row) {
+        if (live[brand_owners[row]]) {
+            total += brand_prices[row] * brand_quantities[row];
+        }
+    }
+    return total;
+}
+
+
+std::vector<int> ColumnStore::codes_below_quantity(const int threshold) const {
+    std::vector<int> result;
+    for (std::size_t row = 0; row < quantities.size(); ++row) {
+        if (quantities[row] < threshold && live[row]) {
+            result.push_back(codes[row]);
+        }
+    }
+    return result;
+}
+
+
+std::vector<int> ColumnStore::codes_with_brand(const std::string &brand_name) const {
+    std::vector<int> result;
+    std::uint32_t id = 0;
+    if (!strings->find(brand_name, id)) {
+        return result; // 从未出现过的品牌名称
+    }
+
+    std::uint32_t last_owner = 0;
+    for (std::size_t row = 0; row < brand_name_ids.size(); ++row) {
+        const std::uint32_t owner = brand_owners[row];
+        // 同一商品的品牌连续存放，与上一个命中行相同的所属商品只记录一次
+        if (brand_name_ids[row] == id && live[owner] && (result.empty() || owner != last_owner)) {
+            result.push_back(codes[owner]);
+            last_owner = owner;
+        }
+    }
+    return result;
+}
+
+
+std::vector<std::pair<std::string, long long>> ColumnStore::quantity_by_colour() const {
+    std::unordered_map<std::uint32_t, std::size_t> position; // 驻留编号 → 结果下标
+    std::vector<long long> totals;
+    std::vector<std::uint32_t> order;
+    for (std::size_t row = 0; row < colour_ids.size(); ++row) {
+        if (!live[row]) {
+            continue;
+        }
+        const auto found = position.emplace(colour_ids[row], totals.size());
+        if (found.second) {
+            totals.push_back(0);
+            order.push_back(colour_ids[row]);
+        }
+        totals[found.first->second] += quantities[row];
+    }
+
+    std::vector<std::pair<std::string, long long>> result;
+    result.reserve(order.size());
+    for (std::size_t i = 0; i < order.size(); ++i) {
+        result.emplace_back(strings->str(order[i]), totals[i]);
+    }
+    return result;
+}
@@ -1,116 +1,452 @@
 ﻿
 #include "../include/datatype.h"
 
-#include <sstream>
-
-std::string ReadLogic::unescape_csv_field(const std::string &field) {
-    if (field.size() >= 2 && field.front() == '"' && field.back() == '"') {
-        std::string unescaped;
-        unescaped.reserve(field.length());
-
-        for (size_t i = 1; i < field.size() - 1; ++i) {
-            if (field[i] == '"' && field[i + 1] == '"' && i + 1 < field.size() - 1) {
-                unescaped += '"';
-                ++i;
-            } else {
-                unescaped += field[i];
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
+#include <limits>
+#include <stdexcept>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#define IMS_HAVE_SSE2
+#endif
+
+namespace {
+    // 在[p, end)中查找第一个a或b，没有时返回end
+    const char *find_either(const char *p, const char *end, const char a, const char b) {
+#ifdef IMS_HAVE_SSE2
+        const __m128i first = _mm_set1_epi8(a);
+        const __m128i second = _mm_set1_epi8(b);
+        while (end - p >= 16) {
+            const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+            const int mask = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(chunk, first),
+                                                            _mm_cmpeq_epi8(chunk, second)));
+            if (mask != 0) {
+#ifdef _MSC_VER
+                unsigned long index;
+                _BitScanForward(&index, static_cast<unsigned long>(mask));
+                return p + index;
+#else
+                return p + __builtin_ctz(static_cast<unsigned int>(mask));
+#endif
+            }
+            p += 16;
+        }
+#endif
+        while (p < end && *p != a && *p != b) {
+            ++p;
+        }
+        return p;
+    }
+
+    // 跳过当前字段剩余部分及其后的逗号
+    const char *next_field(const char *p, const char *end) {
+        if (p >= end) {
+            return end;
+        }
+        const char *comma = static_cast<const char *>(std::memchr(p, ',', static_cast<size_t>(end - p)));
+        return comma == nullptr ? end : comma + 1;
+    }
+
+    // 读取文本字段，带引号时去掉外围引号并将""还原为"；写入value，复用其已有容量
+    void read_text(const char *&cursor, const char *end, std::string &value) {
+        if (cursor < end && *cursor == '"') {
+            value.clear();
+            const char *p = cursor + 1;
+            while (p < end) {
+                const char *quote = static_cast<const char *>(std::memchr(p, '"', static_cast<size_t>(end - p)));
+                if (quote == nullptr) {
+                    value.append(p, end); // 引号未闭合，取到行末
+                    p = end;
+                    break;
+                }
+
+                value.append(p, quote);
+                p = quote + 1;
+                if (p < end && *p == '"') {
+                    value += '"';
+                    ++p;
+                    continue;
+                }
+                break;
+            }
+
+            cursor = next_field(p, end);
+            return;
+        }
+
+        // 不带引号的字段原样返回，字段中间出现的引号不做特殊处理
+        const char *p = find_either(cursor, end, ',', '"');
+        while (p < end && *p == '"') {
+            p = find_either(p + 1, end, ',', '"');
+        }
+
+        value.assign(cursor, p);
+        cursor = p < end ? p + 1 : end;
+    }
+
+    // 读取整数字段，与std::stoi一致：允许前导空白与符号，忽略数字之后的字符
+    int read_int(const char *&cursor, const char *end) {
+        const char *p = cursor;
+        while (p < end && (*p == ' ' || *p == '\t')) {
+            ++p;
+        }
+
+        bool negative = false;
+        if (p < end && (*p == '-' || *p == '+')) {
+            negative = *p == '-';
+            ++p;
+        }
+
+        const char *digits = p;
+        long long value = 0;
+        while (p < end && *p >= '0' && *p <= '9') {
+            value = value * 10 + (*p - '0');
+            if (value > static_cast<long long>(std::numeric_limits<int>::max()) + 1) {
+                throw std::out_of_range("integer field out of range");
+            }
+            ++p;
+        }
+
+        if (p == digits) {
+            throw std::invalid_argument("invalid integer field");
+        }
+        if (negative) {
+            value = -value;
+        }
+        if (value > std::numeric_limits<int>::max()) {
+            throw std::out_of_range("integer field out of range");
+        }
+
+        cursor = next_field(p, end);
+        return static_cast<int>(value);
+    }
+
+    // 读取浮点字段
+    double read_double(const char *&cursor, const char *end) {
+        const char *field_end = static_cast<const char *>(std::memchr(cursor, ',', static_cast<size_t>(end - cursor)));
+        if (field_end == nullptr) {
+            field_end = end;
+        }
+
+        const char *p = cursor;
+        while (p < field_end && (*p == ' ' || *p == '\t')) {
+            ++p;
+        }
+
+        bool negative = false;
+        if (p < field_end && (*p == '-' || *p == '+')) {
+            negative = *p == '-';
+            ++p;
+        }
+
+        uint64_t mantissa = 0;
+        int digits = 0;
+        int fraction = 0;
+        while (p < field_end && *p >= '0' && *p <= '9' && digits <= 15) {
+            mantissa = mantissa * 10 + static_cast<uint64_t>(*p - '0');
+            ++digits;
+            ++p;
+        }
+        if (p < field_end && *p == '.') {
+            ++p;
+            while (p < field_end && *p >= '0' && *p <= '9' && digits <= 15) {
+                mantissa = mantissa * 10 + static_cast<uint64_t>(*p - '0');
+                ++digits;
+                ++fraction;
+                ++p;
             }
         }
-        return unescaped;
+
+        // 快速路径：不超过15位有效数字且没有指数时，尾数与10的幂都能精确表示，
+        // 一次除法即得到正确舍入的结果
+        static const double powers[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13,
+                                        1e14, 1e15};
+        if (digits > 0 && digits <= 15 && (p == field_end || *p == '\r' || *p == ' ')) {
+            const double value = static_cast<double>(mantissa) / powers[fraction];
+            cursor = field_end < end ? field_end + 1 : end;
+            return negative ? -value : value;
+        }
+
+        // 其余情况（指数、超长尾数等）交给strtod
+        const std::string field(cursor, field_end);
+        char *parsed_end = nullptr;
+        const double value = std::strtod(field.c_str(), &parsed_end);
+        if (parsed_end == field.c_str()) {
+            throw std::invalid_argument("invalid floating point field");
+        }
+
+        cursor = field_end < end ? field_end + 1 : end;
+        return value;
+    }
+
+    // 按往返精度追加浮点数：优先使用15位有效数字，无法精确还原时使用17位
+    void append_double(std::string &out, const double value) {
+        char buffer[32];
+        int length = std::snprintf(buffer, sizeof(buffer), "%.15g", value);
+        if (std::strtod(buffer, nullptr) != value) {
+            length = std::snprintf(buffer, sizeof(buffer), "%.17g", value);
+        }
+        out.append(buffer, static_cast<size_t>(length));
+    }
+
+    // 追加十进制整数
+    void append_int(std::string &out, const int value) {
+        char buffer[12];
+        char *p = buffer + sizeof(buffer);
+        // 以无符号数计算，INT_MIN取反不会溢出
+        unsigned int magnitude = value < 0 ? 0u - static_cast<unsigned int>(value) : static_cast<unsigned int>(value);
+        do {
+            *--p = static_cast<char>('0' + magnitude % 10);
+            magnitude /= 10;
+        } while (magnitude != 0);
+        if (value < 0) {
+            *--p = '-';
+        }
+        out.append(p, buffer + sizeof(buffer));
     }
-    return field;
 }
 
 
-Brand ReadLogic::parse_brand_line(const std::string &line) {
-    std::istringstream iss(line.substr(6)); // 跳过"BRAND|"
-    std::string token;
-    Brand brand;
+BrandList::BrandList(const std::initializer_list<Brand> brands) {
+    for (const auto &brand : brands) {
+        push_back(brand);
+    }
+}
+
+
+BrandList::BrandList(const BrandList &other) {
+    *this = other;
+}
+
+
+BrandList::BrandList(BrandList &&other) noexcept {
+    *this = std::move(other);
+}
 
-    // 解析名称
-    std::getline(iss, token, ',');
-    brand.name = unescape_csv_field(token);
 
-    // 解析code
-    std::getline(iss, token, ',');
-    brand.code = std::stoi(token);
+BrandList &BrandList::operator=(const BrandList &other) {
+    if (this == &other) {
+        return *this;
+    }
 
-    // 解析quantity
-    std::getline(iss, token, ',');
-    brand.quantity = std::stoi(token);
+    // 只复制已使用的品牌，其余内联位置保持原状
+    if (other.spilled.empty()) {
+        spilled.clear();
+        std::copy(other.inline_brands, other.inline_brands + other.count, inline_brands);
+    } else {
+        spilled.assign(other.spilled.begin(), other.spilled.begin() + other.count);
+    }
+    count = other.count;
+    return *this;
+}
 
-    // 解析price
-    std::getline(iss, token);
-    brand.price = std::stof(token);
 
+BrandList &BrandList::operator=(BrandList &&other) noexcept {
+    if (this == &other) {
+        return *this;
+    }
+
+    if (other.spilled.empty()) {
+        spilled.clear();
+        std::move(other.inline_brands, other.inline_brands + other.count, inline_brands);
+    } else {
+        spilled.swap(other.spilled);
+        other.spilled.clear();
+    }
+    count = other.count;
+    other.count = 0;
+    return *this;
+}
+
+
+void BrandList::spill() {
+    spilled.reserve(static_cast<std::size_t>(MAX_NUMBER));
+    std::move(inline_brands, inline_brands + count, std::back_inserter(spilled));
+}
+
+
+void BrandList::push_back(const Brand &brand) {
+    push_back(Brand(brand));
+}
+
+
+void BrandList::push_back(Brand &&brand) {
+    if (spilled.empty() && count < INLINE_CAPACITY) {
+        inline_brands[count++] = std::move(brand);
+        return;
+    }
+
+    if (spilled.empty()) {
+        spill();
+    }
+    if (count < spilled.size()) {
+        spilled[count] = std::move(brand); // 复用clear()留下的品牌对象
+    } else {
+        spilled.push_back(std::move(brand));
+    }
+    ++count;
+}
+
+
+Brand &BrandList::append() {
+    if (spilled.empty() && count < INLINE_CAPACITY) {
+        return inline_brands[count++];
+    }
+
+    if (!spilled.empty() && count < spilled.size()) {
+        return spilled[count++]; // 保留此前在该位置的字符串容量
+    }
+
+    push_back(Brand());
+    return back();
+}
+
+
+void BrandList::clear() {
+    count = 0; // 已溢出时保留堆上的品牌对象，反复解析进同一列表时不必重新分配
+}
+
+
+bool BrandList::operator==(const BrandList &other) const {
+    return count == other.count && std::equal(begin(), end(), other.begin());
+}
+
+
+Brand ReadLogic::parse_brand_line(const std::string &line) {
+    return parse_brand_line(line.data(), line.size());
+}
+
+
+Brand ReadLogic::parse_brand_line(const char *data, const size_t length) {
+    Brand brand;
+    parse_brand_line(data, length, brand);
     return brand;
 }
 
 
+void ReadLogic::parse_brand_line(const char *data, const size_t length, Brand &brand) {
+    const char *cursor = data + 6; // 跳过"BRAND|"
+    const char *end = data + length;
+
+    read_text(cursor, end, brand.name);
+    brand.code = read_int(cursor, end);
+    brand.quantity = read_int(cursor, end);
+    brand.price = read_double(cursor, end);
+}
+
+
 Item ReadLogic::parse_item_line(const std::string &line) {
-    std::istringstream iss(line.substr(5)); // 跳过"ITEM|"
-    std::string token;
+    return parse_item_line(line.data(), line.size());
+}
+
+
+Item ReadLogic::parse_item_line(const char *data, const size_t length) {
     Item item;
+    parse_item_line(data, length, item);
+    return item;
+}
+
 
-    // 解析名称
-    std::getline(iss, token, ',');
-    item.name = unescape_csv_field(token);
+void ReadLogic::parse_item_line(const char *data, const size_t length, Item &item) {
+    const char *cursor = data + 5; // 跳过"ITEM|"
+    const char *end = data + length;
 
-    // 解析code
-    std::getline(iss, token, ',');
-    item.code = std::stoi(token);
+    read_text(cursor, end, item.name);
+    item.code = read_int(cursor, end);
+    read_text(cursor, end, item.colour);
+    item.quantity = read_int(cursor, end);
 
-    // 解析colour
-    std::getline(iss, token, ',');
-    item.colour = unescape_csv_field(token);
+    // 品牌由后续BRAND|行填入
+    item.brand_list.clear();
+}
 
-    // 解析quantity
-    std::getline(iss, token);
-    item.quantity = std::stoi(token);
 
-    // brand_number暂设为0
-    item.brand_number = 0;
+Item ReadLogic::parse_item_payload(const char *data, const size_t length) {
+    const char *end = data + length;
+    const char *line_end = static_cast<const char *>(std::memchr(data, '\n', length));
+    if (line_end == nullptr) {
+        line_end = end;
+    }
+
+    Item item = parse_item_line(data, static_cast<size_t>(line_end - data));
+    while (line_end < end) {
+        const char *line = line_end + 1;
+        line_end = static_cast<const char *>(std::memchr(line, '\n', static_cast<size_t>(end - line)));
+        if (line_end == nullptr) {
+            line_end = end;
+        }
+        item.brand_list.push_back(parse_brand_line(line, static_cast<size_t>(line_end - line)));
+    }
 
     return item;
 }
 
 
-std::string WriteLogic::escape_csv_field(const std::string &field) {
-    if (field.find('"') != std::string::npos || field.find(',') != std::string::npos) {
-        std::string escaped;
-        escaped.reserve(field.length() + 2);
-        escaped += '"';
+void WriteLogic::append_csv_field(std::string &out, const std::string &field) {
+    if (field.find_first_of("\",") == std::string::npos) {
+        out += field;
+        return;
+    }
+
+    out += '"';
+    for (const char c: field) {
+        if (c == '"') out += "\"\""; // 双引号转义为两个双引号
+        else out += c;
+    }
+    out += '"';
+}
 
-        for (const char c: field) {
-            if (c == '"') escaped += "\"\""; // 双引号转义为两个双引号
-            else escaped += c;
-        }
 
-        escaped += '"';
-        return escaped;
+void WriteLogic::append_brand_csv(std::string &out, const Brand &brand) {
+    out += "BRAND|";
+    append_csv_field(out, brand.name);
+    out += ',';
+    append_int(out, brand.code);
+    out += ',';
+    append_int(out, brand.quantity);
+    out += ',';
+    append_double(out, brand.price);
+}
+
+
+void WriteLogic::append_item_csv(std::string &out, const Item &item) {
+    out += "ITEM|";
+    append_csv_field(out, item.name);
+    out += ',';
+    append_int(out, item.code);
+    out += ',';
+    append_csv_field(out, item.colour);
+    out += ',';
+    append_int(out, item.quantity);
+}
+
+
+void WriteLogic::append_item_payload(std::string &out, const Item &item) {
+    append_item_csv(out, item);
+    for (const auto &brand: item.brand_list) {
+        out += '\n';
+        append_brand_csv(out, brand);
     }
-    return field;
 }
 
 
 std::string WriteLogic::brand_to_csv(const Brand &brand) {
-    std::ostringstream oss;
-    oss << "BRAND|"
-            << escape_csv_field(brand.name) << ","
-            << brand.code << ","
-            << brand.quantity << ","
-            << brand.price;
-    return oss.str();
+    std::string row;
+    append_brand_csv(row, brand);
+    return row;
 }
 
 
 std::string WriteLogic::item_to_csv(const Item &item) {
-    std::ostringstream oss;
-    oss << "ITEM|"
-            << escape_csv_field(item.name) << ","
-            << item.code << ","
-            << escape_csv_field(item.colour) << ","
-            << item.quantity;
-    return oss.str();
+    std::string row;
+    append_item_csv(row, item);
+    return row;
 }
-
@@ -1,6 +1,12 @@
 ﻿#include "../include/engine.h"
 
 #include <algorithm>
+#include <fstream>
+
+
+namespace {
+    constexpr std::uint32_t NO_RECORD = 0xFFFFFFFFu; ///< 目录中已被修改或删除的记录
+}
 
 // 初始化时默认设置获取数量为1
 QueryBuilder::QueryBuilder(Engine *engine_) : engine(engine_) {
@@ -44,22 +50,299 @@ std::vector<Item> QueryBuilder::limit(const int max) {
 // 初始化引擎：加载持久化数据，构建内存索引
 Engine::Engine(const int max_cache, const int max_log,
               const std::string& operation_file_path,
-              const std::string& data_file_path)
-    : persist(data_file_path, operation_file_path, max_log),  // 初始化持久层
-      cache(max_cache) {                                      // 初始化缓存
-    items = persist.select(); // 从持久层加载全部数据
+              const std::string& data_file_path,
+              const EngineConfig &config)
+    : persist(data_file_path, operation_file_path, max_log, persist_config(config)),  // 初始化持久层
+      cache(max_cache, strings), index(strings), generation(new Region()),
+      slot_of(std::less<int>(), SlotIndex::allocator_type(*generation)),
+      columns(strings), columns_built(!config.demand_paging), data_path(data_file_path),
+      demand_paging(config.demand_paging) {
+    if (demand_paging) {
+        // 数据文件不是快照或日志中尚有记录时先合并一次，之后快照总是包含映射时的全部修改
+        if (!SnapshotFile::is_snapshot(data_path) || persist.has_pending_log()) {
+            persist.flush();
+        }
+        load_image();
+
+        // 常驻的只有目录与名称索引，名称直接取自快照的字符串堆
+        int code = 0;
+        std::string name;
+        for (const auto &entry : directory) {
+            if (SnapshotFile::read_key(image, entry.second, code, name)) {
+                index.insert(name, code);
+            }
+        }
+
+        // 检查点归并快照与修改表写出新快照，完成后重新映射
+        persist.set_state_source([this](const ItemVisitor &visit) {
+            for_each_item([&visit](const Item &item) {
+                visit(item);
+                return true;
+            });
+            checkpointed = true;
+        });
+        return;
+    }
 
-    // 构建内存索引
-    for (auto &item : items) {
+    // 从持久层直接读入常驻槽位，同时构建索引；持久层按编码升序且每个编码只访问一次
+    persist.scan([this](const Item &item) {
+        slot_of.emplace_hint(slot_of.end(), item.code, slots.size()); // 按编码升序读入，每次插入均摊O(1)
+        slots.push_back(store(item));
         index.insert(item.name, item.code); // 建立名称->编码的索引
+        columns.upsert(item);
+    });
+    live.assign(slots.size(), true);
+
+    // 检查点直接写出内存中的数据集合，无需回读数据文件；槽位索引按编码有序，顺序遍历即可，无需排序
+    persist.set_state_source([this](const ItemVisitor &visit) {
+        Item item;
+        for (const auto &entry : slot_of) {
+            resolve(slots[entry.second], item);
+            visit(item);
+        }
+    });
+}
+
+
+Engine::~Engine() {
+    persist.close();
+}
+
+
+Engine::ResidentItem Engine::store(const Item &item) {
+    const ResidentItem record{strings.intern(item.name), strings.intern(item.colour), item.code, item.quantity,
+                              static_cast<std::uint32_t>(brands.size()),
+                              static_cast<std::uint32_t>(item.brand_list.size())};
+    for (const auto &brand : item.brand_list) {
+        brands.push_back(ResidentBrand{strings.intern(brand.name), brand.code, brand.quantity, brand.price});
+    }
+    return record;
+}
+
+
+void Engine::resolve(const ResidentItem &record, Item &item) const {
+    const StringRef name = strings.view(record.name);
+    const StringRef colour = strings.view(record.colour);
+    item.name.assign(name.data, name.size);
+    item.code = record.code;
+    item.colour.assign(colour.data, colour.size);
+    item.quantity = record.quantity;
+    item.brand_list.clear();
+    for (std::uint32_t i = record.brand_begin; i < record.brand_begin + record.brand_count; ++i) {
+        const StringRef brand_name = strings.view(brands[i].name);
+        Brand &brand = item.brand_list.append();
+        brand.name.assign(brand_name.data, brand_name.size);
+        brand.code = brands[i].code;
+        brand.quantity = brands[i].quantity;
+        brand.price = brands[i].price;
+    }
+}
+
+
+Item Engine::resolve(const ResidentItem &record) const {
+    Item item;
+    resolve(record, item);
+    return item;
+}
+
+
+void Engine::release(const ResidentItem &record) {
+    strings.release(record.name);
+    strings.release(record.colour);
+    for (std::uint32_t i = record.brand_begin; i < record.brand_begin + record.brand_count; ++i) {
+        strings.release(brands[i].name);
+    }
+}
+
+
+void Engine::put_slot(const Item &item) {
+    Item removed;
+    remove_slot(item.code, removed);
+
+    slot_of[item.code] = slots.size();
+    slots.push_back(store(item));
+    live.push_back(true);
+    columns.upsert(item);
+}
+
+
+bool Engine::remove_slot(const int code, Item &removed) {
+    const auto found = slot_of.find(code);
+    if (found == slot_of.end()) {
+        return false;
+    }
+
+    ResidentItem &record = slots[found->second];
+    resolve(record, removed);
+    release(record);
+    record.brand_count = 0; // 墓碑不再持有驻留引用，其品牌在压缩时丢弃
+    live[found->second] = false;
+    slot_of.erase(found);
+    columns.remove(code);
+
+    // 墓碑多于有效槽位时按原顺序压缩，保持扫描顺序不变，品牌数组随之前移，驻留编号不变；
+    // 槽位索引在新的Region中重建，旧索引连同删除留下的节点随旧Region一次释放
+    if (slots.size() - slot_of.size() > slot_of.size()) {
+        std::unique_ptr<Region> next_generation(new Region());
+        SlotIndex next_slot_of{std::less<int>(), SlotIndex::allocator_type(*next_generation)};
+        std::vector<std::size_t> moved_to(slots.size());
+        std::size_t next = 0;
+        std::uint32_t brand_next = 0;
+        for (std::size_t slot = 0; slot < slots.size(); ++slot) {
+            if (!live[slot]) {
+                continue;
+            }
+            ResidentItem moved = slots[slot];
+            if (moved.brand_begin != brand_next) {
+                std::copy(brands.begin() + moved.brand_begin, brands.begin() + moved.brand_begin + moved.brand_count,
+                          brands.begin() + brand_next);
+                moved.brand_begin = brand_next;
+            }
+            brand_next += moved.brand_count;
+            slots[next] = moved;
+            moved_to[slot] = next;
+            ++next;
+        }
+        slots.resize(next);
+        brands.resize(brand_next);
+        live.assign(next, true);
+
+        // 按编码顺序重建，每次插入均摊O(1)
+        for (const auto &entry : slot_of) {
+            next_slot_of.emplace_hint(next_slot_of.end(), entry.first, moved_to[entry.second]);
+        }
+
+        slot_of = std::move(next_slot_of);
+        generation = std::move(next_generation);
+    }
+    return true;
+}
+
+
+PersistConfig Engine::persist_config(const EngineConfig &config) {
+    PersistConfig result = config.persist;
+    if (config.demand_paging) {
+        result.data_format = DataFormat::SNAPSHOT; // 定长记录可按序号直接定位
+        result.background_checkpoint = false;
+        result.shards = 1; // 映射的是单个快照文件
+    }
+    return result;
+}
+
+
+void Engine::load_image() {
+    image.unmap();
+    directory.clear();
+    dirty.clear();
+
+    image.map(data_path);
+    image_lsn = SnapshotFile::read_lsn(image);
+
+    const std::uint32_t count = SnapshotFile::item_count(image);
+    directory.reserve(count);
+    int code = 0;
+    std::string name;
+    for (std::uint32_t i = 0; i < count; ++i) {
+        if (SnapshotFile::read_key(image, i, code, name)) {
+            directory.emplace_back(code, i);
+        }
+    }
+
+    // 各写入路径均按编码升序写出快照，这里只做防御
+    if (!std::is_sorted(directory.begin(), directory.end())) {
+        std::sort(directory.begin(), directory.end());
+    }
+}
+
+
+void Engine::refresh_image() {
+    if (!checkpointed) {
+        return;
+    }
+    checkpointed = false;
+
+    MappedFile latest;
+    latest.map(data_path);
+    if (SnapshotFile::read_lsn(latest) != image_lsn) {
+        load_image(); // 新快照已包含修改表中的全部商品
+    }
+}
+
+
+std::vector<std::pair<int, std::uint32_t>>::iterator Engine::find_record(const int code) {
+    const auto found = std::lower_bound(directory.begin(), directory.end(), code,
+                                        [](const std::pair<int, std::uint32_t> &entry, const int key) {
+                                            return entry.first < key;
+                                        });
+    if (found == directory.end() || found->first != code || found->second == NO_RECORD) {
+        return directory.end();
+    }
+    return found;
+}
+
+
+bool Engine::load_item(const int code, Item &item) {
+    const auto modified = dirty.find(code);
+    if (modified != dirty.end()) {
+        item = modified->second;
+        return true;
+    }
+
+    const auto record = find_record(code);
+    return record != directory.end() && SnapshotFile::read_item(image, record->second, item);
+}
+
+
+void Engine::for_each_item(const std::function<bool(const Item &)> &visit) {
+    auto next = dirty.begin();
+    Item item;
+
+    // 修改表中的商品已从目录中失效，两者不重叠
+    for (const auto &entry : directory) {
+        if (entry.second == NO_RECORD) {
+            continue;
+        }
+
+        for (; next != dirty.end() && next->first < entry.first; ++next) {
+            if (!visit(next->second)) {
+                return;
+            }
+        }
+
+        if (SnapshotFile::read_item(image, entry.second, item) && !visit(item)) {
+            return;
+        }
+    }
+
+    for (; next != dirty.end(); ++next) {
+        if (!visit(next->second)) {
+            return;
+        }
     }
 }
 
 
 // 插入新条目：先持久化，成功后更新内存数据
 Item Engine::insert(Item item) {
+    if (demand_paging) {
+        if (persist.insert(item)) {
+            refresh_image();
+            const auto record = find_record(item.code);
+            if (record != directory.end()) {
+                record->second = NO_RECORD; // 快照中的旧记录由修改表取代
+            }
+            dirty[item.code] = item;
+            if (columns_built) {
+                columns.upsert(item);
+            }
+            index.insert(item.name, item.code);
+            cache.del(item.code);
+        }
+        return item;
+    }
+
     if (persist.insert(item)) { // 持久化成功才更新内存
-        items.push_back(item);
+        put_slot(item);
         index.insert(item.name, item.code); // 更新索引
     }
 
@@ -67,36 +350,132 @@ Item Engine::insert(Item item) {
 }
 
 
+std::size_t Engine::bulk_insert(std::vector<Item> batch) {
+    std::stable_sort(batch.begin(), batch.end(), [](const Item &lhs, const Item &rhs) {
+        return lhs.code < rhs.code;
+    });
+    batch.erase(std::unique(batch.begin(), batch.end(), [](const Item &lhs, const Item &rhs) {
+        return lhs.code == rhs.code; // 批内重复的编码只保留第一个
+    }), batch.end());
+
+    // 已存在的商品不覆盖
+    batch.erase(std::remove_if(batch.begin(), batch.end(), [this](const Item &item) {
+        return demand_paging ? dirty.count(item.code) > 0 || find_record(item.code) != directory.end()
+                             : slot_of.count(item.code) > 0;
+    }), batch.end());
+
+    if (batch.empty() || !persist.bulk_insert(batch)) {
+        return 0;
+    }
+
+    if (demand_paging) {
+        checkpointed = false;
+        load_image(); // 新快照已包含修改表与整批商品
+    }
+    for (const auto &item : batch) {
+        index.insert(item.name, item.code);
+        if (demand_paging && columns_built) {
+            columns.upsert(item); // 常驻模式下由put_slot()同步
+        }
+    }
+    if (!demand_paging) {
+        slots.reserve(slots.size() + batch.size());
+        for (const auto &item : batch) {
+            put_slot(item);
+        }
+    }
+    return batch.size();
+}
+
+
+std::size_t Engine::import_file(const std::string &file_path) {
+    if (!std::ifstream(file_path).good()) {
+        return 0; // 打开文件对象会创建不存在的文件，这里先行排除
+    }
+
+    std::vector<Item> batch;
+    const auto collect = [&batch](const Item &item) { batch.push_back(item); };
+
+    if (SnapshotFile::is_snapshot(file_path)) {
+        MappedFile image_file;
+        image_file.map(file_path);
+        SnapshotFile::scan(image_file, collect);
+    } else {
+        DataFile file(file_path);
+        file.open_file_object();
+        file.scan(collect);
+        file.close_file_object();
+    }
+
+    return bulk_insert(std::move(batch));
+}
+
+
 // 更新条目：先删除旧数据，再插入新数据
 Item Engine::update(Item item) {
-    if (persist.update(item)) {
-        // 从内存列表中移除旧数据
-        items.remove_if([&item](const Item &i) {
-            return i.code == item.code;
-        });
+    if (demand_paging) {
+        if (persist.update(item)) {
+            refresh_image();
+            const auto record = find_record(item.code);
+            if (record != directory.end()) {
+                record->second = NO_RECORD;
+            }
+            dirty[item.code] = item;
+            if (columns_built) {
+                columns.upsert(item);
+            }
+            index.del(item.code);
+            index.insert(item.name, item.code);
+            cache.del(item.code);
+        }
+        return item;
+    }
 
-        items.push_back(item);          // 添加新数据
-        index.del(item.code);           // 删除旧索引
-        index.insert(item.name, item.code); // 添加新索引
+    if (persist.update(item)) {
+        const auto found = slot_of.find(item.code);
+        std::uint32_t name = 0;
+        const bool renamed = found == slot_of.end() || !strings.find(item.name, name) ||
+                             slots[found->second].name != name;
+
+        put_slot(item);                 // 旧槽位留下墓碑，新数据追加到末尾
+        if (renamed) {                  // 名称以驻留编号比较，未改名时索引不变
+            index.del(item.code);       // 删除旧索引
+            index.insert(item.name, item.code); // 添加新索引
+        }
         cache.del(item.code);           // 使缓存失效
     }
     return item;
 }
 
 
-// 删除条目（通过编码）：需要遍历查找
+// 删除条目（通过编码）：按编码定位槽位
 Item Engine::del(const int code) {
-    if (persist.del(code)) {
-        // 线性搜索目标条目
-        for (auto it = items.begin(); it != items.end(); ++it) {
-            if (it->code == code) {
-                Item item = *it;
-                items.erase(it);    // 从内存移除
-                index.del(code);    // 删除索引
-                cache.del(code);    // 清除缓存
+    if (demand_paging) {
+        Item item;
+        if (persist.del(code)) {
+            refresh_image();
+            if (load_item(code, item)) {
+                const auto record = find_record(code);
+                if (record != directory.end()) {
+                    record->second = NO_RECORD;
+                }
+                dirty.erase(code);
+                if (columns_built) {
+                    columns.remove(code);
+                }
+                index.del(code);
+                cache.del(code);
                 return item;
             }
         }
+        throw std::out_of_range("Item not found");
+    }
+
+    Item item;
+    if (persist.del(code) && remove_slot(code, item)) {
+        index.del(code);    // 删除索引
+        cache.del(code);    // 清除缓存
+        return item;
     }
     throw std::out_of_range("Item not found");
 }
@@ -112,14 +491,48 @@ QueryBuilder Engine::select() {
 }
 
 
+const ColumnStore &Engine::column_store() {
+    if (!columns_built) {
+        // 按需加载模式下首次使用时逐个解码快照与修改表中的商品，之后随修改同步
+        for_each_item([this](const Item &item) {
+            columns.upsert(item);
+            return true;
+        });
+        columns_built = true;
+    }
+    return columns;
+}
+
+
 // 查询执行核心：应用所有过滤条件，返回指定数量的结果
 std::vector<Item> Engine::execute(std::list<std::function<bool(const Item &)> > conditions,
                                  const int number) {
     std::vector<Item> result;
 
-    for (auto &item : items) {
+    if (demand_paging) {
+        // 逐个解码快照中的商品，满足数量限制后停止
+        for_each_item([&](const Item &item) {
+            if (number >= 0 && result.size() >= static_cast<size_t>(number)) {
+                return false;
+            }
+            if (std::all_of(conditions.begin(), conditions.end(),
+                            [&item](const std::function<bool(const Item &)> &condition) {
+                                return condition(item);
+                            })) {
+                result.push_back(item);
+            }
+            return true;
+        });
+        return result;
+    }
+
+    Item item; // 逐个还原常驻商品，字符串容量在各槽位间复用
+    for (std::size_t slot = 0; slot < slots.size(); ++slot) {
         // 数量限制检查：当number>=0时生效
-        if (number >= 0 && result.size() >= number) break;
+        if (number >= 0 && result.size() >= static_cast<size_t>(number)) break;
+        if (!live[slot]) continue; // 跳过墓碑
+
+        resolve(slots[slot], item);
 
         // 检查是否满足所有条件（AND逻辑）
         if (std::all_of(conditions.begin(), conditions.end(),
@@ -143,13 +556,21 @@ std::vector<Item> Engine::select_by_code(const int code) {
         return result;
     } catch (const std::out_of_range&) {}
 
-    // 缓存未命中时遍历内存数据
-    for (const auto &item : items) {
-        if (item.code == code) {
+    // 按需加载模式下缓存未命中时从修改表或快照读入
+    if (demand_paging) {
+        Item item;
+        if (load_item(code, item)) {
             result.push_back(item);
-            cache.insert(item); // 回填缓存
-            return result;
+            cache.insert(item);
         }
+        return result;
+    }
+
+    // 缓存未命中时按编码定位槽位
+    const auto found = slot_of.find(code);
+    if (found != slot_of.end()) {
+        result.push_back(resolve(slots[found->second]));
+        cache.insert(result.back()); // 回填缓存
     }
 
     return result; // 未找到时返回空vector
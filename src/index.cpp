@@ -6,6 +6,14 @@
 #include <algorithm>
 
 
+Index::Index() : own_pool(new StringPool()), pool(own_pool.get()) {
+}
+
+
+Index::Index(StringPool &shared_pool) : pool(&shared_pool) {
+}
+
+
 // 字符串转宽字符串（UTF-8 -> wstring）
 std::wstring Index::str_to_w_str(const std::string &str) {
     using convert_typeX = std::codecvt_utf8<wchar_t>;
@@ -25,8 +33,8 @@ std::string Index::w_str_to_str(const std::wstring &w_str) {
 
 
 // 计算宽字符串的编辑距离（动态规划实现）
-int Index::levenshtein(const std::string &s1, const std::string &s2) {
-    const size_t m = s1.size(), n = s2.size();
+int Index::levenshtein(const StringRef &s1, const StringRef &s2) {
+    const size_t m = s1.size, n = s2.size;
     std::vector<std::vector<int>> dp(m+1, std::vector<int>(n+1, 0));
 
     // 计算宽字符串的编辑距离（动态规划实现）
@@ -47,7 +55,7 @@ int Index::levenshtein(const std::string &s1, const std::string &s2) {
                 // 3. 替换操作（左上值+0或2）
                 dp[i-1][j]+1,
                 dp[i][j-1]+1,
-                dp[i-1][j-1]+(s1[i-1]!=s2[j-1]) * 2
+                dp[i-1][j-1]+(s1.data[i-1]!=s2.data[j-1]) * 2
             });
         }
     }
@@ -56,6 +64,12 @@ int Index::levenshtein(const std::string &s1, const std::string &s2) {
 }
 
 
+// 普通字符串的编辑距离计算
+int Index::levenshtein(const std::string &s1, const std::string &s2) {
+    return levenshtein(StringRef{s1.data(), s1.size()}, StringRef{s2.data(), s2.size()});
+}
+
+
 // 重载版本：普通字符串的编辑距离计算
 int Index::levenshtein(const std::wstring &s1, const std::wstring &s2) {
     // 转换为宽字符后调用宽字符版本
@@ -63,19 +77,30 @@ int Index::levenshtein(const std::wstring &s1, const std::wstring &s2) {
 }
 
 
-// 插入键值对到哈希表
+// 插入名称到按编号定位的索引表
 void Index::insert(const std::string &name, const int code) {
-    name_to_code[name] = code; // 存储宽字符串格式
+    // 名称只在驻留池中存放一份，每个键持有一次引用
+    const std::uint32_t id = pool->intern(name);
+    if (id >= name_to_code.size()) {
+        name_to_code.resize(id + 1, std::make_pair(false, 0));
+    }
+
+    std::pair<bool, int> &entry = name_to_code[id];
+    if (entry.first) {
+        pool->release(id);
+    }
+    entry = std::make_pair(true, code);
 }
 
 
 // 根据名称查询编码
 int Index::select(const std::string &name) {
-    if (!name_to_code.count(name)) {
+    std::uint32_t id = 0;
+    if (!pool->find(name, id) || id >= name_to_code.size() || !name_to_code[id].first) {
         throw std::out_of_range("name not found"); // 不存在时抛出异常
     }
 
-    return name_to_code[name];
+    return name_to_code[id].second;
 }
 
 
@@ -86,12 +111,17 @@ std::vector<int> Index::find(const std::string &name, const int max_distance) co
     }
 
     std::vector<int> match;
+    const StringRef query{name.data(), name.size()};
 
-    // 遍历所有键值对
-    for (std::pair<std::string, int> kv : name_to_code) {
-        const int distance = levenshtein(kv.first, name);
-        if (distance <= max_distance && distance < std::max(kv.first.size(), name.size())) {
-            match.push_back(kv.second); // 符合距离要求的加入结果
+    // 遍历所有已建索引的名称，名称直接在驻留池中读取
+    for (std::uint32_t id = 0; id < name_to_code.size(); ++id) {
+        if (!name_to_code[id].first) {
+            continue;
+        }
+        const StringRef key = pool->view(id);
+        const int distance = levenshtein(key, query);
+        if (distance <= max_distance && distance < std::max(key.size, query.size)) {
+            match.push_back(name_to_code[id].second); // 符合距离要求的加入结果
         }
     }
 
@@ -104,16 +134,13 @@ std::vector<std::string> Index::del(const int code) {
     std::vector<std::string> result;
 
     // 遍历查找目标编码
-    for (std::pair<std::string, int> kv: name_to_code) {
-        if (kv.second == code) {
-            result.push_back(kv.first);
+    for (std::uint32_t id = 0; id < name_to_code.size(); ++id) {
+        if (name_to_code[id].first && name_to_code[id].second == code) {
+            result.push_back(pool->str(id));
+            name_to_code[id].first = false; // 删除目标编码
+            pool->release(id);
         }
     }
 
-    for (const std::string& name : result) {
-        name_to_code.erase(name); // 删除目标编码
-    }
-
     return result;
 }
-
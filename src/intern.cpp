@@ -0,0 +1,185 @@
+﻿#include "../include/intern.h"
+
+#include <cstring>
+
+
+bool StringRef::operator==(const StringRef &other) const {
+    return size == other.size && (size == 0 || std::memcmp(data, other.data, size) == 0);
+}
+
+
+// FNV-1a，逐字节计算，不需要先构造std::string
+std::size_t StringPool::RefHash::operator()(const StringRef &ref) const {
+    std::uint64_t hash = 14695981039346656037ull;
+    for (std::size_t i = 0; i < ref.size; ++i) {
+        hash ^= static_cast<unsigned char>(ref.data[i]);
+        hash *= 1099511628211ull;
+    }
+    return static_cast<std::size_t>(hash);
+}
+
+
+constexpr std::uint32_t StringPool::EMPTY_SLOT;
+constexpr std::uint32_t StringPool::ERASED_SLOT;
+constexpr std::size_t StringPool::NOT_FOUND;
+constexpr std::size_t StringPool::BLOCK_SIZE;
+
+
+std::size_t StringPool::locate(const StringRef &ref) const {
+    if (table.empty()) {
+        return NOT_FOUND;
+    }
+
+    // 表中总留有空槽位，探测必然终止
+    const std::size_t mask = table.size() - 1;
+    for (std::size_t slot = RefHash()(ref) & mask;; slot = (slot + 1) & mask) {
+        const std::uint32_t id = table[slot];
+        if (id == EMPTY_SLOT) {
+            return NOT_FOUND;
+        }
+        if (id != ERASED_SLOT && refs[id] == ref) {
+            return slot;
+        }
+    }
+}
+
+
+void StringPool::place(const std::uint32_t id) {
+    const std::size_t mask = table.size() - 1;
+    std::size_t slot = RefHash()(refs[id]) & mask;
+    while (table[slot] != EMPTY_SLOT && table[slot] != ERASED_SLOT) {
+        slot = (slot + 1) & mask;
+    }
+    if (table[slot] == EMPTY_SLOT) {
+        ++used_slots;
+    }
+    table[slot] = id;
+}
+
+
+void StringPool::rehash() {
+    // 重建后负载不超过四分之一，至少再新增同样多的字符串才需要下一次重建
+    std::size_t capacity = 16;
+    while (capacity < (live_count + 1) * 4) {
+        capacity *= 2;
+    }
+
+    table.assign(capacity, EMPTY_SLOT);
+    used_slots = 0;
+    for (std::uint32_t id = 0; id < refs.size(); ++id) {
+        if (counts[id] != 0) {
+            place(id);
+        }
+    }
+}
+
+
+std::uint32_t StringPool::intern(const std::string &value) {
+    return intern(value.data(), value.size());
+}
+
+
+std::uint32_t StringPool::intern(const char *data, const std::size_t length) {
+    const std::size_t found = locate(StringRef{data, length});
+    if (found != NOT_FOUND) {
+        ++counts[table[found]];
+        return table[found];
+    }
+
+    // 已用槽位（含删除标记）将超过一半时先重建查找表
+    if ((used_slots + 1) * 2 > table.size()) {
+        rehash();
+    }
+
+    // 内容复制进池，查找表与编号表都引用池内的副本
+    char *copy = static_cast<char *>(arena.allocate(length, 1));
+    if (length != 0) {
+        std::memcpy(copy, data, length);
+    }
+    const StringRef ref{copy, length};
+
+    std::uint32_t id;
+    if (free_ids.empty()) {
+        id = static_cast<std::uint32_t>(refs.size());
+        refs.push_back(ref);
+        counts.push_back(1);
+    } else {
+        id = free_ids.back();
+        free_ids.pop_back();
+        refs[id] = ref;
+        counts[id] = 1;
+    }
+    ++live_count;
+    place(id);
+    live_bytes += length;
+    return id;
+}
+
+
+void StringPool::release(const std::uint32_t id) {
+    if (--counts[id] != 0) {
+        return;
+    }
+
+    table[locate(refs[id])] = ERASED_SLOT;
+    --live_count;
+    live_bytes -= refs[id].size;
+    dead_bytes += refs[id].size;
+    refs[id] = StringRef{nullptr, 0};
+    free_ids.push_back(id);
+
+    // 已归还的字节超过一个块且多于存活字节时压缩，每次压缩前至少归还了与存活量相当的字节，均摊O(1)
+    if (dead_bytes >= BLOCK_SIZE && dead_bytes > live_bytes) {
+        compact();
+    }
+}
+
+
+void StringPool::compact() {
+    Region next(BLOCK_SIZE);
+    for (std::uint32_t id = 0; id < refs.size(); ++id) {
+        if (counts[id] == 0) {
+            continue;
+        }
+
+        char *copy = static_cast<char *>(next.allocate(refs[id].size, 1));
+        if (refs[id].size != 0) {
+            std::memcpy(copy, refs[id].data, refs[id].size);
+        }
+        refs[id] = StringRef{copy, refs[id].size};
+    }
+
+    arena = std::move(next);
+    dead_bytes = 0;
+    rehash(); // 哈希按内容计算，编号不变，这里只为清除删除标记
+}
+
+
+bool StringPool::find(const std::string &value, std::uint32_t &id) const {
+    const std::size_t found = locate(StringRef{value.data(), value.size()});
+    if (found == NOT_FOUND) {
+        return false;
+    }
+    id = table[found];
+    return true;
+}
+
+
+StringRef StringPool::view(const std::uint32_t id) const {
+    return refs[id];
+}
+
+
+std::string StringPool::str(const std::uint32_t id) const {
+    return refs[id].str();
+}
+
+
+std::size_t StringPool::size() const {
+    return live_count;
+}
+
+
+std::size_t StringPool::size_bytes() const {
+    return arena.size_bytes();
+}
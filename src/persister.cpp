@@ -1,14 +1,79 @@
 ﻿#include "../include/persister.h"
 
 #include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <numeric>
 #include <sstream>
+#include <stdexcept>
+#include <unordered_map>
 
 
 Persist::Persist(const std::string &data_file_path, const std::string &operation_file_path,
-                 const int max_row): data_file(data_file_path), operation_file(operation_file_path) {
+                 const int max_row, const PersistConfig &config)
+    : data_path(data_file_path), data_file(data_file_path), snapshot_file(data_file_path),
+      paged_file(data_file_path, config.page_size), lsm_store(data_file_path, config.lsm_fanout),
+      data_format(config.data_format),
+      operation_file(operation_file_path, config.log_format),
+      background_checkpoint(config.background_checkpoint), compact_sealed_segments(config.compact_sealed_segments),
+      max_checkpoint_lag(config.max_checkpoint_lag), shard_scheme(config.shard_scheme),
+      shard_bounds(config.shard_bounds) {
     max_log_row = max_row;
+    if (config.shards > 1) {
+        open_shards(operation_file_path, max_row, config); // 本对象不再打开自己的数据文件与日志
+        return;
+    }
+
+    operation_file.set_durability(config.durability, config.group_commit_records, config.group_commit_interval_us);
     operation_file.open_file_object(); // 启动时立即打开操作日志文件
-    flush();
+
+    // 分页数据文件打开时补完上一次中断的页改写，之后才能读取
+    if (PagedFile::is_paged(data_path) && paged_file.open_file_object() && data_format != DataFormat::PAGED) {
+        paged_file.close_file_object();
+    }
+
+    // LSM格式以清单取代其他格式的数据文件，原有数据整体转换为一个基础段
+    if (data_format == DataFormat::LSM && !LsmStore::is_lsm(data_path)) {
+        std::uint64_t lsn = 0;
+        const std::map<int, Item> items = read_data(lsn);
+        write_data([&items](const ItemVisitor &visit) {
+            for (const auto &pair: items) {
+                visit(pair.second);
+            }
+        }, lsn);
+    } else if (data_format == DataFormat::LSM) {
+        lsm_store.open_file_object();
+    }
+
+    // 新记录的序列号须大于数据文件与封存段中已有的序列号；日志的重放推迟到select()，只做一次
+    std::uint64_t lsn = read_data_lsn();
+    const std::vector<std::string> segments = operation_file.sealed_segments();
+    if (!segments.empty()) {
+        OperationFile newest(segments.back());
+        if (newest.open_file_object()) {
+            lsn = std::max(lsn, newest.get_last_lsn());
+            newest.close_file_object();
+        }
+    }
+    operation_file.advance_lsn(lsn);
+
+    // 日志中尚未写成段的操作重放进内存表
+    if (data_format == DataFormat::LSM) {
+        std::list<Operation> operations = read_segments(segments);
+        operations.splice(operations.end(), operation_file.read_operations());
+        const std::uint64_t applied = lsm_store.get_last_lsn();
+        for (const auto &operation: operations) {
+            if (operation.lsn == 0 || operation.lsn > applied) {
+                lsm_store.apply(operation, operation.lsn);
+            }
+        }
+    }
+
+    if (background_checkpoint || config.durability == Durability::GROUP) {
+        worker_thread = std::thread(&Persist::background_worker, this);
+    }
 }
 
 
@@ -24,148 +89,933 @@ bool Persist::close() {
         return false;
     }
 
-    flush(); // 关闭前强制同步数据
+    if (!shards.empty()) {
+        for_each_shard_with_state([this](const std::size_t index) { shards[index]->close(); });
+        has_closed = true;
+        return true;
+    }
+
+    stop_worker();
+
+    std::unique_lock<std::mutex> lock(worker_mutex);
+    bool result = true;
+    try {
+        flush(lock); // 关闭前强制同步数据
+    } catch (const std::exception &error) {
+        // 日志损坏时合并失败，日志保持原样留待人工处理；析构时调用本函数，不能再抛出
+        std::cerr << "Flush on close failed: " << error.what() << std::endl;
+        result = false;
+    }
     operation_file.close_file_object();
     has_closed = true; // 标记关闭状态
 
-    return true;
+    return result;
 }
 
 
 std::list<Item> Persist::select() {
-    flush();
+    std::list<Item> items;
+    scan([&items](const Item &item) { items.push_back(item); });
+    return items;
+}
+
+
+void Persist::scan(const ItemVisitor &visit) {
+    if (!shards.empty()) {
+        // 各分片并行读取后按编码归并（区间分片互不交叠，归并退化为依次拼接）
+        // 每个分片的读取结果放在各自的Region中（Region不是线程安全的），归并结束后一次释放
+        using ItemList = std::list<Item, RegionAllocator<Item>>;
+        std::vector<Region> regions(shards.size());
+        std::vector<ItemList> parts;
+        parts.reserve(shards.size());
+        for (auto &region: regions) {
+            parts.emplace_back(RegionAllocator<Item>(region));
+        }
+        for_each_shard([this, &parts](const std::size_t index) {
+            ItemList &part = parts[index];
+            shards[index]->scan([&part](const Item &item) { part.push_back(item); });
+        });
+
+        std::vector<ItemList::const_iterator> cursors;
+        for (const auto &part: parts) {
+            cursors.push_back(part.begin());
+        }
+        while (true) {
+            std::size_t next = parts.size();
+            for (std::size_t index = 0; index < parts.size(); ++index) {
+                if (cursors[index] != parts[index].end() &&
+                    (next == parts.size() || cursors[index]->code < cursors[next]->code)) {
+                    next = index;
+                }
+            }
+            if (next == parts.size()) {
+                break;
+            }
+            visit(*cursors[next]++);
+        }
+        return;
+    }
+
+    if (data_format == DataFormat::LSM) {
+        lsm_store.scan(visit); // 写入日志的操作已同时进入内存表
+        return;
+    }
+
+    // 只在收集日志时持有锁。之后读到的数据文件可能是旧一代，也可能已合并了其中部分记录，
+    // 两种情况都由序列号过滤保证结果一致
+    std::list<Operation> operations;
+    {
+        std::lock_guard<std::mutex> lock(worker_mutex);
+        operations = read_segments(operation_file.sealed_segments());
+        operations.splice(operations.end(), operation_file.read_operations());
+    }
+
+    scan_with_overlay(std::move(operations), visit);
+}
+
+
+void Persist::scan_with_overlay(std::list<Operation> operations, const ItemVisitor &visit) const {
+    Region region; // 重放的净效果表在访问结束时一次释放
+
+    if (SnapshotFile::is_snapshot(data_path)) {
+        MappedFile image;
+        image.map(data_path);
+        const PendingMap overlay = build_overlay(operations, SnapshotFile::read_lsn(image), region);
+        operations.clear();
+
+        merge_overlay([&image](const ItemVisitor &base) { SnapshotFile::scan(image, base); }, overlay, visit);
+        return;
+    }
+
+    if (PagedFile::is_paged(data_path)) {
+        std::lock_guard<std::mutex> guard(data_mutex); // 分页文件原地改写，读取期间不允许写入
+        MappedFile image;
+        image.map(data_path);
+        const PendingMap overlay = build_overlay(operations, PagedFile::read_lsn(image), region);
+        operations.clear();
+
+        merge_overlay([&image](const ItemVisitor &base) { PagedFile::scan(image, base); }, overlay, visit);
+        return;
+    }
+
+    if (LsmStore::is_lsm(data_path)) {
+        LsmStore store(data_path);
+        store.open_file_object();
+        const PendingMap overlay = build_overlay(operations, store.get_last_lsn(), region);
+        operations.clear();
+
+        merge_overlay([&store](const ItemVisitor &base) { store.scan(base); }, overlay, visit);
+        return;
+    }
+
+    DataFile file(data_path);
+    file.open_file_object();
+    const PendingMap overlay = build_overlay(operations, file.read_lsn(), region);
+    operations.clear();
+
+    merge_overlay([&file](const ItemVisitor &base) { file.scan(base); }, overlay, visit);
+    file.close_file_object();
+}
+
+
+Persist::PendingMap Persist::build_overlay(const std::list<Operation> &operations, const std::uint64_t lsn,
+                                           Region &region) {
+    PendingMap overlay{std::less<int>(), PendingMap::allocator_type(region)};
+
+    for (const auto &operation: operations) {
+        // 旧格式日志没有序列号，总是重放
+        if (operation.lsn != 0 && operation.lsn <= lsn) {
+            continue;
+        }
+
+        const auto found = overlay.find(operation.code);
+        switch (operation.type) {
+            case OperationType::INSERT_ITEM:
+                overlay[operation.code] = PendingItem{PendingItem::State::SET, payload_to_item(operation.payload)};
+                break;
+            case OperationType::UPDATE_ITEM:
+                // 更新不存在的商品不产生效果
+                if (found == overlay.end()) {
+                    overlay[operation.code] = PendingItem{PendingItem::State::UPDATED, payload_to_item(operation.payload)};
+                } else if (found->second.state != PendingItem::State::DELETED) {
+                    found->second.item = payload_to_item(operation.payload);
+                }
+                break;
+            case OperationType::DELETE_ITEM:
+                overlay[operation.code] = PendingItem{PendingItem::State::DELETED, Item()};
+                break;
+        }
+    }
+    return overlay;
+}
+
+
+void Persist::merge_overlay(const ItemSource &scan_base, const PendingMap &overlay,
+                            const ItemVisitor &visit) {
+    auto next = overlay.begin();
+
+    // 数据文件的各个写入路径都按编码升序写出，与有序的净效果表逐一归并
+    scan_base([&overlay, &next, &visit](const Item &item) {
+        for (; next != overlay.end() && next->first < item.code; ++next) {
+            if (next->second.state == PendingItem::State::SET) {
+                visit(next->second.item); // 日志中新插入的商品
+            }
+        }
+
+        if (next != overlay.end() && next->first == item.code) {
+            if (next->second.state != PendingItem::State::DELETED) {
+                visit(next->second.item);
+            }
+            ++next;
+            return;
+        }
+        visit(item);
+    });
+
+    for (; next != overlay.end(); ++next) {
+        if (next->second.state == PendingItem::State::SET) {
+            visit(next->second.item);
+        }
+    }
+}
+
+
+std::map<int, Item> Persist::read_data(std::uint64_t &lsn) const {
+    // 每次读取使用独立的文件对象，与后台线程的写入互不干扰；
+    // 数据文件以原子重命名替换，读到的总是完整的某一代
+    std::map<int, Item> items;
+    const auto insert = [&items](const Item &item) {
+        items.emplace_hint(items.end(), item.code, item); // 数据文件按编码升序，每次插入均摊O(1)
+    };
+
+    if (SnapshotFile::is_snapshot(data_path)) {
+        MappedFile image;
+        image.map(data_path);
+        lsn = SnapshotFile::read_lsn(image);
+        SnapshotFile::scan(image, insert);
+        return items;
+    }
+
+    if (PagedFile::is_paged(data_path)) {
+        std::lock_guard<std::mutex> guard(data_mutex);
+        MappedFile image;
+        image.map(data_path);
+        lsn = PagedFile::read_lsn(image);
+        PagedFile::scan(image, insert);
+        return items;
+    }
+
+    if (LsmStore::is_lsm(data_path)) {
+        LsmStore store(data_path);
+        store.open_file_object();
+        lsn = store.get_last_lsn();
+        store.scan(insert);
+        return items;
+    }
+
+    DataFile file(data_path);
+    file.open_file_object();
+    lsn = file.read_lsn();
+    file.scan(insert);
+    file.close_file_object();
+
+    return items;
+}
+
+
+std::uint64_t Persist::read_data_lsn() const {
+    if (SnapshotFile::is_snapshot(data_path)) {
+        return SnapshotFile(data_path).read_lsn();
+    }
+
+    if (PagedFile::is_paged(data_path)) {
+        std::lock_guard<std::mutex> guard(data_mutex);
+        MappedFile image;
+        image.map(data_path);
+        return PagedFile::read_lsn(image);
+    }
+
+    if (LsmStore::is_lsm(data_path)) {
+        return LsmStore::read_lsn(data_path);
+    }
 
-    data_file.open_file_object();
-    std::list<Item> result = data_file.read();
-    data_file.close_file_object();
+    DataFile file(data_path);
+    file.open_file_object();
+    const std::uint64_t lsn = file.read_lsn();
+    file.close_file_object();
+
+    return lsn;
+}
 
+
+bool Persist::write_data(const ItemSource &source, const std::uint64_t lsn) {
+    if (data_format == DataFormat::LSM) {
+        return lsm_store.write(source, lsn); // 写出基础段后存储处于打开状态
+    }
+
+    // 由LSM格式转换为其他格式时，清单被替换后段文件不再被引用
+    const bool replaces_store = LsmStore::is_lsm(data_path);
+    bool result;
+    if (data_format == DataFormat::SNAPSHOT) {
+        result = snapshot_file.write(source, lsn);
+    } else if (data_format == DataFormat::PAGED) {
+        std::lock_guard<std::mutex> guard(data_mutex);
+        result = paged_file.write(source, lsn); // 整体写入后重新打开并建立页目录
+    } else {
+        result = data_file.write(source, lsn);
+        data_file.close_file_object(); // 不持有数据文件句柄，下一次替换时无需等待
+    }
+
+    if (result && replaces_store) {
+        LsmStore::remove_runs(data_path);
+    }
     return result;
 }
 
 
-bool Persist::write_operation(const Item &item, const std::string &keyword) {
-    std::stringstream buffer;
+bool Persist::write_operation(const Operation &operation) {
+    if (!shards.empty()) {
+        return shards[shard_of(operation.code)]->write_operation(operation);
+    }
 
-    // 构建操作日志头
-    buffer << keyword << std::endl;
-    buffer << item_to_csv(item) << std::endl;
+    std::unique_lock<std::mutex> lock(worker_mutex);
 
-    // 序列化关联品牌数据
-    for (auto &brand: item.brand_list) {
-        buffer << brand_to_csv(brand) << std::endl;
+    // 未启用后台检查点时内存状态此时与日志一致，先检查点再追加
+    const bool state_checkpoint = foreground_state_checkpoint();
+    if (state_checkpoint && operation_file.size() >= max_log_row) {
+        checkpoint(lock);
     }
 
     // 写入日志文件并检查自动刷新条件
-    const bool result = operation_file.append(buffer.str());
-    if (operation_file.size() >= max_log_row) {
-        flush();
+    const bool result = operation_file.append(operation);
+    if (result) {
+        dirty_codes.insert(operation.code);
+        if (data_format == DataFormat::LSM) {
+            lsm_store.apply(operation, operation_file.get_last_lsn()); // 日志即预写日志，追加后进入内存表
+        }
+    }
+
+    // 新的一组开始缓冲时通知后台线程按时提交
+    if (operation_file.pending_size() > 0 && !commit_scheduled) {
+        commit_scheduled = true;
+        worker_condition.notify_all();
+    }
+
+    if (operation_file.size() >= max_log_row && !state_checkpoint) {
+        if (background_checkpoint) {
+            request_checkpoint(lock); // 前台只负责轮转，合并交给后台线程
+        } else {
+            flush(lock);
+        }
     }
     return result;
 }
 
 
+bool Persist::foreground_state_checkpoint() const {
+    // 内存状态只能在写入方线程中一致地读取；启用后台检查点时前台只轮转日志，由后台线程流式合并
+    return state_source && !background_checkpoint;
+}
+
+
+std::string Persist::item_to_payload(const Item &item) {
+    std::string payload;
+    payload.reserve(64 * (item.brand_list.size() + 1));
+    append_item_payload(payload, item);
+    return payload;
+}
+
+
+Item Persist::payload_to_item(const std::string &payload) {
+    std::istringstream stream(payload);
+    std::string line;
+    Item item;
+
+    while (std::getline(stream, line)) {
+        // 解析条目数据行
+        if (line.find("ITEM|") == 0) {
+            item = parse_item_line(line);
+        }
+
+        // 解析品牌数据行
+        if (line.find("BRAND|") == 0) {
+            item.brand_list.emplace_back(parse_brand_line(line));
+        }
+    }
+
+    return item;
+}
+
+
 bool Persist::insert(const Item &item) {
-    return write_operation(item, "[insert]");
+    return write_operation(Operation{OperationType::INSERT_ITEM, item.code, item_to_payload(item), 0});
 }
 
 
 bool Persist::update(const Item &item) {
-    return write_operation(item, "[update]");
+    return write_operation(Operation{OperationType::UPDATE_ITEM, item.code, item_to_payload(item), 0});
 }
 
 
 bool Persist::del(const int index) {
-    std::stringstream buffer;
+    return write_operation(Operation{OperationType::DELETE_ITEM, index, std::string(), 0});
+}
 
-    buffer << "[delete]" << index << std::endl;
 
-    const bool result = operation_file.append(buffer.str());
+bool Persist::bulk_insert(const std::vector<Item> &batch) {
+    if (!shards.empty()) {
+        std::vector<std::vector<Item>> parts(shards.size());
+        for (const auto &item: batch) {
+            parts[shard_of(item.code)].push_back(item); // 按编码顺序分发，各部分仍然有序
+        }
+        std::vector<char> results(shards.size(), 0);
+        for_each_shard([this, &parts, &results](const std::size_t index) {
+            results[index] = parts[index].empty() || shards[index]->bulk_insert(parts[index]);
+        });
+        return std::find(results.begin(), results.end(), 0) == results.end();
+    }
 
-    if (operation_file.size() >= max_log_row) {
-        flush();
+    if (batch.empty()) {
+        return true;
     }
 
-    return result;
+    std::unique_lock<std::mutex> lock(worker_mutex);
+    wait_for_checkpoint(lock);
+
+    // 整批只占用一个序列号，数据文件写入成功即已持久，日志中不必逐条记录
+    const std::uint64_t lsn = operation_file.get_last_lsn() + 1;
+    const std::vector<std::string> segments = operation_file.sealed_segments();
+    std::list<Operation> operations = read_segments(segments);
+    operations.splice(operations.end(), operation_file.read_operations());
+
+    if (!merge_into_data(std::move(operations), batch, lsn)) {
+        return false;
+    }
+    operation_file.advance_lsn(lsn);
+    operation_file.remove_sealed(segments.size());
+    operation_file.reset();
+    dirty_codes.clear();
+    return true;
+}
+
+
+void Persist::set_state_source(ItemSource source) {
+    if (!shards.empty()) {
+        for (std::size_t index = 0; index < shards.size(); ++index) {
+            if (!source) {
+                shards[index]->set_state_source(ItemSource());
+                continue;
+            }
+            // 每个分片只写出自己的商品，数据来源按编码升序，划分或过滤后仍然有序
+            shards[index]->set_state_source([this, source, index](const ItemVisitor &visit) {
+                if (shard_states_ready) {
+                    for (const auto &item: shard_states[index]) {
+                        visit(item);
+                    }
+                    return;
+                }
+                source([this, index, &visit](const Item &item) {
+                    if (shard_of(item.code) == index) {
+                        visit(item);
+                    }
+                });
+            });
+        }
+        state_source = std::move(source); // 并行检查点前由本对象统一遍历
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(worker_mutex);
+    state_source = std::move(source);
 }
 
 
 int Persist::flush() {
+    if (!shards.empty()) {
+        std::vector<int> sizes(shards.size());
+        for_each_shard_with_state([this, &sizes](const std::size_t index) { sizes[index] = shards[index]->flush(); });
+        return std::accumulate(sizes.begin(), sizes.end(), 0);
+    }
+
+    std::unique_lock<std::mutex> lock(worker_mutex);
+    return flush(lock);
+}
+
+
+int Persist::flush(std::unique_lock<std::mutex> &lock) {
+    return state_source ? checkpoint(lock) : merge(lock);
+}
+
+
+int Persist::checkpoint() {
+    if (!shards.empty()) {
+        std::vector<int> sizes(shards.size());
+        for_each_shard_with_state([this, &sizes](const std::size_t index) {
+            sizes[index] = shards[index]->checkpoint();
+        });
+        return std::accumulate(sizes.begin(), sizes.end(), 0);
+    }
+
+    std::unique_lock<std::mutex> lock(worker_mutex);
+    return checkpoint(lock);
+}
+
+
+bool Persist::has_pending_log() {
+    if (!shards.empty()) {
+        return std::any_of(shards.begin(), shards.end(),
+                           [](const std::unique_ptr<Persist> &shard) { return shard->has_pending_log(); });
+    }
+
+    std::lock_guard<std::mutex> lock(worker_mutex);
+    return operation_file.size() > 0 || !operation_file.sealed_segments().empty();
+}
+
+
+int Persist::checkpoint(std::unique_lock<std::mutex> &lock) {
+    // 分页格式按日志只改写脏页，LSM格式只写出内存表，都比写出全部内存状态更省I/O
+    if (!state_source || data_format == DataFormat::PAGED || data_format == DataFormat::LSM) {
+        return merge(lock);
+    }
+
+    wait_for_checkpoint(lock);
+
+    const int size = operation_file.size();
+    // 启动时日志中可能还有尚未合并的记录，此时即使没有新修改也要写出
+    const std::vector<std::string> segments = operation_file.sealed_segments();
+    if (dirty_codes.empty() && size == 0 && segments.empty()) {
+        return size; // 自上次检查点以来没有修改，数据文件已是最新
+    }
+
+    // 直接写出内存状态，数据文件写入成功后才丢弃日志
+    if (write_data(state_source, operation_file.get_last_lsn())) {
+        operation_file.remove_sealed(segments.size());
+        operation_file.reset();
+        dirty_codes.clear();
+    }
+    return size;
+}
+
+
+int Persist::merge(std::unique_lock<std::mutex> &lock) {
+    wait_for_checkpoint(lock);
+
     const int size = operation_file.size(); // 记录原始日志量
 
-    // 读取当前数据文件内容
-    data_file.open_file_object();
-    std::list<Item> items = data_file.read();
-    data_file.close_file_object();
+    // 封存段中的记录早于活动日志，先重放
+    const std::vector<std::string> segments = operation_file.sealed_segments();
+    std::list<Operation> operations = read_segments(segments);
+    operations.splice(operations.end(), operation_file.read_operations());
+
+    if (merge_into_data(std::move(operations))) {
+        operation_file.remove_sealed(segments.size()); // 数据文件写入成功后才丢弃日志
+        operation_file.reset();
+        dirty_codes.clear();
+    }
+    return size; // 返回处理的日志条目数
+}
+
+
+bool Persist::merge_into_data(std::list<Operation> operations, const std::vector<Item> &batch,
+                              const std::uint64_t batch_lsn) {
+    if (data_format == DataFormat::LSM) {
+        // 这些操作写入日志时已进入内存表，不读取也不改写已有的段；批量插入的商品随内存表写成一个新段
+        for (const auto &item: batch) {
+            lsm_store.apply(Operation{OperationType::INSERT_ITEM, item.code, item_to_payload(item), batch_lsn},
+                            batch_lsn);
+        }
+        if (!lsm_store.flush()) {
+            return false;
+        }
+
+        if (worker_thread.joinable()) {
+            worker_condition.notify_all(); // 段合并交给后台线程
+        } else {
+            while (lsm_store.compact()) {
+            }
+        }
+        return true;
+    }
+
+    if (data_format == DataFormat::PAGED && PagedFile::is_paged(data_path)) {
+        return merge_into_pages(operations, batch, batch_lsn);
+    }
+
+    // 新数据文件包含数据文件、日志与批量商品中最大的序列号
+    std::uint64_t lsn = std::max(read_data_lsn(), batch_lsn);
+    for (const auto &operation: operations) {
+        lsn = std::max(lsn, operation.lsn);
+    }
+
+    // 数据文件按编码升序边读边与日志的净效果归并，再与同样有序的批量商品归并后直接写出；
+    // 内存中只保留日志的净效果，新文件写入临时文件后才替换，读取的始终是旧一代
+    return write_data([this, &operations, &batch](const ItemVisitor &visit) {
+        auto next = batch.begin();
+        scan_with_overlay(std::move(operations), [&batch, &next, &visit](const Item &item) {
+            for (; next != batch.end() && next->code < item.code; ++next) {
+                visit(*next);
+            }
+            if (next != batch.end() && next->code == item.code) {
+                visit(*next++); // 批量商品取代编码相同的已有商品
+                return;
+            }
+            visit(item);
+        });
+        for (; next != batch.end(); ++next) {
+            visit(*next);
+        }
+    }, lsn);
+}
+
+
+bool Persist::merge_into_pages(const std::list<Operation> &operations, const std::vector<Item> &batch,
+                               const std::uint64_t batch_lsn) {
+    std::lock_guard<std::mutex> guard(data_mutex);
+    paged_file.open_file_object(); // 已打开时保留现有页目录
+
+    const std::uint64_t applied = paged_file.get_last_lsn();
+    std::uint64_t lsn = std::max(applied, batch_lsn);
+    for (const auto &operation: operations) {
+        lsn = std::max(lsn, operation.lsn);
+    }
+
+    // 每个商品只保留净效果，变化的商品决定需要改写的页
+    Region region;
+    const PendingMap overlay = build_overlay(operations, applied, region);
+    std::map<int, const Item *> changes;
+    for (const auto &entry: overlay) {
+        switch (entry.second.state) {
+            case PendingItem::State::SET:
+                changes[entry.first] = &entry.second.item;
+                break;
+            case PendingItem::State::UPDATED:
+                // 更新不存在的商品不产生效果
+                if (paged_file.contains(entry.first)) {
+                    changes[entry.first] = &entry.second.item;
+                }
+                break;
+            case PendingItem::State::DELETED:
+                changes[entry.first] = nullptr;
+                break;
+        }
+    }
+
+    for (const auto &item: batch) {
+        changes[item.code] = &item;
+    }
+
+    return paged_file.apply(changes, lsn);
+}
+
+
+std::list<Operation> Persist::read_segments(const std::vector<std::string> &segments) {
+    std::list<Operation> operations;
+
+    for (const auto &path: segments) {
+        OperationFile segment(path);
+        if (!segment.open_file_object()) {
+            continue;
+        }
+
+        operations.splice(operations.end(), segment.read_operations());
+        segment.close_file_object();
+    }
+    return operations;
+}
+
+
+void Persist::request_checkpoint(std::unique_lock<std::mutex> &lock) {
+    if (checkpoint_pending) {
+        if (operation_file.size() < max_log_row + max_checkpoint_lag) {
+            return; // 后台合并仍在进行，滞后量未超出上限时继续只追加
+        }
+        wait_for_checkpoint(lock);
+    }
+
+    if (!operation_file.rotate()) {
+        return;
+    }
+    dirty_codes.clear(); // 封存段中的修改由后台合并负责
+
+    checkpoint_pending = true;
+    worker_condition.notify_all();
+}
+
+
+void Persist::wait_for_checkpoint(std::unique_lock<std::mutex> &lock) {
+    worker_condition.wait(lock, [this] { return !checkpoint_pending; });
+}
 
-    // 获取并清空操作日志
-    const std::list<std::string> operations = operation_file.clear();
 
-    /*----- 操作日志重放逻辑 -----*/
-    int operation_code = 0; // 0:无操作 1:插入 2:更新
-    Item target; // 当前操作的临时数据载体
+void Persist::background_worker() {
+    std::unique_lock<std::mutex> lock(worker_mutex);
 
-    for (auto &operation: operations) {
-        if (operation.empty()) {
+    while (true) {
+        if (checkpoint_pending) {
+            const std::vector<std::string> segments = operation_file.sealed_segments();
+
+            lock.unlock();
+            // 合并期间前台只追加活动日志，不会访问数据文件与已封存的日志段
+            bool merged = false;
+            try {
+                merged = !segments.empty() &&
+                         merge_into_data(compact_sealed_segments ? compact_segments(segments)
+                                                                 : read_segments(segments));
+            } catch (const std::exception &error) {
+                std::cerr << "Background checkpoint failed: " << error.what() << std::endl; // 封存段保持原样
+            }
+            lock.lock();
+
+            if (merged) {
+                operation_file.remove_sealed(segments.size());
+            }
+
+            checkpoint_pending = false;
+            worker_condition.notify_all();
             continue;
         }
 
-        // 处理操作类型标记
-        if (operation == "[insert]") {
-            apply_pending_operation(items, operation_code, target);
-            operation_code = 1; // 标记后续为插入操作
+        if (commit_scheduled) {
+            if (!stopping && std::chrono::steady_clock::now() < operation_file.commit_deadline()) {
+                worker_condition.wait_until(lock, operation_file.commit_deadline());
+                continue;
+            }
+
+            commit_scheduled = false;
+            operation_file.commit(); // 截止时间内的写入合并为一次write+fsync
             continue;
         }
 
-        if (operation == "[update]") {
-            apply_pending_operation(items, operation_code, target);
-            operation_code = 2; // 标记后续为更新操作
+        if (data_format == DataFormat::LSM && !stopping && lsm_store.needs_compaction()) {
+            lock.unlock();
+            // 段合并不涉及日志，期间前台照常写入；合并失败时等待下一次检查点再尝试
+            const bool compacted = lsm_store.compact();
+            lock.lock();
+            if (compacted) {
+                continue;
+            }
+        }
+
+        if (stopping) {
+            return;
+        }
+        worker_condition.wait(lock);
+    }
+}
+
+
+void Persist::stop_worker() {
+    if (!worker_thread.joinable()) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(worker_mutex);
+        stopping = true;
+    }
+    worker_condition.notify_all();
+    worker_thread.join();
+}
+
+
+std::list<Operation> Persist::compact_operations(const std::list<Operation> &operations, const std::uint64_t lsn) {
+    // 每个商品最多保留一条删除与其后的一条插入或更新
+    struct Effective {
+        bool removed = false;
+        bool present = false;
+        Operation remove;
+        Operation last;
+    };
+    std::unordered_map<int, Effective> effective;
+
+    for (const auto &operation: operations) {
+        if (operation.lsn != 0 && operation.lsn <= lsn) {
             continue;
         }
 
-        // 处理删除操作
-        if (operation.find("[delete]") == 0) {
-            apply_pending_operation(items, operation_code, target);
-            operation_code = 0; // 重置操作状态
-            int code = std::stoi(operation.substr(8));
-            items.remove_if([&code](const Item &item) { return item.code == code; });
+        Effective &entry = effective[operation.code];
+        switch (operation.type) {
+            case OperationType::INSERT_ITEM:
+                entry.last = operation;
+                entry.present = true;
+                break;
+            case OperationType::UPDATE_ITEM:
+                if (entry.present && entry.last.type == OperationType::INSERT_ITEM) {
+                    // 插入后的更新并入插入
+                    entry.last.payload = operation.payload;
+                    entry.last.lsn = operation.lsn;
+                } else {
+                    entry.last = operation;
+                    entry.present = true;
+                }
+                break;
+            case OperationType::DELETE_ITEM:
+                entry.remove = operation;
+                entry.removed = true;
+                entry.present = false;
+                break;
+        }
+    }
+
+    std::list<Operation> compacted;
+    for (auto &pair: effective) {
+        if (pair.second.removed) {
+            compacted.push_back(std::move(pair.second.remove));
+        }
+        if (pair.second.present) {
+            compacted.push_back(std::move(pair.second.last));
+        }
+    }
+
+    // 恢复序列号顺序，同一商品的删除总在插入之前；旧格式记录序列号为0，稳定排序保持其相对顺序
+    compacted.sort([](const Operation &lhs, const Operation &rhs) { return lhs.lsn < rhs.lsn; });
+    return compacted;
+}
+
+
+std::list<Operation> Persist::compact_segments(const std::vector<std::string> &segments) {
+    std::list<Operation> operations;
+
+    for (const auto &path: segments) {
+        OperationFile segment(path);
+        if (!segment.open_file_object()) {
             continue;
         }
 
-        // 解析条目数据行
-        if (operation.find("ITEM|") == 0) {
-            target = parse_item_line(operation);
+        const std::list<Operation> original = segment.read_operations();
+        std::list<Operation> compacted = compact_operations(original, 0);
+        if (compacted.size() < original.size()) {
+            segment.rewrite(compacted); // 改写失败时原文件保持完整，不影响合并
         }
+        segment.close_file_object();
 
-        // 解析品牌数据行
-        if (operation.find("BRAND|") == 0) {
-            target.brand_list.emplace_back(parse_brand_line(operation));
+        operations.splice(operations.end(), compacted);
+    }
+    return operations;
+}
+
+
+std::string Persist::shard_path(const std::string &path, const std::size_t index) {
+    return path + ".shard" + std::to_string(index);
+}
+
+
+std::size_t Persist::shard_of(const int code) const {
+    if (shard_scheme == ShardScheme::RANGE) {
+        return static_cast<std::size_t>(std::upper_bound(shard_bounds.begin(), shard_bounds.end(), code) -
+                                        shard_bounds.begin());
+    }
+    return static_cast<unsigned>(code) % shards.size(); // 负数编码按补码取模，同样均匀
+}
+
+
+void Persist::for_each_shard(const std::function<void(std::size_t)> &action) {
+    std::vector<std::exception_ptr> errors(shards.size());
+    std::vector<std::thread> workers;
+    for (std::size_t index = 0; index < shards.size(); ++index) {
+        workers.emplace_back([&action, &errors, index] {
+            try {
+                action(index);
+            } catch (...) {
+                errors[index] = std::current_exception();
+            }
+        });
+    }
+    for (auto &worker: workers) {
+        worker.join();
+    }
+    for (const auto &error: errors) {
+        if (error) {
+            std::rethrow_exception(error);
         }
     }
+}
 
-    // 处理最后一个未提交的操作
-    apply_pending_operation(items, operation_code, target);
 
-    // 按code升序排列后写入数据文件
-    items.sort([](const Item &lhs, const Item &rhs) { return lhs.code < rhs.code; });
-    data_file.write(items);
-    return size; // 返回处理的日志条目数
+void Persist::for_each_shard_with_state(const std::function<void(std::size_t)> &action) {
+    // 分页与LSM格式的检查点按日志合并，不读取内存状态；没有待写出的日志时各分片也不会读取
+    const bool writes_state = state_source && data_format != DataFormat::PAGED && data_format != DataFormat::LSM &&
+                              std::any_of(shards.begin(), shards.end(), [](const std::unique_ptr<Persist> &shard) {
+                                  return shard->has_pending_log();
+                              });
+    if (writes_state) {
+        shard_states.assign(shards.size(), std::vector<Item>());
+        state_source([this](const Item &item) { shard_states[shard_of(item.code)].push_back(item); });
+        shard_states_ready = true;
+    }
+
+    try {
+        for_each_shard(action);
+    } catch (...) {
+        shard_states_ready = false;
+        shard_states.clear();
+        throw;
+    }
+    shard_states_ready = false;
+    shard_states.clear();
 }
 
 
-void Persist::apply_pending_operation(std::list<Item> &items, const int operation_code, Item &target) {
-    if (operation_code == 0) {
-        return;
+void Persist::open_shards(const std::string &operation_file_path, const int max_row, const PersistConfig &config) {
+    if (shard_scheme == ShardScheme::RANGE &&
+        (shard_bounds.size() + 1 != config.shards ||
+         std::adjacent_find(shard_bounds.begin(), shard_bounds.end(), std::greater_equal<int>()) !=
+         shard_bounds.end())) {
+        throw std::invalid_argument("shard bounds must be strictly ascending and one fewer than shards");
     }
 
-    if (operation_code == 1) {
-        // 插入操作
-        items.push_back(target);
-        return;
+    PersistConfig shard_config = config;
+    shard_config.shards = 1;
+    shard_config.shard_bounds.clear();
+
+    // 各分片独立读取数据文件序列号、重放LSM内存表、启动后台线程
+    shards.resize(config.shards);
+    for_each_shard([this, &operation_file_path, max_row, &shard_config](const std::size_t index) {
+        shards[index].reset(new Persist(shard_path(data_path, index), shard_path(operation_file_path, index),
+                                        max_row, shard_config));
+    });
+
+    if (std::ifstream(data_path).good() || std::ifstream(operation_file_path).good()) {
+        migrate_to_shards(operation_file_path, config);
+    }
+}
+
+
+void Persist::migrate_to_shards(const std::string &operation_file_path, const PersistConfig &config) {
+    PersistConfig single_config = config;
+    single_config.shards = 1;
+    single_config.background_checkpoint = false;
+    single_config.durability = Durability::BUFFERED;
+    Persist single(data_path, operation_file_path, max_log_row, single_config);
+
+    // 原数据文件叠加原日志按分片拆分；打开时已推进到数据文件、封存段与日志中最大的序列号
+    std::vector<std::list<Item>> parts(shards.size());
+    single.scan([this, &parts](const Item &item) { parts[shard_of(item.code)].push_back(item); });
+    const std::uint64_t lsn = single.operation_file.get_last_lsn();
+
+    std::vector<char> written(shards.size(), 0);
+    for_each_shard([this, &parts, &written, lsn](const std::size_t index) {
+        const std::list<Item> &part = parts[index];
+        written[index] = shards[index]->write_data([&part](const ItemVisitor &visit) {
+            for (const auto &item: part) {
+                visit(item);
+            }
+        }, lsn);
+        shards[index]->operation_file.advance_lsn(lsn); // 分片日志此后的记录序列号均大于已迁移的记录
+    });
+    if (std::find(written.begin(), written.end(), 0) != written.end()) {
+        single.operation_file.close_file_object(); // 原数据文件与日志保持不变，下次打开时重新迁移
+        single.has_closed = true;
+        throw std::runtime_error("failed to migrate data file into shards");
     }
 
-    if (operation_code == 2) {
-        // 更新操作
-        std::replace_if(items.begin(), items.end(),
-                        [&target](const Item &item) { return item.code == target.code; }, target);
+    // 分片全部写成后才把原日志合并进原数据文件并清空，之后先删日志也不会丢失记录
+    if (!single.close()) {
+        throw std::runtime_error("failed to migrate data file into shards");
+    }
+    std::remove(operation_file_path.c_str());
+    if (LsmStore::is_lsm(data_path)) {
+        LsmStore::remove_runs(data_path);
     }
+    std::remove(data_path.c_str());
 }
@@ -0,0 +1,63 @@
+﻿#include "../include/region.h"
+
+#include <algorithm>
+#include <cstdint>
+
+
+constexpr std::size_t Region::BLOCK_SIZE;
+constexpr std::size_t Region::MAX_BLOCK_SIZE;
+
+
+Region::Region(const std::size_t first_block) : next_block(std::max<std::size_t>(first_block, 64)) {
+}
+
+
+void *Region::allocate(const std::size_t size, const std::size_t alignment) {
+    bytes += size;
+
+    // 块首地址满足任意基本类型的对齐，块内按需要补齐
+    const std::size_t padding = (alignment - reinterpret_cast<std::uintptr_t>(cursor) % alignment) % alignment;
+    if (cursor != nullptr && padding + size <= remaining) {
+        char *data = cursor + padding;
+        cursor = data + size;
+        remaining -= padding + size;
+        return data;
+    }
+
+    if (size > MAX_BLOCK_SIZE) {
+        // 超大对象独占一块，插在当前块之前，当前块仍留在末尾继续使用
+        blocks.emplace_back(new char[size]);
+        char *data = blocks.back().get();
+        if (blocks.size() > 1) {
+            std::swap(blocks[blocks.size() - 1], blocks[blocks.size() - 2]);
+        }
+        return data;
+    }
+
+    while (next_block < size) {
+        next_block *= 2;
+    }
+    blocks.emplace_back(new char[next_block]);
+    cursor = blocks.back().get() + size;
+    remaining = next_block - size;
+    next_block = std::min(next_block * 2, MAX_BLOCK_SIZE);
+    return blocks.back().get();
+}
+
+
+void Region::release() {
+    blocks.clear();
+    cursor = nullptr;
+    remaining = 0;
+    bytes = 0;
+}
+
+
+std::size_t Region::block_count() const {
+    return blocks.size();
+}
+
+
+std::size_t Region::size_bytes() const {
+    return bytes;
+}
@@ -1,7 +1,506 @@
 ﻿#include "../include/storage.h"
 
+#include <algorithm>
 #include <sstream>
+#include <stdexcept>
 #include <iostream>
+#include <iterator>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <sys/stat.h>
+
+#include <thread>
+#include <unordered_map>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#include <io.h>
+#include <fcntl.h>
+#else
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+
+namespace {
+    const char WAL_MAGIC[] = "IMSWAL2\n"; ///< 二进制日志文件头
+    const char WAL_MAGIC_V1[] = "IMSWAL1\n"; ///< 第一版二进制日志文件头（帧头不含LSN，仍可读取与追加）
+    constexpr std::streamoff WAL_HEADER_SIZE = 8; ///< 文件头字节数
+    constexpr std::streamoff FRAME_HEAD_SIZE = 17; ///< 帧头字节数（长度4 + 类型1 + 编码4 + LSN8）
+    constexpr std::streamoff FRAME_HEAD_SIZE_V1 = 9; ///< 第一版帧头字节数（长度4 + 类型1 + 编码4）
+
+    constexpr size_t PARALLEL_LOAD_CHUNK_BYTES = 1 << 20; ///< 解析数据文件时每个线程每轮分到的字节数
+    constexpr size_t WRITE_BUFFER_BYTES = 1 << 22; ///< 写数据文件时每次整块写出的缓冲大小
+
+    // CRC32（多项式0xEDB88320），支持分段累加
+    uint32_t crc32(uint32_t crc, const char *data, const size_t size) {
+        static const std::vector<uint32_t> table = [] {
+            std::vector<uint32_t> result(256);
+            for (uint32_t i = 0; i < 256; ++i) {
+                uint32_t value = i;
+                for (int bit = 0; bit < 8; ++bit) {
+                    value = (value & 1) ? (0xEDB88320u ^ (value >> 1)) : (value >> 1);
+                }
+                result[i] = value;
+            }
+            return result;
+        }();
+
+        crc = ~crc;
+        for (size_t i = 0; i < size; ++i) {
+            crc = table[(crc ^ static_cast<unsigned char>(data[i])) & 0xFF] ^ (crc >> 8);
+        }
+        return ~crc;
+    }
+
+    // 小端序写入32位整数
+    void put_u32(std::string &out, const uint32_t value) {
+        for (int i = 0; i < 4; ++i) {
+            out.push_back(static_cast<char>((value >> (8 * i)) & 0xFF));
+        }
+    }
+
+    // 小端序读取32位整数
+    uint32_t get_u32(const char *data) {
+        uint32_t value = 0;
+        for (int i = 3; i >= 0; --i) {
+            value = (value << 8) | static_cast<unsigned char>(data[i]);
+        }
+        return value;
+    }
+
+    // 小端序写入64位整数
+    void put_u64(std::string &out, const uint64_t value) {
+        put_u32(out, static_cast<uint32_t>(value));
+        put_u32(out, static_cast<uint32_t>(value >> 32));
+    }
+
+    // 小端序读取64位整数
+    uint64_t get_u64(const char *data) {
+        return static_cast<uint64_t>(get_u32(data)) | static_cast<uint64_t>(get_u32(data + 4)) << 32;
+    }
+
+    // 解析文本日志记录标记行（如"[delete]5@12"）中'@'之后的日志序列号，旧格式没有时返回0
+    uint64_t marker_lsn(const std::string &line) {
+        const size_t at = line.find('@');
+        if (at == std::string::npos || at + 1 >= line.size()) {
+            return 0;
+        }
+        return std::stoull(line.substr(at + 1));
+    }
+
+    // 描述日志中部的损坏记录及其前后的序列号缺口
+    std::string log_gap_message(const std::string &path, const std::streamoff offset, const uint64_t before,
+                                const uint64_t after) {
+        return "corrupted log record at offset " + std::to_string(offset) + " in " + path +
+               ": valid records follow it, LSN gap after " + std::to_string(before) +
+               (after != 0 ? " up to " + std::to_string(after) : std::string());
+    }
+
+    const char SNAPSHOT_MAGIC[] = "IMSSNAP1"; ///< 二进制快照文件头
+    constexpr uint32_t SNAPSHOT_VERSION = 1; ///< 快照格式版本
+
+    // 快照文件头，所有定长结构均按主机字节序（小端）存储
+    struct SnapshotHeader {
+        char magic[8];
+        uint32_t version;
+        uint32_t item_count;
+        uint32_t brand_count;
+        uint32_t flags;
+        uint64_t last_lsn;
+        uint64_t items_offset;
+        uint64_t brands_offset;
+        uint64_t strings_offset;
+        uint64_t strings_size;
+    };
+
+    // 定长商品记录，品牌以[first_brand, first_brand + brand_count)引用品牌记录数组
+    struct ItemRecord {
+        int32_t code;
+        int32_t quantity;
+        uint32_t first_brand;
+        uint32_t brand_count;
+        uint32_t name_offset;
+        uint32_t name_length;
+        uint32_t colour_offset;
+        uint32_t colour_length;
+    };
+
+    // 定长品牌记录
+    struct BrandRecord {
+        double price;
+        int32_t code;
+        int32_t quantity;
+        uint32_t name_offset;
+        uint32_t name_length;
+    };
+
+    static_assert(sizeof(SnapshotHeader) == 64, "unexpected snapshot header layout");
+    static_assert(sizeof(ItemRecord) == 32, "unexpected item record layout");
+    static_assert(sizeof(BrandRecord) == 24, "unexpected brand record layout");
+
+    // 读取并校验快照文件头及各区段边界
+    bool read_snapshot_header(const MappedFile &image, SnapshotHeader &header) {
+        if (image.data() == nullptr || image.size() < sizeof(SnapshotHeader)) {
+            return false;
+        }
+
+        std::memcpy(&header, image.data(), sizeof(header));
+        return std::memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic)) == 0 &&
+               header.version == SNAPSHOT_VERSION &&
+               header.items_offset + static_cast<uint64_t>(header.item_count) * sizeof(ItemRecord) <= image.size() &&
+               header.brands_offset + static_cast<uint64_t>(header.brand_count) * sizeof(BrandRecord) <= image.size() &&
+               header.strings_offset + header.strings_size <= image.size();
+    }
+
+    // 读取快照中的第index条商品记录，并校验其引用的字符串与品牌范围
+    bool read_item_record(const char *base, const SnapshotHeader &header, const uint32_t index, ItemRecord &record) {
+        std::memcpy(&record, base + header.items_offset + static_cast<uint64_t>(index) * sizeof(ItemRecord),
+                    sizeof(record));
+        return static_cast<uint64_t>(record.name_offset) + record.name_length <= header.strings_size &&
+               static_cast<uint64_t>(record.colour_offset) + record.colour_length <= header.strings_size &&
+               static_cast<uint64_t>(record.first_brand) + record.brand_count <= header.brand_count;
+    }
+
+    // 解码快照中的第index条商品及其品牌
+    bool decode_snapshot_item(const char *base, const SnapshotHeader &header, const uint32_t index, Item &item) {
+        ItemRecord record{};
+        if (!read_item_record(base, header, index, record)) {
+            return false;
+        }
+
+        const char *strings = base + header.strings_offset;
+        item.code = record.code;
+        item.quantity = record.quantity;
+        item.name.assign(strings + record.name_offset, record.name_length);
+        item.colour.assign(strings + record.colour_offset, record.colour_length);
+        item.brand_list.clear();
+
+        for (uint32_t j = 0; j < record.brand_count; ++j) {
+            BrandRecord brand_record{};
+            std::memcpy(&brand_record, base + header.brands_offset + (record.first_brand + j) * sizeof(BrandRecord),
+                        sizeof(brand_record));
+            if (static_cast<uint64_t>(brand_record.name_offset) + brand_record.name_length > header.strings_size) {
+                break;
+            }
+
+            Brand brand;
+            brand.name.assign(strings + brand_record.name_offset, brand_record.name_length);
+            brand.code = brand_record.code;
+            brand.quantity = brand_record.quantity;
+            brand.price = brand_record.price;
+            item.brand_list.push_back(std::move(brand));
+        }
+
+        return true;
+    }
+
+    const char PAGED_MAGIC[] = "IMSPAGE1"; ///< 分页数据文件头
+    const char JOURNAL_MAGIC[] = "IMSJRNL1"; ///< 分页文件重做日志头
+    constexpr uint32_t PAGED_VERSION = 1; ///< 分页格式版本
+    constexpr uint32_t PAGED_HEADER_SIZE = 36; ///< 文件头有效字节数（魔数8 + 版本4 + 页大小4 + 页数4 + 保留4 + LSN8 + CRC4）
+    constexpr uint32_t PAGE_HEAD_SIZE = 16; ///< 数据页页头字节数（CRC4 + 类型2 + 记录数2 + 已用字节4 + 连续页数4）
+    constexpr uint32_t RECORD_HEAD_SIZE = 8; ///< 记录头字节数（负载长度4 + 商品编码4）
+    constexpr uint32_t MIN_PAGE_SIZE = 256; ///< 最小页大小
+    constexpr uint32_t MAX_PAGE_SIZE = 1 << 16; ///< 最大页大小（保证记录数不超出u16）
+    constexpr uint32_t PAGE_FILL_PERCENT = 90; ///< 整体写入时每页的填充比例，余量留给变长的更新
+
+    const char RUN_MAGIC[] = "IMSRUN01"; ///< LSM段文件头
+    const char MANIFEST_MAGIC[] = "IMSLSM1"; ///< LSM清单首行
+    constexpr size_t RUN_HEADER_SIZE = 8; ///< 段文件头字节数
+    constexpr size_t RUN_RECORD_HEAD_SIZE = 9; ///< 段记录头字节数（类型1 + 编码4 + 负载长度4）
+    constexpr size_t RUN_TRAILER_SIZE = 8; ///< 段文件尾字节数（记录数4 + CRC4）
+    constexpr unsigned BASE_RUN_LEVEL = 16; ///< 由其他格式转换得到的基础段所在层，不与上层的小段合并
+
+    // 数据页类型
+    enum PageType : uint16_t {
+        PAGE_FREE = 0, ///< 空闲页
+        PAGE_DATA = 1, ///< 普通页，存放多条记录
+        PAGE_EXTENT_HEAD = 2, ///< 连续页的首页
+        PAGE_EXTENT_PART = 3 ///< 连续页的后续页
+    };
+
+    // 小端序写入16位整数
+    void put_u16(std::string &out, const uint16_t value) {
+        out.push_back(static_cast<char>(value & 0xFF));
+        out.push_back(static_cast<char>(value >> 8));
+    }
+
+    // 小端序读取16位整数
+    uint16_t get_u16(const char *data) {
+        return static_cast<uint16_t>(static_cast<unsigned char>(data[0]) |
+                                     static_cast<unsigned char>(data[1]) << 8);
+    }
+
+    // 校验分页文件头，成功时输出页大小、页数与序列号
+    bool parse_paged_header(const char *data, const size_t size, uint32_t &page_size, uint32_t &page_count,
+                            uint64_t &lsn) {
+        if (size < PAGED_HEADER_SIZE || std::memcmp(data, PAGED_MAGIC, 8) != 0 || get_u32(data + 8) != PAGED_VERSION ||
+            get_u32(data + 32) != crc32(0, data, 32)) {
+            return false;
+        }
+
+        page_size = get_u32(data + 12);
+        page_count = get_u32(data + 16);
+        lsn = get_u64(data + 24);
+        return page_size >= MIN_PAGE_SIZE && page_size <= MAX_PAGE_SIZE && page_count >= 1;
+    }
+
+    // 由页体（页头之后的内容）组装完整页并写入页头与校验和
+    std::string seal_page(const std::string &body, const uint32_t page_size, const uint16_t type,
+                          const uint16_t count, const uint32_t span) {
+        std::string page;
+        page.reserve(page_size);
+        put_u32(page, 0);
+        put_u16(page, type);
+        put_u16(page, count);
+        put_u32(page, static_cast<uint32_t>(body.size()));
+        put_u32(page, span);
+        page += body;
+        page.resize(page_size, '\0');
+
+        const uint32_t crc = crc32(0, page.data() + 4, page.size() - 4);
+        for (int i = 0; i < 4; ++i) {
+            page[static_cast<size_t>(i)] = static_cast<char>((crc >> (8 * i)) & 0xFF);
+        }
+        return page;
+    }
+
+    // 检查页校验和
+    bool page_valid(const char *page, const uint32_t page_size) {
+        return get_u32(page) == crc32(0, page + 4, page_size - 4);
+    }
+
+    // 编码一个存放多条记录的普通页，没有记录时编码为空闲页
+    std::string encode_data_page(const std::map<int, std::string> &records, const uint32_t page_size) {
+        std::string body;
+        for (const auto &record: records) {
+            put_u32(body, static_cast<uint32_t>(record.second.size()));
+            put_u32(body, static_cast<uint32_t>(record.first));
+            body += record.second;
+        }
+        return seal_page(body, page_size, records.empty() ? PAGE_FREE : PAGE_DATA,
+                         static_cast<uint16_t>(records.size()), records.empty() ? 0 : 1);
+    }
+
+    // 编码一段连续页，返回其页数
+    uint32_t append_extent_pages(std::string &out, const int code, const std::string &payload,
+                                 const uint32_t page_size) {
+        std::string record;
+        put_u32(record, static_cast<uint32_t>(payload.size()));
+        put_u32(record, static_cast<uint32_t>(code));
+        record += payload;
+
+        const uint32_t capacity = page_size - PAGE_HEAD_SIZE;
+        const auto span = static_cast<uint32_t>((record.size() + capacity - 1) / capacity);
+        for (uint32_t i = 0; i < span; ++i) {
+            const std::string body = record.substr(static_cast<size_t>(i) * capacity, capacity);
+            out += i == 0 ? seal_page(body, page_size, PAGE_EXTENT_HEAD, 1, span)
+                          : seal_page(body, page_size, PAGE_EXTENT_PART, 0, 0);
+        }
+        return span;
+    }
+
+    // 解析普通页中的全部记录（商品编码 → 负载）
+    void decode_data_page(const char *page, const uint32_t page_size, std::map<int, std::string> &records) {
+        if (get_u16(page + 4) != PAGE_DATA) {
+            return;
+        }
+
+        const uint16_t count = get_u16(page + 6);
+        const char *p = page + PAGE_HEAD_SIZE;
+        const char *end = p + std::min(get_u32(page + 8), page_size - PAGE_HEAD_SIZE);
+        for (uint16_t i = 0; i < count && end - p >= static_cast<std::ptrdiff_t>(RECORD_HEAD_SIZE); ++i) {
+            const uint32_t length = std::min(get_u32(p), static_cast<uint32_t>(end - p - RECORD_HEAD_SIZE));
+            records[static_cast<int32_t>(get_u32(p + 4))] = std::string(p + RECORD_HEAD_SIZE, length);
+            p += RECORD_HEAD_SIZE + length;
+        }
+    }
+
+    // 将文件内容同步到磁盘
+    // 打开仅用于同步的文件描述符，失败时返回-1
+    int open_sync_descriptor(const std::string &path) {
+#ifdef _WIN32
+        return _open(path.c_str(), _O_RDWR | _O_BINARY);
+#else
+        return ::open(path.c_str(), O_RDONLY);
+#endif
+    }
+
+    // 将描述符所指文件的数据同步到磁盘
+    bool sync_descriptor(const int fd) {
+#ifdef _WIN32
+        return _commit(fd) == 0;
+#else
+        return ::fsync(fd) == 0;
+#endif
+    }
+
+    void close_descriptor(const int fd) {
+#ifdef _WIN32
+        _close(fd);
+#else
+        ::close(fd);
+#endif
+    }
+
+    // 将文件内容同步到磁盘
+    bool sync_file(const std::string &path) {
+        const int fd = open_sync_descriptor(path);
+        if (fd < 0) {
+            return false;
+        }
+        const bool result = sync_descriptor(fd);
+        close_descriptor(fd);
+        return result;
+    }
+
+    // 将目录项的变化（创建、重命名）同步到磁盘
+    bool sync_directory(const std::string &path) {
+#ifdef _WIN32
+        (void) path; // Windows通过MOVEFILE_WRITE_THROUGH保证重命名落盘
+        return true;
+#else
+        const size_t slash = path.find_last_of('/');
+        const std::string directory = slash == std::string::npos ? "." : slash == 0 ? "/" : path.substr(0, slash);
+        const int fd = ::open(directory.c_str(), O_RDONLY);
+        if (fd < 0) {
+            return false;
+        }
+        const bool result = ::fsync(fd) == 0;
+        ::close(fd);
+        return result;
+#endif
+    }
+
+    // 用source原子替换target，并保证重命名本身已落盘
+    bool replace_file(const std::string &source, const std::string &target) {
+#ifdef _WIN32
+        return MoveFileExA(source.c_str(), target.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+        return std::rename(source.c_str(), target.c_str()) == 0 && sync_directory(target);
+#endif
+    }
+
+    // 将较新的LSM记录叠加到较旧的记录上，结果写回较旧的记录
+    void fold_entry(LsmEntry &older, LsmEntry &&newer) {
+        if (newer.type != LsmEntryType::UPDATED) {
+            older = std::move(newer);
+        } else if (older.type != LsmEntryType::DELETED) {
+            older.payload = std::move(newer.payload); // 插入后的更新仍是插入，删除后的更新不产生效果
+        }
+    }
+
+    // 按编码升序遍历LSM的一层（内存表或段文件）
+    class LayerCursor {
+    private:
+        const std::map<int, LsmEntry> *table = nullptr;
+        std::map<int, LsmEntry>::const_iterator position;
+        const SortedRun *run = nullptr;
+        RunCursor current;
+        bool has_entry = false;
+
+        void load_table_entry() {
+            has_entry = position != table->end();
+            if (has_entry) {
+                current.code = position->first;
+                current.type = position->second.type;
+                current.payload = position->second.payload.data();
+                current.length = static_cast<uint32_t>(position->second.payload.size());
+            }
+        }
+
+    public:
+        explicit LayerCursor(const std::map<int, LsmEntry> &source) : table(&source), position(source.begin()) {
+            load_table_entry();
+        }
+
+        explicit LayerCursor(const SortedRun &source) : run(&source) {
+            has_entry = run->next(current);
+        }
+
+        bool valid() const {
+            return has_entry;
+        }
+
+        const RunCursor &entry() const {
+            return current;
+        }
+
+        void next() {
+            if (table != nullptr) {
+                ++position;
+                load_table_entry();
+            } else {
+                has_entry = run->next(current);
+            }
+        }
+    };
+
+    // 按编码升序归并由新到旧排列的各层，同一编码解析为一条记录；
+    // bottom为true时归并范围包含最旧的数据，只输出确定存在的商品
+    void merge_layers(std::vector<LayerCursor> &layers, const bool bottom, const EntryVisitor &emit) {
+        while (true) {
+            bool found = false;
+            int code = 0;
+            for (const auto &layer: layers) {
+                if (layer.valid() && (!found || layer.entry().code < code)) {
+                    code = layer.entry().code;
+                    found = true;
+                }
+            }
+            if (!found) {
+                return;
+            }
+
+            // 最新的记录决定负载；更新记录由更旧的层决定商品是否存在
+            RunCursor result;
+            bool first = true;
+            bool resolved = false;
+            for (auto &layer: layers) {
+                if (!layer.valid() || layer.entry().code != code) {
+                    continue;
+                }
+
+                if (first) {
+                    result = layer.entry();
+                    resolved = result.type != LsmEntryType::UPDATED;
+                    first = false;
+                } else if (!resolved && layer.entry().type != LsmEntryType::UPDATED) {
+                    result.type = layer.entry().type;
+                    resolved = true;
+                }
+                layer.next();
+            }
+
+            if (bottom && result.type != LsmEntryType::SET) {
+                continue; // 墓碑与找不到原商品的更新到最旧一层为止
+            }
+            emit(code, result.type, result.payload, result.type == LsmEntryType::DELETED ? 0 : result.length);
+        }
+    }
+
+    // 按路径截断文件
+    bool truncate_file(const std::string &path, const std::streamoff length) {
+#ifdef _WIN32
+        const int fd = _open(path.c_str(), _O_RDWR | _O_BINARY);
+        if (fd < 0) {
+            return false;
+        }
+        const bool result = _chsize_s(fd, length) == 0;
+        _close(fd);
+        return result;
+#else
+        return ::truncate(path.c_str(), static_cast<off_t>(length)) == 0;
+#endif
+    }
+}
 
 BaseFile::BaseFile(std::string file_path) {
     path = std::move(file_path);
@@ -21,11 +520,12 @@ bool BaseFile::open_file_object() {
 
     std::fstream file;
     struct stat buffer{};
+    const std::ios::openmode mode = binary_mode ? std::ios::binary : std::ios::openmode();
     // 根据文件存在性选择打开模式：存在则保留内容，不存在则创建
     if (stat(path.c_str(), &buffer) == 0) {
-        file.open(path, std::ios::in | std::ios::out); // 读写模式
+        file.open(path, std::ios::in | std::ios::out | mode); // 读写模式
     } else {
-        file.open(path, std::ios::in | std::ios::out | std::ios::trunc); // 新建文件
+        file.open(path, std::ios::in | std::ios::out | std::ios::trunc | mode); // 新建文件
     }
 
     if (!file.is_open()) {
@@ -62,13 +562,42 @@ void BaseFile::clear_file_context() {
     }
 
     std::fstream file;
-    file.open(path, std::ios::in | std::ios::out | std::ios::trunc);
+    const std::ios::openmode mode = binary_mode ? std::ios::binary : std::ios::openmode();
+    file.open(path, std::ios::in | std::ios::out | std::ios::trunc | mode);
     file_object = std::move(file);
 
     has_file_object = true;
 }
 
 
+bool BaseFile::replace_file_content(const std::function<bool(std::ostream &)> &writer) {
+    if (has_file_object) {
+        close_file_object();
+    }
+
+    const std::string temp_path = path + ".tmp";
+    const std::ios::openmode mode = binary_mode ? std::ios::binary : std::ios::openmode();
+    std::ofstream temp(temp_path, std::ios::out | std::ios::trunc | mode);
+    if (!temp.is_open()) {
+        std::cerr << "Error opening file: " << temp_path << std::endl;
+        return false;
+    }
+
+    bool result = writer(temp);
+    temp.flush();
+    result = result && !temp.fail();
+    temp.close();
+
+    // 新一代内容落盘后才替换，崩溃时原文件仍是完整的上一代
+    if (!result || !sync_file(temp_path) || !replace_file(temp_path, path)) {
+        std::cerr << "Replace operation failed: " << path << std::endl;
+        std::remove(temp_path.c_str());
+        return false;
+    }
+    return true;
+}
+
+
 void BaseFile::reduction() {
     if (!has_file_object) {
         return;
@@ -92,168 +621,2273 @@ bool BaseFile::set_file_path(std::string new_file_path) {
 }
 
 
-bool WriteDataFile::write(const std::list<Item> &items) {
-    clear_file_context(); // 清空原有内容
-    std::fstream &file = get_file_object();
-    std::stringstream buffer; // 内存缓冲提升写入效率
+void BaseFile::set_binary_mode(const bool enable) {
+    binary_mode = enable;
+}
 
-    if (!file.is_open()) {
-        return false;
-    }
 
-    for (auto &item: items) {
-        std::string item_row = item_to_csv(item);
-        buffer << item_row << std::endl; // 写入商品行
+const std::string &BaseFile::get_file_path() const {
+    return path;
+}
+
 
-        // 写入关联品牌数据
-        for (auto &brand: item.brand_list) {
-            std::string brand_row = brand_to_csv(brand);
-            buffer << brand_row << std::endl;
-        }
+std::vector<unsigned long> BaseFile::list_numbered_files(const std::string &path) {
+    const size_t slash = path.find_last_of("/\\");
+    const std::string directory = slash == std::string::npos ? std::string() : path.substr(0, slash + 1);
+    const std::string prefix = path.substr(slash == std::string::npos ? 0 : slash + 1) + '.';
 
-        buffer << std::endl; // 商品数据块分隔
+    std::vector<std::string> names;
+#ifdef _WIN32
+    WIN32_FIND_DATAA data;
+    const HANDLE handle = FindFirstFileA((directory + prefix + '*').c_str(), &data);
+    if (handle != INVALID_HANDLE_VALUE) {
+        do {
+            names.emplace_back(data.cFileName);
+        } while (FindNextFileA(handle, &data));
+        FindClose(handle);
+    }
+#else
+    DIR *dir = ::opendir(directory.empty() ? "." : directory.c_str());
+    if (dir != nullptr) {
+        while (const dirent *entry = ::readdir(dir)) {
+            names.emplace_back(entry->d_name);
+        }
+        ::closedir(dir);
     }
+#endif
 
-    try {
-        file << buffer.rdbuf();
-    } catch (const std::ios_base::failure& e) {
-        std::cerr << "写入失败: " << e.what();
-        return false;
+    std::vector<unsigned long> numbers;
+    for (const auto &name: names) {
+        if (name.size() <= prefix.size() || name.compare(0, prefix.size(), prefix) != 0) {
+            continue;
+        }
+        const std::string suffix = name.substr(prefix.size());
+        if (suffix.find_first_not_of("0123456789") != std::string::npos) {
+            continue;
+        }
+        numbers.push_back(std::stoul(suffix));
     }
 
-    reduction(); // 重置文件指针
-    return true;
+    std::sort(numbers.begin(), numbers.end());
+    return numbers;
 }
 
 
-std::list<Item> ReadDataFile::read() {
-    std::list<Item> items;
-    std::fstream &file = get_file_object();
+bool WriteDataFile::write(const std::list<Item> &items, const std::uint64_t lsn) {
+    return write([&items](const ItemVisitor &visit) {
+        for (const auto &item: items) {
+            visit(item);
+        }
+    }, lsn);
+}
 
-    if (!file.is_open()) {
-        return items;
-    }
 
-    std::string line;
-    Item current_item;
-    bool has_item = false;
+bool WriteDataFile::write(const ItemSource &source, const std::uint64_t lsn) {
+    const bool result = replace_file_content([&source, lsn](std::ostream &file) {
+        // 所有记录追加到同一块缓冲，攒满后整块写出
+        std::string buffer;
+        buffer.reserve(WRITE_BUFFER_BYTES + 4096);
+        auto drain = [&file, &buffer] {
+            file.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+            buffer.clear();
+        };
 
-    while (std::getline(file, line)) {
-        if (line.empty()) {
-            continue;
+        if (lsn != 0) {
+            buffer += "LSN|" + std::to_string(lsn) + '\n'; // 数据所包含的最后一条日志
         }
 
-        if (line.find("ITEM|") == 0) {
-            if (has_item) {
-                current_item.brand_number = static_cast<int>(current_item.brand_list.size());
-                items.push_back(current_item);
+        source([&buffer, &drain](const Item &item) {
+            append_item_csv(buffer, item); // 写入商品行
+            buffer += '\n';
+
+            // 写入关联品牌数据
+            for (auto &brand: item.brand_list) {
+                append_brand_csv(buffer, brand);
+                buffer += '\n';
             }
-            current_item = parse_item_line(line);
-            current_item.brand_list.clear();
-            has_item = true;
-        } else if (line.find("BRAND|") == 0) {
-            if (has_item) {
-                current_item.brand_list.push_back(parse_brand_line(line));
+
+            buffer += '\n'; // 商品数据块分隔
+            if (buffer.size() >= WRITE_BUFFER_BYTES) {
+                drain();
             }
-        }
+        });
+        drain();
+        return true;
+    });
+
+    open_file_object(); // 重新打开新一代文件，保持写入后可直接读取
+    return result;
+}
+
+
+MappedFile::~MappedFile() {
+    unmap();
+}
+
+
+bool MappedFile::map(const std::string &path) {
+    unmap();
+
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                              nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        return false;
     }
 
-    if (has_item) {
-        current_item.brand_number = static_cast<int>(current_item.brand_list.size());
-        items.push_back(current_item);
+    LARGE_INTEGER length;
+    if (!GetFileSizeEx(file, &length) || length.QuadPart == 0) {
+        CloseHandle(file);
+        return false;
     }
 
-    reduction();
-    return items;
-}
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mapping == nullptr) {
+        CloseHandle(file);
+        return false;
+    }
 
+    const void *address = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (address == nullptr) {
+        CloseHandle(mapping);
+        CloseHandle(file);
+        return false;
+    }
 
-bool OperationFile::append(const std::string &line) {
-    std::fstream &file = get_file_object();
-    if (!file.is_open()) {
+    file_handle = file;
+    mapping_handle = mapping;
+    data_pointer = static_cast<const char *>(address);
+    data_size = static_cast<size_t>(length.QuadPart);
+#else
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
         return false;
     }
 
-    file.seekp(0, std::ios::end);
-    if (file.fail()) {
-        std::cerr << "Seek operation failed" << std::endl;
+    struct stat info{};
+    if (fstat(fd, &info) != 0 || info.st_size == 0) {
+        ::close(fd);
         return false;
     }
-    file << line << std::endl;
-    file.flush();
 
-    reduction();
+    void *address = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd); // 映射建立后即可关闭描述符
+    if (address == MAP_FAILED) {
+        return false;
+    }
+
+    data_pointer = static_cast<const char *>(address);
+    data_size = static_cast<size_t>(info.st_size);
+#endif
     return true;
 }
 
 
-std::string OperationFile::pop() {
-    std::fstream &file = get_file_object();
-    if (!file.is_open()) {
-        return "FOE";
+void MappedFile::unmap() {
+    if (data_pointer == nullptr) {
+        return;
     }
 
-    std::list<std::string> lines;
+#ifdef _WIN32
+    UnmapViewOfFile(data_pointer);
+    CloseHandle(mapping_handle);
+    CloseHandle(file_handle);
+    mapping_handle = nullptr;
+    file_handle = nullptr;
+#else
+    munmap(const_cast<char *>(data_pointer), data_size);
+#endif
 
-    std::string fileLine;
-    while (std::getline(file, fileLine)) {
-        lines.push_back(fileLine);
-    }
+    data_pointer = nullptr;
+    data_size = 0;
+}
 
-    if (lines.empty()) {
-        return "FIE"; // 空文件标识
-    }
 
-    std::string last = lines.back();
-    lines.pop_back();
+const char *MappedFile::data() const {
+    return data_pointer;
+}
 
-    clear_file_context(); // 清空文件后重新写入剩余内容
-    std::fstream &newFile = get_file_object();
-    for (const auto &line: lines) {
-        newFile << line << std::endl;
-    }
 
-    newFile.flush();
-    reduction();
-    return last; // 返回被删除的最后一条记录
+size_t MappedFile::size() const {
+    return data_size;
 }
 
 
-std::list<std::string> OperationFile::clear() {
-    std::list<std::string> lines;
-    std::fstream &file = get_file_object();
+SnapshotFile::SnapshotFile(std::string file_path) : BaseFile(std::move(file_path)) {
+    set_binary_mode(true);
+}
 
-    if (!file.is_open()) {
-        lines.emplace_back("FOE");
-        return lines;
-    }
 
-    std::string line;
-    while (std::getline(file, line)) {
-        lines.push_back(line);
-    }
+bool SnapshotFile::write(const std::list<Item> &items, const std::uint64_t lsn) {
+    return write([&items](const ItemVisitor &visit) {
+        for (const auto &item: items) {
+            visit(item);
+        }
+    }, lsn);
+}
 
-    clear_file_context();
-    return lines;
+
+bool SnapshotFile::write(const ItemSource &source, const std::uint64_t lsn) {
+    std::vector<ItemRecord> item_records;
+    std::vector<BrandRecord> brand_records;
+    std::string strings;
+    std::unordered_map<std::string, uint32_t> string_offsets; // 重复的颜色、品牌名只存一份
+
+    auto store = [&strings, &string_offsets](const std::string &value) -> uint32_t {
+        const auto found = string_offsets.find(value);
+        if (found != string_offsets.end()) {
+            return found->second;
+        }
+
+        const auto offset = static_cast<uint32_t>(strings.size());
+        strings += value;
+        string_offsets.emplace(value, offset);
+        return offset;
+    };
+
+    source([&](const Item &item) {
+        ItemRecord record{};
+        record.code = item.code;
+        record.quantity = item.quantity;
+        record.first_brand = static_cast<uint32_t>(brand_records.size());
+        record.brand_count = static_cast<uint32_t>(item.brand_list.size());
+        record.name_offset = store(item.name);
+        record.name_length = static_cast<uint32_t>(item.name.size());
+        record.colour_offset = store(item.colour);
+        record.colour_length = static_cast<uint32_t>(item.colour.size());
+        item_records.push_back(record);
+
+        for (const auto &brand: item.brand_list) {
+            BrandRecord brand_record{};
+            brand_record.price = brand.price;
+            brand_record.code = brand.code;
+            brand_record.quantity = brand.quantity;
+            brand_record.name_offset = store(brand.name);
+            brand_record.name_length = static_cast<uint32_t>(brand.name.size());
+            brand_records.push_back(brand_record);
+        }
+    });
+
+    SnapshotHeader header{};
+    std::memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+    header.version = SNAPSHOT_VERSION;
+    header.item_count = static_cast<uint32_t>(item_records.size());
+    header.brand_count = static_cast<uint32_t>(brand_records.size());
+    header.last_lsn = lsn;
+    header.items_offset = sizeof(SnapshotHeader);
+    header.brands_offset = header.items_offset + item_records.size() * sizeof(ItemRecord);
+    header.strings_offset = header.brands_offset + brand_records.size() * sizeof(BrandRecord);
+    header.strings_size = strings.size();
+
+    // 各区段已是连续内存，直接整块写出，不再拼接成完整映像；读取通过内存映射完成，无需保留写句柄
+    return replace_file_content([&](std::ostream &file) {
+        file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        file.write(reinterpret_cast<const char *>(item_records.data()),
+                   static_cast<std::streamsize>(item_records.size() * sizeof(ItemRecord)));
+        file.write(reinterpret_cast<const char *>(brand_records.data()),
+                   static_cast<std::streamsize>(brand_records.size() * sizeof(BrandRecord)));
+        file.write(strings.data(), static_cast<std::streamsize>(strings.size()));
+        return true;
+    });
 }
 
 
-int OperationFile::size() {
-    int count = 0;
-    std::fstream& file = get_file_object();
+std::list<Item> SnapshotFile::read() const {
+    std::uint64_t lsn = 0;
+    return read(lsn);
+}
 
-    if (!file.is_open()) {
-        return 0; // 文件未打开返回0
+
+std::list<Item> SnapshotFile::read(std::uint64_t &lsn) const {
+    std::list<Item> items;
+
+    MappedFile image;
+    image.map(get_file_path());
+    lsn = read_lsn(image);
+    scan(image, [&items](const Item &item) { items.push_back(item); });
+
+    return items;
+}
+
+
+bool SnapshotFile::scan(const ItemVisitor &visit) const {
+    MappedFile image;
+    return image.map(get_file_path()) && scan(image, visit);
+}
+
+
+bool SnapshotFile::scan(const MappedFile &image, const ItemVisitor &visit) {
+    if (image.data() == nullptr || image.size() < sizeof(SnapshotHeader)) {
+        return false;
     }
 
-    std::string line;
-    while (std::getline(file, line)) {
-        if (!line.empty() && line[0] == '[') {
-            ++count;
+    // 校验文件头及各区段边界
+    SnapshotHeader header{};
+    if (!read_snapshot_header(image, header)) {
+        std::cerr << "Invalid snapshot file" << std::endl;
+        return false;
+    }
+
+    // 逐条解码后立即交给访问回调，不保留已访问的商品
+    for (uint32_t i = 0; i < header.item_count; ++i) {
+        Item item;
+        if (!decode_snapshot_item(image.data(), header, i, item)) {
+            std::cerr << "Corrupted snapshot record: " << i << std::endl;
+            break;
         }
+        visit(item);
     }
 
-    reduction(); // 重置指针以便后续操作
-    return count;
+    return true;
+}
+
+
+std::uint32_t SnapshotFile::item_count(const MappedFile &image) {
+    SnapshotHeader header{};
+    return read_snapshot_header(image, header) ? header.item_count : 0;
 }
 
+
+bool SnapshotFile::read_item(const MappedFile &image, const std::uint32_t index, Item &item) {
+    SnapshotHeader header{};
+    return read_snapshot_header(image, header) && index < header.item_count &&
+           decode_snapshot_item(image.data(), header, index, item);
+}
+
+
+bool SnapshotFile::read_key(const MappedFile &image, const std::uint32_t index, int &code, std::string &name) {
+    SnapshotHeader header{};
+    ItemRecord record{};
+    if (!read_snapshot_header(image, header) || index >= header.item_count ||
+        !read_item_record(image.data(), header, index, record)) {
+        return false;
+    }
+
+    code = record.code;
+    name.assign(image.data() + header.strings_offset + record.name_offset, record.name_length);
+    return true;
+}
+
+
+std::uint64_t SnapshotFile::read_lsn(const MappedFile &image) {
+    SnapshotHeader header{};
+    if (image.data() == nullptr || image.size() < sizeof(header)) {
+        return 0;
+    }
+
+    std::memcpy(&header, image.data(), sizeof(header));
+    return std::memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic)) == 0 ? header.last_lsn : 0;
+}
+
+
+std::uint64_t SnapshotFile::read_lsn() const {
+    std::ifstream file(get_file_path(), std::ios::binary);
+    SnapshotHeader header{};
+    if (!file.read(reinterpret_cast<char *>(&header), sizeof(header)) ||
+        std::memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic)) != 0) {
+        return 0;
+    }
+    return header.last_lsn;
+}
+
+
+bool SnapshotFile::is_snapshot(const std::string &path) {
+    std::ifstream file(path, std::ios::binary);
+    char magic[8] = {};
+    if (!file.read(magic, sizeof(magic))) {
+        return false;
+    }
+    return std::memcmp(magic, SNAPSHOT_MAGIC, sizeof(magic)) == 0;
+}
+
+
+bool SnapshotFile::convert_from_csv(const std::string &csv_path, const std::string &snapshot_path) {
+    DataFile csv_file(csv_path);
+    if (!csv_file.open_file_object()) {
+        return false;
+    }
+    const std::uint64_t lsn = csv_file.read_lsn();
+    const std::list<Item> items = csv_file.read();
+    csv_file.close_file_object();
+
+    SnapshotFile snapshot_file(snapshot_path);
+    return snapshot_file.write(items, lsn);
+}
+
+
+bool SnapshotFile::convert_to_csv(const std::string &snapshot_path, const std::string &csv_path) {
+    if (!is_snapshot(snapshot_path)) {
+        return false;
+    }
+
+    const SnapshotFile snapshot_file(snapshot_path);
+    const std::list<Item> items = snapshot_file.read();
+
+    DataFile csv_file(csv_path);
+    const bool result = csv_file.write(items, snapshot_file.read_lsn());
+    csv_file.close_file_object();
+    return result;
+}
+
+
+PagedFile::PagedFile(std::string file_path, const std::uint32_t page_size)
+    : BaseFile(std::move(file_path)), page_size(std::min(std::max(page_size, MIN_PAGE_SIZE), MAX_PAGE_SIZE)) {
+    set_binary_mode(true);
+}
+
+
+bool PagedFile::open_file_object() {
+    // 不为不存在的文件创建空文件
+    std::ifstream journal(journal_path());
+    if (!is_paged(get_file_path()) && !journal.good()) {
+        return false;
+    }
+    journal.close();
+
+    if (!BaseFile::open_file_object()) {
+        return false;
+    }
+
+    recover();
+    if (!load()) {
+        std::cerr << "Invalid paged data file: " << get_file_path() << std::endl;
+        BaseFile::close_file_object();
+        return false;
+    }
+    return true;
+}
+
+
+std::string PagedFile::journal_path() const {
+    return get_file_path() + ".journal";
+}
+
+
+void PagedFile::recover() {
+    std::ifstream journal(journal_path(), std::ios::binary);
+    if (!journal.is_open()) {
+        return;
+    }
+    const std::string content((std::istreambuf_iterator<char>(journal)), std::istreambuf_iterator<char>());
+    journal.close();
+
+    // | 魔数 8 | 页大小 u32 | (页号 u32 | 页内容)... | CRC32 u32 |，校验失败说明原地改写尚未开始
+    const bool complete = content.size() >= 16 && std::memcmp(content.data(), JOURNAL_MAGIC, 8) == 0 &&
+                          get_u32(content.data() + content.size() - 4) ==
+                          crc32(0, content.data() + 8, content.size() - 12);
+    if (complete) {
+        const uint32_t size = get_u32(content.data() + 8);
+        const char *p = content.data() + 12;
+        const char *end = content.data() + content.size() - 4;
+
+        std::fstream &file = get_file_object();
+        file.clear();
+        while (end - p >= static_cast<std::ptrdiff_t>(4 + size)) {
+            file.seekp(static_cast<std::streamoff>(get_u32(p)) * size);
+            file.write(p + 4, size);
+            p += 4 + size;
+        }
+        file.flush();
+        sync_file(get_file_path());
+        reduction();
+    }
+
+    std::remove(journal_path().c_str());
+}
+
+
+bool PagedFile::load() {
+    directory.clear();
+    free_space.clear();
+    free_pages.clear();
+    page_count = 0;
+    last_lsn = 0;
+
+    std::fstream &file = get_file_object();
+    file.clear();
+    file.seekg(0, std::ios::beg);
+    char header[PAGED_HEADER_SIZE];
+    file.read(header, PAGED_HEADER_SIZE);
+    const bool valid = file.gcount() == PAGED_HEADER_SIZE &&
+                       parse_paged_header(header, PAGED_HEADER_SIZE, page_size, page_count, last_lsn);
+    reduction();
+    if (!valid) {
+        page_count = 0;
+        return false;
+    }
+
+    // 只读取页头与记录头，建立编码→页目录与空闲空间表
+    const uint32_t capacity = page_size - PAGE_HEAD_SIZE;
+    free_space.assign(page_count, 0);
+    std::string page;
+    for (uint32_t number = 1; number < page_count; ++number) {
+        if (!read_page(number, page)) {
+            std::cerr << "Corrupted page " << number << " in " << get_file_path() << std::endl;
+            set_free_space(number, capacity);
+            continue;
+        }
+
+        const uint16_t type = get_u16(page.data() + 4);
+        const uint32_t span = get_u32(page.data() + 12);
+        if (type == PAGE_DATA) {
+            const uint16_t count = get_u16(page.data() + 6);
+            const uint32_t used = std::min(get_u32(page.data() + 8), capacity);
+            const char *p = page.data() + PAGE_HEAD_SIZE;
+            const char *end = p + used;
+            for (uint16_t i = 0; i < count && end - p >= static_cast<std::ptrdiff_t>(RECORD_HEAD_SIZE); ++i) {
+                directory[static_cast<int32_t>(get_u32(p + 4))] = number;
+                p += RECORD_HEAD_SIZE + std::min(get_u32(p), static_cast<uint32_t>(end - p - RECORD_HEAD_SIZE));
+            }
+            set_free_space(number, capacity - used);
+        } else if (type == PAGE_EXTENT_HEAD && span >= 1 && span <= page_count - number) {
+            directory[static_cast<int32_t>(get_u32(page.data() + PAGE_HEAD_SIZE + 4))] = number;
+            number += span - 1; // 连续页不接受其他记录
+        } else {
+            set_free_space(number, capacity); // 空闲页，或首页已被释放的后续页
+        }
+    }
+
+    reduction();
+    return true;
+}
+
+
+void PagedFile::set_free_space(const std::uint32_t number, const std::uint32_t bytes) {
+    if (number >= free_space.size()) {
+        free_space.resize(number + 1, 0);
+    }
+
+    free_pages.erase(std::make_pair(free_space[number], number));
+    free_space[number] = bytes;
+    if (bytes > 0) {
+        free_pages.insert(std::make_pair(bytes, number));
+    }
+}
+
+
+bool PagedFile::read_page(const std::uint32_t number, std::string &page) {
+    std::fstream &file = get_file_object();
+    file.clear();
+    page.resize(page_size);
+    file.seekg(static_cast<std::streamoff>(number) * page_size, std::ios::beg);
+    file.read(&page[0], page_size);
+    return file.gcount() == static_cast<std::streamsize>(page_size) && page_valid(page.data(), page_size);
+}
+
+
+bool PagedFile::write_pages(const std::map<std::uint32_t, std::string> &pages) {
+    // 重做日志落盘后才原地改写，改写中途崩溃时可整体重做
+    std::string journal(JOURNAL_MAGIC, 8);
+    put_u32(journal, page_size);
+    for (const auto &page: pages) {
+        put_u32(journal, page.first);
+        journal += page.second;
+    }
+    put_u32(journal, crc32(0, journal.data() + 8, journal.size() - 8));
+
+    std::ofstream out(journal_path(), std::ios::out | std::ios::trunc | std::ios::binary);
+    out.write(journal.data(), static_cast<std::streamsize>(journal.size()));
+    out.flush();
+    const bool journaled = out.good();
+    out.close();
+    if (!journaled || !sync_file(journal_path()) || !sync_directory(journal_path())) {
+        std::cerr << "Write journal failed: " << journal_path() << std::endl;
+        std::remove(journal_path().c_str());
+        return false;
+    }
+
+    std::fstream &file = get_file_object();
+    file.clear();
+    for (const auto &page: pages) {
+        file.seekp(static_cast<std::streamoff>(page.first) * page_size, std::ios::beg);
+        file.write(page.second.data(), static_cast<std::streamsize>(page.second.size()));
+    }
+    file.flush();
+    if (file.fail() || !sync_file(get_file_path())) {
+        std::cerr << "Write pages failed: " << get_file_path() << std::endl; // 保留重做日志，下次打开时重做
+        return false;
+    }
+
+    std::remove(journal_path().c_str());
+    reduction();
+    return true;
+}
+
+
+std::string PagedFile::encode_header() const {
+    std::string header(PAGED_MAGIC, 8);
+    put_u32(header, PAGED_VERSION);
+    put_u32(header, page_size);
+    put_u32(header, page_count);
+    put_u32(header, 0);
+    put_u64(header, last_lsn);
+    put_u32(header, crc32(0, header.data(), header.size()));
+    header.resize(page_size, '\0');
+    return header;
+}
+
+
+bool PagedFile::write(const ItemSource &source, const std::uint64_t lsn) {
+    std::remove(journal_path().c_str()); // 旧文件的重做日志对新内容无效
+
+    const uint32_t capacity = page_size - PAGE_HEAD_SIZE;
+    const uint32_t fill = capacity * PAGE_FILL_PERCENT / 100;
+    uint32_t count = 1;
+
+    const bool result = replace_file_content([&](std::ostream &out) {
+        out.write(std::string(page_size, '\0').data(), page_size); // 文件头占位，页数确定后回填
+
+        std::string block;
+        std::map<int, std::string> records;
+        uint32_t used = 0;
+        auto finish_page = [&]() {
+            if (records.empty()) {
+                return;
+            }
+            block += encode_data_page(records, page_size);
+            records.clear();
+            used = 0;
+            ++count;
+
+            if (block.size() >= WRITE_BUFFER_BYTES) {
+                out.write(block.data(), static_cast<std::streamsize>(block.size()));
+                block.clear();
+            }
+        };
+
+        source([&](const Item &item) {
+            std::string payload;
+            append_item_payload(payload, item);
+            const auto need = static_cast<uint32_t>(RECORD_HEAD_SIZE + payload.size());
+            if (need > capacity) {
+                count += append_extent_pages(block, item.code, payload, page_size);
+                return;
+            }
+
+            if (used + need > fill) {
+                finish_page();
+            }
+            used += need;
+            records[item.code] = std::move(payload);
+        });
+        finish_page();
+        out.write(block.data(), static_cast<std::streamsize>(block.size()));
+
+        page_count = count;
+        last_lsn = lsn;
+        const std::string header = encode_header();
+        out.seekp(0, std::ios::beg);
+        out.write(header.data(), static_cast<std::streamsize>(header.size()));
+        return true;
+    });
+
+    written_pages = result ? count : 0;
+    return open_file_object() && result;
+}
+
+
+bool PagedFile::apply(const std::map<int, const Item *> &changes, const std::uint64_t lsn) {
+    written_pages = 0;
+    if (page_count == 0 || !get_file_object().is_open()) {
+        return false;
+    }
+    if (changes.empty() && lsn == last_lsn) {
+        return true;
+    }
+
+    const uint32_t capacity = page_size - PAGE_HEAD_SIZE;
+    std::map<std::uint32_t, std::map<int, std::string>> dirty; // 需要改写的普通页及其全部记录
+    std::string page;
+    auto load_dirty = [&](const std::uint32_t number) -> std::map<int, std::string> & {
+        auto found = dirty.find(number);
+        if (found == dirty.end()) {
+            found = dirty.emplace(number, std::map<int, std::string>()).first;
+            if (read_page(number, page)) {
+                decode_data_page(page.data(), page_size, found->second);
+            }
+        }
+        return found->second;
+    };
+
+    // 先移除全部旧记录，腾出的空间可供同一批新记录使用
+    std::vector<std::pair<int, std::uint32_t>> placing; // (商品编码, 原所在页)
+    for (const auto &change: changes) {
+        std::uint32_t home = 0;
+        const auto found = directory.find(change.first);
+        if (found != directory.end()) {
+            const std::uint32_t number = found->second;
+            if (dirty.count(number) == 0 && read_page(number, page) && get_u16(page.data() + 4) == PAGE_EXTENT_HEAD) {
+                // 连续页整体释放，改写为空闲页
+                const uint32_t span = get_u32(page.data() + 12);
+                for (uint32_t i = 0; i < span; ++i) {
+                    dirty[number + i].clear();
+                    set_free_space(number + i, capacity);
+                }
+            } else {
+                std::map<int, std::string> &records = load_dirty(number);
+                const auto record = records.find(change.first);
+                if (record != records.end()) {
+                    set_free_space(number, free_space[number] + RECORD_HEAD_SIZE +
+                                           static_cast<uint32_t>(record->second.size()));
+                    records.erase(record);
+                }
+                home = number;
+            }
+            directory.erase(found);
+        }
+
+        if (change.second != nullptr) {
+            placing.emplace_back(change.first, home);
+        }
+    }
+
+    // 放置新记录：优先原页，其次上一条记录所在页，再按剩余空间找最合适的页，都放不下时追加新页
+    std::map<std::uint32_t, std::string> pages;
+    std::uint32_t previous = 0;
+    for (const auto &entry: placing) {
+        std::string payload;
+        append_item_payload(payload, *changes.at(entry.first));
+        const auto need = static_cast<uint32_t>(RECORD_HEAD_SIZE + payload.size());
+
+        if (need > capacity) {
+            // 单页放不下，追加一段连续页
+            std::string run;
+            const uint32_t span = append_extent_pages(run, entry.first, payload, page_size);
+            for (uint32_t i = 0; i < span; ++i) {
+                pages[page_count + i] = run.substr(static_cast<size_t>(i) * page_size, page_size);
+            }
+            directory[entry.first] = page_count;
+            page_count += span;
+            continue;
+        }
+
+        std::uint32_t target = 0;
+        if (entry.second != 0 && free_space[entry.second] >= need) {
+            target = entry.second;
+        } else if (previous != 0 && free_space[previous] >= need) {
+            target = previous;
+        } else {
+            const auto fit = free_pages.lower_bound(std::make_pair(need, 0u));
+            if (fit != free_pages.end()) {
+                target = fit->second;
+            } else {
+                target = page_count++;
+                dirty[target].clear();
+                set_free_space(target, capacity);
+            }
+        }
+
+        load_dirty(target)[entry.first] = std::move(payload);
+        set_free_space(target, free_space[target] - need);
+        directory[entry.first] = target;
+        previous = target;
+    }
+    if (free_space.size() < page_count) {
+        free_space.resize(page_count, 0); // 连续页不接受其他记录
+    }
+
+    for (const auto &entry: dirty) {
+        pages[entry.first] = encode_data_page(entry.second, page_size);
+    }
+    last_lsn = lsn;
+    pages[0] = encode_header();
+
+    if (!write_pages(pages)) {
+        // 内存中的页目录已与磁盘不一致，重新打开（必要时按重做日志补写）
+        BaseFile::close_file_object();
+        open_file_object();
+        return false;
+    }
+
+    written_pages = static_cast<std::uint32_t>(pages.size());
+    return true;
+}
+
+
+bool PagedFile::contains(const int code) const {
+    return directory.count(code) != 0;
+}
+
+
+std::uint64_t PagedFile::get_last_lsn() const {
+    return last_lsn;
+}
+
+
+std::uint32_t PagedFile::get_page_count() const {
+    return page_count;
+}
+
+
+std::uint32_t PagedFile::get_written_pages() const {
+    return written_pages;
+}
+
+
+bool PagedFile::scan(const MappedFile &image, const ItemVisitor &visit) {
+    uint32_t page_size = 0;
+    uint32_t page_count = 0;
+    uint64_t lsn = 0;
+    if (image.data() == nullptr ||
+        !parse_paged_header(image.data(), image.size(), page_size, page_count, lsn) ||
+        static_cast<uint64_t>(page_count) * page_size > image.size()) {
+        std::cerr << "Invalid paged data file" << std::endl;
+        return false;
+    }
+
+    // 记录位置：(商品编码, 负载偏移, 负载长度, 所在页)，连续页的负载需要跨页拼接
+    struct Location {
+        int code;
+        uint64_t offset;
+        uint32_t length;
+        uint32_t extent;
+    };
+    std::vector<Location> locations;
+
+    const char *base = image.data();
+    const uint32_t capacity = page_size - PAGE_HEAD_SIZE;
+    for (uint32_t number = 1; number < page_count; ++number) {
+        const char *page = base + static_cast<uint64_t>(number) * page_size;
+        if (!page_valid(page, page_size)) {
+            continue;
+        }
+
+        const uint16_t type = get_u16(page + 4);
+        const uint32_t span = get_u32(page + 12);
+        if (type == PAGE_DATA) {
+            const uint16_t count = get_u16(page + 6);
+            const char *p = page + PAGE_HEAD_SIZE;
+            const char *end = p + std::min(get_u32(page + 8), capacity);
+            for (uint16_t i = 0; i < count && end - p >= static_cast<std::ptrdiff_t>(RECORD_HEAD_SIZE); ++i) {
+                const uint32_t length = std::min(get_u32(p), static_cast<uint32_t>(end - p - RECORD_HEAD_SIZE));
+                locations.push_back(Location{static_cast<int32_t>(get_u32(p + 4)),
+                                             static_cast<uint64_t>(p + RECORD_HEAD_SIZE - base), length, 0});
+                p += RECORD_HEAD_SIZE + length;
+            }
+        } else if (type == PAGE_EXTENT_HEAD && span >= 1 && span <= page_count - number) {
+            const char *body = page + PAGE_HEAD_SIZE;
+            locations.push_back(Location{static_cast<int32_t>(get_u32(body + 4)), 0, get_u32(body), number});
+            number += span - 1;
+        }
+    }
+
+    std::sort(locations.begin(), locations.end(),
+              [](const Location &lhs, const Location &rhs) { return lhs.code < rhs.code; });
+
+    std::string joined;
+    for (const auto &location: locations) {
+        if (location.extent == 0) {
+            visit(parse_item_payload(base + location.offset, location.length));
+            continue;
+        }
+
+        // 拼接连续页的页体，去掉记录头
+        joined.clear();
+        const uint64_t total = RECORD_HEAD_SIZE + static_cast<uint64_t>(location.length);
+        for (uint32_t number = location.extent; joined.size() < total && number < page_count; ++number) {
+            const char *page = base + static_cast<uint64_t>(number) * page_size;
+            joined.append(page + PAGE_HEAD_SIZE, std::min<uint64_t>(capacity, total - joined.size()));
+        }
+        if (joined.size() == total) {
+            visit(parse_item_payload(joined.data() + RECORD_HEAD_SIZE, location.length));
+        }
+    }
+    return true;
+}
+
+
+std::uint64_t PagedFile::read_lsn(const MappedFile &image) {
+    uint32_t page_size = 0;
+    uint32_t page_count = 0;
+    uint64_t lsn = 0;
+    if (image.data() == nullptr || !parse_paged_header(image.data(), image.size(), page_size, page_count, lsn)) {
+        return 0;
+    }
+    return lsn;
+}
+
+
+bool PagedFile::is_paged(const std::string &path) {
+    std::ifstream file(path, std::ios::binary);
+    char magic[8] = {};
+    file.read(magic, sizeof(magic));
+    return file.gcount() == sizeof(magic) && std::memcmp(magic, PAGED_MAGIC, sizeof(magic)) == 0;
+}
+
+
+std::list<Item> ReadDataFile::read(const unsigned int workers) {
+    std::list<Item> items;
+    scan([&items](const Item &item) { items.push_back(item); }, workers);
+    return items;
+}
+
+
+void ReadDataFile::parse_range(const char *begin, const char *end, ParsedRange &range) {
+    range.text.clear();
+    range.items.clear();
+    range.brands.clear();
+    const auto append_text = [&range](const std::string &value) {
+        const ParsedText text{range.text.size(), value.size()};
+        range.text.append(value);
+        return text;
+    };
+
+    // 字段先解析进复用的对象，再拼接到区段文本缓冲
+    Item item;
+    Brand brand;
+    while (begin < end) {
+        const char *line_end = static_cast<const char *>(std::memchr(begin, '\n', static_cast<size_t>(end - begin)));
+        if (line_end == nullptr) {
+            line_end = end;
+        }
+
+        const size_t length = static_cast<size_t>(line_end - begin);
+        if (length >= 5 && std::memcmp(begin, "ITEM|", 5) == 0) {
+            parse_item_line(begin, length, item);
+            range.items.push_back(ParsedItem{append_text(item.name), append_text(item.colour), item.code,
+                                             item.quantity, range.brands.size(), 0});
+        } else if (length >= 6 && std::memcmp(begin, "BRAND|", 6) == 0 && !range.items.empty()) {
+            parse_brand_line(begin, length, brand);
+            range.brands.push_back(ParsedBrand{append_text(brand.name), brand.code, brand.quantity, brand.price});
+            ++range.items.back().brand_count;
+        }
+        begin = line_end + 1;
+    }
+}
+
+
+void ReadDataFile::parse_window(const char *data, const size_t size, const unsigned int workers,
+                                std::vector<ParsedRange> &parts, Item &item, const ItemVisitor &visit) {
+    // 按字节均分后将每个边界推进到下一个ITEM|行首，保证商品及其品牌落在同一区段
+    std::vector<size_t> bounds{0};
+    for (unsigned int i = 1; i < workers; ++i) {
+        const size_t target = std::max(bounds.back(), size / workers * i);
+        if (target == 0) {
+            continue;
+        }
+
+        const char *found = std::search(data + target - 1, data + size, "\nITEM|", "\nITEM|" + 6);
+        const size_t bound = found == data + size ? size : static_cast<size_t>(found - data) + 1;
+        if (bound > bounds.back() && bound < size) {
+            bounds.push_back(bound);
+        }
+    }
+    bounds.push_back(size);
+
+    const size_t ranges = bounds.size() - 1;
+    std::vector<std::thread> threads;
+    threads.reserve(ranges - 1);
+    for (size_t i = 1; i < ranges; ++i) {
+        threads.emplace_back(&ReadDataFile::parse_range, data + bounds[i], data + bounds[i + 1], std::ref(parts[i]));
+    }
+    parse_range(data, data + bounds[1], parts[0]); // 当前线程解析第一段
+    for (auto &thread: threads) {
+        thread.join();
+    }
+
+    // 区段按文件顺序排列，依次还原到同一个对象并访问即保持原有顺序
+    for (size_t i = 0; i < ranges; ++i) {
+        const ParsedRange &range = parts[i];
+        const char *text = range.text.data();
+        for (const ParsedItem &parsed: range.items) {
+            item.name.assign(text + parsed.name.offset, parsed.name.length);
+            item.code = parsed.code;
+            item.colour.assign(text + parsed.colour.offset, parsed.colour.length);
+            item.quantity = parsed.quantity;
+            item.brand_list.clear();
+            for (size_t j = parsed.brand_begin; j < parsed.brand_begin + parsed.brand_count; ++j) {
+                const ParsedBrand &source = range.brands[j];
+                Brand &brand = item.brand_list.append();
+                brand.name.assign(text + source.name.offset, source.name.length);
+                brand.code = source.code;
+                brand.quantity = source.quantity;
+                brand.price = source.price;
+            }
+            visit(item);
+        }
+    }
+}
+
+
+bool ReadDataFile::scan(const ItemVisitor &visit, unsigned int workers) {
+    std::fstream &file = get_file_object();
+    if (!file.is_open()) {
+        return false;
+    }
+    reduction();
+
+    const bool automatic = workers == 0;
+    if (automatic) {
+        workers = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    // 每个窗口读入 workers 个区段的数据，内存占用只与线程数有关，与文件大小无关
+    const size_t window = static_cast<size_t>(workers) * PARALLEL_LOAD_CHUNK_BYTES;
+    std::vector<ParsedRange> parts(workers);
+    Item item;
+    std::string buffer;
+    bool at_end = false;
+    while (!at_end) {
+        const size_t carried = buffer.size();
+        buffer.resize(carried + window);
+        file.read(&buffer[carried], static_cast<std::streamsize>(window));
+        buffer.resize(carried + static_cast<size_t>(file.gcount()));
+        at_end = !file;
+
+        // 最后一个商品的品牌行可能落在下一窗口，留到下一轮与新数据一起解析
+        size_t complete = buffer.size();
+        if (!at_end) {
+            const size_t found = buffer.rfind("\nITEM|");
+            if (found == std::string::npos) {
+                continue;
+            }
+            complete = found + 1;
+        }
+
+        if (complete > 0) {
+            const unsigned int ranges = automatic
+                ? static_cast<unsigned int>(std::min<size_t>(workers, complete / PARALLEL_LOAD_CHUNK_BYTES + 1))
+                : workers;
+            parse_window(buffer.data(), complete, ranges, parts, item, visit);
+            buffer.erase(0, complete);
+        }
+    }
+
+    reduction();
+    return true;
+}
+
+
+std::uint64_t ReadDataFile::read_lsn() {
+    std::fstream &file = get_file_object();
+    if (!file.is_open()) {
+        return 0;
+    }
+
+    std::string line;
+    std::uint64_t lsn = 0;
+    if (std::getline(file, line) && line.find("LSN|") == 0) {
+        lsn = std::stoull(line.substr(4));
+    }
+
+    reduction();
+    return lsn;
+}
+
+
+OperationFile::OperationFile(std::string file_path, const LogFormat format)
+    : BaseFile(std::move(file_path)), format(format), preferred_format(format) {
+    set_binary_mode(true); // 偏移量按字节计算，避免换行符转换
+}
+
+
+OperationFile::~OperationFile() {
+    commit();
+    release_sync_descriptor();
+}
+
+
+bool OperationFile::open_file_object() {
+    if (!BaseFile::open_file_object()) {
+        return false;
+    }
+
+    rebuild_index(); // 打开时扫描一次，之后增量维护
+    load_segments();
+    return true;
+}
+
+
+bool OperationFile::close_file_object() {
+    commit();
+    release_sync_descriptor(); // 文件可能随后被重命名或替换，下次同步时重新打开
+    return BaseFile::close_file_object();
+}
+
+
+bool OperationFile::sync() {
+    if (sync_fd < 0) {
+        sync_fd = open_sync_descriptor(get_file_path());
+    }
+    return sync_fd >= 0 && sync_descriptor(sync_fd);
+}
+
+
+void OperationFile::release_sync_descriptor() {
+    if (sync_fd >= 0) {
+        close_descriptor(sync_fd);
+        sync_fd = -1;
+    }
+}
+
+
+void OperationFile::set_durability(const Durability mode, const int records, const int interval_us) {
+    commit(); // 切换级别前先提交已缓冲的记录
+    durability = mode;
+    group_records = records > 0 ? records : 1;
+    group_interval = std::chrono::microseconds(interval_us > 0 ? interval_us : 0);
+}
+
+
+bool OperationFile::write_bytes(const std::string &bytes, const int records) {
+    std::fstream &file = get_file_object();
+    if (!file.is_open()) {
+        return false;
+    }
+
+    if (durability == Durability::GROUP) {
+        const auto now = std::chrono::steady_clock::now();
+        if (pending.empty()) {
+            pending_since = now;
+        }
+
+        pending += bytes;
+        pending_records += records;
+        tail_offset += static_cast<std::streamoff>(bytes.size());
+
+        // 攒满一组或等待超时后合并为一次写入
+        if (pending_records >= group_records || now - pending_since >= group_interval) {
+            return commit();
+        }
+        return true;
+    }
+
+    file.seekp(tail_offset, std::ios::beg);
+    if (file.fail()) {
+        std::cerr << "Seek operation failed" << std::endl;
+        reduction();
+        return false;
+    }
+
+    file.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+    file.flush();
+    if (file.fail()) {
+        std::cerr << "Write operation failed" << std::endl;
+        reduction();
+        return false;
+    }
+    reduction();
+
+    // 确认落盘后才推进尾部偏移；同步失败时截掉这段字节，调用方不会记下未确认持久的记录
+    if (durability == Durability::SYNC && !sync()) {
+        std::cerr << "Sync operation failed" << std::endl;
+        truncate_to(tail_offset);
+        return false;
+    }
+    tail_offset += static_cast<std::streamoff>(bytes.size());
+    return true;
+}
+
+
+bool OperationFile::commit() {
+    if (pending.empty()) {
+        return true;
+    }
+
+    std::fstream &file = get_file_object();
+    const std::streamoff physical_tail = tail_offset - static_cast<std::streamoff>(pending.size());
+
+    file.seekp(physical_tail, std::ios::beg);
+    file.write(pending.data(), static_cast<std::streamsize>(pending.size()));
+    file.flush();
+    const bool written = !file.fail();
+    reduction();
+
+    pending.clear();
+    pending_records = 0;
+
+    // 写入或同步失败时整组回滚：偏移表与文件长度退回到这一组之前
+    const bool synced = written && sync();
+    if (!synced) {
+        std::cerr << (written ? "Group commit sync failed" : "Group commit failed") << std::endl;
+        while (!record_offsets.empty() && record_offsets.back() >= physical_tail) {
+            record_offsets.pop_back();
+        }
+        if (written) {
+            truncate_to(physical_tail);
+        }
+        tail_offset = physical_tail;
+        return false;
+    }
+    return true;
+}
+
+
+int OperationFile::pending_size() const {
+    return pending_records;
+}
+
+
+std::chrono::steady_clock::time_point OperationFile::commit_deadline() const {
+    return pending_since + group_interval;
+}
+
+
+void OperationFile::rebuild_index() {
+    record_offsets.clear();
+    tail_offset = 0;
+
+    std::fstream &file = get_file_object();
+    if (!file.is_open()) {
+        return;
+    }
+
+    // 根据文件头识别格式，空文件采用构造时指定的格式
+    file.seekg(0, std::ios::end);
+    const std::streamoff file_length = file.tellg();
+    reduction();
+
+    char header[WAL_HEADER_SIZE] = {};
+    if (file_length >= WAL_HEADER_SIZE) {
+        file.read(header, WAL_HEADER_SIZE);
+        reduction();
+    }
+
+    if (file_length == 0) {
+        reset();
+    } else if (std::memcmp(header, WAL_MAGIC, WAL_HEADER_SIZE) == 0) {
+        format = LogFormat::BINARY;
+        frame_head_size = FRAME_HEAD_SIZE;
+        rebuild_binary_index();
+    } else if (std::memcmp(header, WAL_MAGIC_V1, WAL_HEADER_SIZE) == 0) {
+        format = LogFormat::BINARY;
+        frame_head_size = FRAME_HEAD_SIZE_V1;
+        rebuild_binary_index();
+    } else {
+        format = LogFormat::TEXT;
+        rebuild_text_index();
+    }
+}
+
+
+void OperationFile::rebuild_text_index() {
+    std::fstream &file = get_file_object();
+
+    std::string line;
+    std::streamoff offset = 0;
+    while (std::getline(file, line)) {
+        if (!line.empty() && line[0] == '[') {
+            record_offsets.push_back(offset);
+            last_lsn = std::max(last_lsn, marker_lsn(line));
+        }
+        offset += static_cast<std::streamoff>(line.size()) + 1;
+    }
+
+    // 以实际文件长度为准（最后一行可能没有换行符）
+    file.clear();
+    file.seekg(0, std::ios::end);
+    tail_offset = file.tellg();
+
+    reduction();
+}
+
+
+void OperationFile::rebuild_binary_index() {
+    std::fstream &file = get_file_object();
+
+    file.seekg(0, std::ios::end);
+    const std::streamoff file_length = file.tellg();
+
+    // 只读取每帧的长度前缀，整条跳过负载
+    const std::streamoff overhead = frame_head_size + 4; // 帧头与CRC的总字节数
+    std::streamoff offset = WAL_HEADER_SIZE;
+    char length_buffer[4];
+    while (file_length - offset >= overhead) {
+        file.seekg(offset, std::ios::beg);
+        file.read(length_buffer, 4);
+        const std::streamoff next = offset + overhead + get_u32(length_buffer);
+        if (next > file_length) {
+            break; // 长度越界，说明尾部记录写入不完整
+        }
+
+        record_offsets.push_back(offset);
+        offset = next;
+    }
+    reduction();
+    tail_offset = offset;
+
+    // 撕裂写入只可能出现在最后一帧，校验其CRC即可
+    Operation last{};
+    if (!record_offsets.empty() && !read_frame(record_offsets.back(), last)) {
+        tail_offset = record_offsets.back();
+        record_offsets.pop_back();
+
+        if (!record_offsets.empty()) {
+            read_frame(record_offsets.back(), last);
+        }
+    }
+    last_lsn = std::max(last_lsn, last.lsn); // 序列号单调递增，最后一帧即为最大值
+
+    if (tail_offset < file_length) {
+        // 其后仍有完整的记录时损坏位于日志中部，截断会丢弃这些记录，保持文件原样并拒绝打开
+        Operation next{};
+        if (find_valid_frame(tail_offset + 1, file_length, next) >= 0) {
+            const std::string message = log_gap_message(get_file_path(), tail_offset, last.lsn, next.lsn);
+            BaseFile::close_file_object();
+            throw std::runtime_error(message);
+        }
+
+        std::cerr << "Truncating incomplete log record at offset " << tail_offset << std::endl;
+        truncate_to(tail_offset);
+    }
+}
+
+
+std::streamoff OperationFile::find_valid_frame(const std::streamoff from, const std::streamoff end,
+                                               Operation &operation) {
+    if (end <= from) {
+        return -1;
+    }
+
+    std::fstream &file = get_file_object();
+    std::string bytes(static_cast<size_t>(end - from), '\0');
+    file.clear();
+    file.seekg(from, std::ios::beg);
+    file.read(&bytes[0], end - from);
+    reduction();
+
+    // 逐字节尝试帧头：类型合法、长度不越界且CRC一致才算完整的记录
+    const size_t overhead = static_cast<size_t>(frame_head_size) + 4;
+    for (size_t p = 0; p + overhead <= bytes.size(); ++p) {
+        const char *head = bytes.data() + p;
+        const uint32_t length = get_u32(head);
+        const auto type = static_cast<unsigned char>(head[4]);
+        if (type < static_cast<unsigned char>(OperationType::INSERT_ITEM) ||
+            type > static_cast<unsigned char>(OperationType::DELETE_ITEM) || length > bytes.size() - p - overhead) {
+            continue;
+        }
+
+        const char *crc_field = head + frame_head_size + length;
+        if (crc32(0, head + 4, static_cast<size_t>(frame_head_size - 4) + length) != get_u32(crc_field)) {
+            continue;
+        }
+
+        operation.type = static_cast<OperationType>(type);
+        operation.code = static_cast<int>(get_u32(head + 5));
+        operation.payload.assign(head + frame_head_size, length);
+        operation.lsn = frame_head_size == FRAME_HEAD_SIZE ? get_u64(head + 9) : 0;
+        return from + static_cast<std::streamoff>(p);
+    }
+    return -1;
+}
+
+
+bool OperationFile::read_frame(const std::streamoff offset, Operation &operation) {
+    std::fstream &file = get_file_object();
+
+    char head[FRAME_HEAD_SIZE];
+    file.seekg(offset, std::ios::beg);
+    if (!file.read(head, frame_head_size)) {
+        reduction();
+        return false;
+    }
+
+    const uint32_t length = get_u32(head);
+    operation.payload.resize(length);
+    char crc_buffer[4];
+    if (!file.read(&operation.payload[0], length) || !file.read(crc_buffer, 4)) {
+        reduction();
+        return false;
+    }
+    reduction();
+
+    uint32_t crc = crc32(0, head + 4, static_cast<size_t>(frame_head_size - 4));
+    crc = crc32(crc, operation.payload.data(), operation.payload.size());
+    if (crc != get_u32(crc_buffer)) {
+        return false;
+    }
+
+    operation.type = static_cast<OperationType>(head[4]);
+    operation.code = static_cast<int>(get_u32(head + 5));
+    operation.lsn = frame_head_size == FRAME_HEAD_SIZE ? get_u64(head + 9) : 0;
+    return true;
+}
+
+
+void OperationFile::truncate_to(const std::streamoff length) {
+    std::fstream &file = get_file_object();
+    file.flush();
+
+    if (!truncate_file(get_file_path(), length)) {
+        std::cerr << "Truncate operation failed: " << errno << std::endl;
+    }
+
+    tail_offset = length;
+    reduction();
+}
+
+
+std::string OperationFile::to_text(const Operation &operation, const std::uint64_t lsn) {
+    const std::string suffix = lsn != 0 ? "@" + std::to_string(lsn) : std::string();
+
+    switch (operation.type) {
+        case OperationType::INSERT_ITEM:
+            return "[insert]" + suffix + "\n" + operation.payload + "\n";
+        case OperationType::UPDATE_ITEM:
+            return "[update]" + suffix + "\n" + operation.payload + "\n";
+        case OperationType::DELETE_ITEM:
+            return "[delete]" + std::to_string(operation.code) + suffix + "\n";
+    }
+    return "";
+}
+
+
+std::string OperationFile::to_frame(const Operation &operation, const std::uint64_t lsn) const {
+    std::string frame;
+    frame.reserve(static_cast<size_t>(frame_head_size) + 4 + operation.payload.size());
+
+    put_u32(frame, static_cast<uint32_t>(operation.payload.size()));
+    frame.push_back(static_cast<char>(operation.type));
+    put_u32(frame, static_cast<uint32_t>(operation.code));
+    if (frame_head_size == FRAME_HEAD_SIZE) {
+        put_u64(frame, lsn);
+    }
+    frame += operation.payload;
+    put_u32(frame, crc32(0, frame.data() + 4, frame.size() - 4)); // 校验范围不含长度前缀
+
+    return frame;
+}
+
+
+bool OperationFile::append(const std::string &line) {
+    std::fstream &file = get_file_object();
+    if (!file.is_open() || format != LogFormat::TEXT) {
+        return false;
+    }
+
+    // 记录本次写入中每条操作记录的起始偏移
+    const size_t record_count = record_offsets.size();
+    std::streamoff offset = tail_offset;
+    size_t start = 0;
+    while (start <= line.size()) {
+        if (start < line.size() && line[start] == '[') {
+            record_offsets.push_back(offset);
+        }
+
+        size_t end = line.find('\n', start);
+        if (end == std::string::npos) {
+            end = line.size();
+        }
+        offset += static_cast<std::streamoff>(end - start) + 1;
+        start = end + 1;
+    }
+
+    if (!write_bytes(line + '\n', static_cast<int>(record_offsets.size() - record_count))) {
+        record_offsets.resize(record_count);
+        return false;
+    }
+    return true;
+}
+
+
+bool OperationFile::append(const Operation &operation) {
+    const std::uint64_t lsn = operation.lsn != 0 ? operation.lsn : last_lsn + 1;
+
+    if (format == LogFormat::TEXT) {
+        if (!append(to_text(operation, lsn))) {
+            return false;
+        }
+        last_lsn = std::max(last_lsn, lsn);
+        return true;
+    }
+
+    if (!get_file_object().is_open()) {
+        return false;
+    }
+
+    const std::streamoff offset = tail_offset;
+    if (!write_bytes(to_frame(operation, lsn), 1)) {
+        return false;
+    }
+
+    record_offsets.push_back(offset);
+    last_lsn = std::max(last_lsn, lsn);
+    return true;
+}
+
+
+std::uint64_t OperationFile::get_last_lsn() const {
+    return last_lsn;
+}
+
+
+void OperationFile::advance_lsn(const std::uint64_t lsn) {
+    last_lsn = std::max(last_lsn, lsn);
+}
+
+
+std::list<Operation> OperationFile::read_operations() {
+    std::list<Operation> operations;
+    std::fstream &file = get_file_object();
+
+    if (!file.is_open()) {
+        return operations;
+    }
+
+    commit();
+
+    if (format == LogFormat::BINARY) {
+        for (auto offset = record_offsets.begin(); offset != record_offsets.end(); ++offset) {
+            Operation operation;
+            if (read_frame(*offset, operation)) {
+                operations.push_back(std::move(operation));
+                continue;
+            }
+
+            // 打开时已校验最后一帧，这里的损坏位于日志中部：丢弃其后的记录会静默丢失修改，调用方不得据此清空日志
+            Operation next{};
+            auto following = std::next(offset);
+            while (following != record_offsets.end() && !read_frame(*following, next)) {
+                ++following;
+            }
+            throw std::runtime_error(log_gap_message(get_file_path(), *offset,
+                                                     operations.empty() ? 0 : operations.back().lsn,
+                                                     following != record_offsets.end() ? next.lsn : 0));
+        }
+        return operations;
+    }
+
+    Operation *current = nullptr; // 当前正在收集负载的插入/更新记录
+    std::string line;
+    while (std::getline(file, line)) {
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+
+        if (line.empty()) {
+            continue;
+        }
+
+        // 处理操作类型标记（"@"之后为日志序列号）
+        if (line.find("[insert]") == 0 || line.find("[update]") == 0) {
+            const OperationType type = line[1] == 'i' ? OperationType::INSERT_ITEM : OperationType::UPDATE_ITEM;
+            operations.push_back(Operation{type, 0, std::string(), marker_lsn(line)});
+            current = &operations.back();
+            continue;
+        }
+
+        if (line.find("[delete]") == 0) {
+            operations.push_back(Operation{OperationType::DELETE_ITEM, std::stoi(line.substr(8)), std::string(),
+                                           marker_lsn(line)});
+            current = nullptr;
+            continue;
+        }
+
+        if (current == nullptr) {
+            continue;
+        }
+
+        // 收集条目数据行
+        if (line.find("ITEM|") == 0) {
+            current->code = parse_item_line(line).code;
+            current->payload = line;
+        } else if (line.find("BRAND|") == 0) {
+            current->payload += '\n';
+            current->payload += line;
+        }
+    }
+
+    reduction();
+    return operations;
+}
+
+
+std::string OperationFile::pop() {
+    std::fstream &file = get_file_object();
+    if (!file.is_open()) {
+        return "FOE";
+    }
+
+    commit();
+
+    if (format == LogFormat::BINARY) {
+        Operation last;
+        if (record_offsets.empty() || !read_frame(record_offsets.back(), last)) {
+            return "FIE";
+        }
+
+        truncate_to(record_offsets.back());
+        record_offsets.pop_back();
+
+        std::string text = to_text(last, last.lsn);
+        text.pop_back();
+        return text;
+    }
+
+    if (tail_offset == 0) {
+        return "FIE"; // 空文件标识
+    }
+
+    // 从文件末尾向前查找上一个换行符，只读取最后一行
+    file.clear();
+    std::streamoff end = tail_offset;
+    char byte = 0;
+    file.seekg(end - 1, std::ios::beg);
+    if (file.get(byte) && byte == '\n') {
+        --end;
+    }
+
+    std::streamoff start = end;
+    char buffer[256];
+    while (start > 0) {
+        const std::streamoff chunk = std::min<std::streamoff>(start, sizeof(buffer));
+        file.seekg(start - chunk, std::ios::beg);
+        file.read(buffer, chunk);
+
+        const char *found = nullptr;
+        for (std::streamoff i = chunk; i > 0; --i) {
+            if (buffer[i - 1] == '\n') {
+                found = buffer + i;
+                break;
+            }
+        }
+        if (found != nullptr) {
+            start = start - chunk + (found - buffer);
+            break;
+        }
+        start -= chunk;
+    }
+
+    std::string last(static_cast<size_t>(end - start), '\0');
+    file.clear();
+    file.seekg(start, std::ios::beg);
+    file.read(&last[0], end - start);
+    if (!last.empty() && last.back() == '\r') {
+        last.pop_back();
+    }
+
+    truncate_to(start);
+
+    // 被删除的是操作记录行时同步移除其偏移
+    if (!record_offsets.empty() && record_offsets.back() >= start) {
+        record_offsets.pop_back();
+    }
+
+    return last; // 返回被删除的最后一条记录
+}
+
+
+std::list<std::string> OperationFile::clear() {
+    std::list<std::string> lines;
+    std::fstream &file = get_file_object();
+
+    if (!file.is_open()) {
+        lines.emplace_back("FOE");
+        return lines;
+    }
+
+    commit();
+
+    if (format == LogFormat::BINARY) {
+        for (const auto &operation: read_operations()) {
+            std::string text = to_text(operation, operation.lsn);
+            text.pop_back();
+            lines.push_back(std::move(text));
+        }
+    } else {
+        std::string line;
+        while (std::getline(file, line)) {
+            lines.push_back(line);
+        }
+    }
+
+    reset();
+    return lines;
+}
+
+
+void OperationFile::reset() {
+    pending.clear();
+    pending_records = 0;
+
+    clear_file_context();
+    record_offsets.clear();
+    tail_offset = 0;
+    format = preferred_format;
+
+    if (format == LogFormat::BINARY) {
+        std::fstream &file = get_file_object();
+        file.write(WAL_MAGIC, WAL_HEADER_SIZE);
+        frame_head_size = FRAME_HEAD_SIZE;
+        file.flush();
+        tail_offset = WAL_HEADER_SIZE;
+        reduction();
+    }
+}
+
+
+bool OperationFile::rewrite(const std::list<Operation> &operations) {
+    if (!commit()) {
+        return false;
+    }
+
+    const LogFormat target = format;
+    if (target == LogFormat::BINARY) {
+        frame_head_size = FRAME_HEAD_SIZE;
+    }
+
+    const bool result = replace_file_content([this, target, &operations](std::ostream &out) {
+        std::string block;
+        if (target == LogFormat::BINARY) {
+            block.append(WAL_MAGIC, WAL_HEADER_SIZE);
+        }
+
+        for (const auto &operation: operations) {
+            if (target == LogFormat::TEXT) {
+                block += to_text(operation, operation.lsn);
+                block += '\n';
+            } else {
+                block += to_frame(operation, operation.lsn);
+            }
+
+            if (block.size() >= WRITE_BUFFER_BYTES) {
+                out.write(block.data(), static_cast<std::streamsize>(block.size()));
+                block.clear();
+            }
+        }
+        out.write(block.data(), static_cast<std::streamsize>(block.size()));
+        return true;
+    });
+
+    // 无论替换是否成功都重新打开，按磁盘上的内容重建索引
+    open_file_object();
+    return result;
+}
+
+
+bool OperationFile::rotate() {
+    const unsigned long number = sealed_numbers.empty() ? 1 : sealed_numbers.back() + 1;
+    close_file_object(); // 关闭前提交缓冲
+
+    if (std::rename(get_file_path().c_str(), segment_path(number).c_str()) != 0) {
+        std::cerr << "Rotate operation failed: " << errno << std::endl;
+        open_file_object();
+        return false;
+    }
+
+    return open_file_object(); // 新建空日志段并重建索引
+}
+
+
+std::vector<std::string> OperationFile::sealed_segments() const {
+    std::vector<std::string> segments;
+    segments.reserve(sealed_numbers.size());
+
+    for (const auto number: sealed_numbers) {
+        segments.push_back(segment_path(number));
+    }
+    return segments;
+}
+
+
+void OperationFile::remove_sealed(std::size_t count) {
+    count = std::min(count, sealed_numbers.size());
+
+    for (std::size_t i = 0; i < count; ++i) {
+        std::remove(segment_path(sealed_numbers[i]).c_str());
+    }
+    sealed_numbers.erase(sealed_numbers.begin(), sealed_numbers.begin() + static_cast<std::ptrdiff_t>(count));
+}
+
+
+std::string OperationFile::segment_path(const unsigned long number) const {
+    return get_file_path() + '.' + std::to_string(number);
+}
+
+
+void OperationFile::load_segments() {
+    sealed_numbers = list_numbered_files(get_file_path());
+}
+
+
+LogFormat OperationFile::get_format() const {
+    return format;
+}
+
+
+int OperationFile::size() const {
+    return static_cast<int>(record_offsets.size());
+}
+
+
+std::streamoff OperationFile::length() const {
+    return tail_offset;
+}
+
+
+const std::vector<std::streamoff> &OperationFile::offsets() const {
+    return record_offsets;
+}
+
+
+SortedRun::SortedRun(std::string file_path) : BaseFile(std::move(file_path)) {
+    set_binary_mode(true);
+}
+
+
+SortedRun::~SortedRun() {
+    image.unmap();
+    if (obsolete) {
+        std::remove(get_file_path().c_str());
+    }
+}
+
+
+bool SortedRun::write(const EntrySource &source) {
+    image.unmap();
+    count = 0;
+
+    const bool written = replace_file_content([&](std::ostream &file) {
+        std::string buffer(RUN_MAGIC, RUN_HEADER_SIZE);
+        uint32_t crc = 0;
+        uint32_t records = 0;
+        int last_code = 0;
+        bool ordered = true;
+
+        source([&](const int code, const LsmEntryType type, const char *payload, const uint32_t length) {
+            ordered = ordered && (records == 0 || code > last_code);
+            last_code = code;
+            ++records;
+
+            buffer.push_back(static_cast<char>(type));
+            put_u32(buffer, static_cast<uint32_t>(code));
+            put_u32(buffer, length);
+            if (length > 0) {
+                buffer.append(payload, length);
+            }
+
+            if (buffer.size() >= WRITE_BUFFER_BYTES) {
+                crc = crc32(crc, buffer.data(), buffer.size());
+                file.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+                buffer.clear();
+            }
+        });
+
+        put_u32(buffer, records);
+        crc = crc32(crc, buffer.data(), buffer.size());
+        put_u32(buffer, crc);
+        file.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+        return ordered; // 归并依赖严格升序，乱序的来源不写出
+    });
+
+    return written && load();
+}
+
+
+bool SortedRun::load() {
+    image.unmap();
+    count = 0;
+
+    if (!image.map(get_file_path())) {
+        return false;
+    }
+
+    const char *data = image.data();
+    const size_t size = image.size();
+    if (size < RUN_HEADER_SIZE + RUN_TRAILER_SIZE || std::memcmp(data, RUN_MAGIC, RUN_HEADER_SIZE) != 0 ||
+        crc32(0, data, size - 4) != get_u32(data + size - 4)) {
+        image.unmap();
+        return false;
+    }
+
+    count = get_u32(data + size - RUN_TRAILER_SIZE);
+    return true;
+}
+
+
+bool SortedRun::next(RunCursor &cursor) const {
+    if (image.data() == nullptr) {
+        return false;
+    }
+
+    const char *data = image.data();
+    const size_t end = image.size() - RUN_TRAILER_SIZE;
+    const size_t offset = cursor.offset == 0 ? RUN_HEADER_SIZE : cursor.offset;
+    if (offset + RUN_RECORD_HEAD_SIZE > end) {
+        return false;
+    }
+
+    const uint32_t length = get_u32(data + offset + 5);
+    if (length > end - offset - RUN_RECORD_HEAD_SIZE) {
+        return false;
+    }
+
+    cursor.type = static_cast<LsmEntryType>(data[offset]);
+    cursor.code = static_cast<int32_t>(get_u32(data + offset + 1));
+    cursor.payload = data + offset + RUN_RECORD_HEAD_SIZE;
+    cursor.length = length;
+    cursor.offset = offset + RUN_RECORD_HEAD_SIZE + length;
+    return true;
+}
+
+
+void SortedRun::mark_obsolete() {
+    obsolete = true;
+}
+
+
+std::uint32_t SortedRun::size() const {
+    return count;
+}
+
+
+LsmStore::LsmStore(std::string file_path, const unsigned fanout)
+    : BaseFile(std::move(file_path)), fanout(std::max(fanout, 2u)) {
+}
+
+
+std::string LsmStore::run_path(const unsigned long number) const {
+    return get_file_path() + ".run." + std::to_string(number);
+}
+
+
+bool LsmStore::write_manifest() {
+    return replace_file_content([this](std::ostream &file) {
+        file << MANIFEST_MAGIC << '\n';
+        file << "LSN|" << last_lsn << '\n';
+        file << "NEXT|" << next_number << '\n';
+        for (const auto &slot: runs) {
+            file << "RUN|" << slot.number << '|' << slot.level << '\n';
+        }
+        return true;
+    });
+}
+
+
+bool LsmStore::find_compaction(size_t &first, size_t &last) const {
+    // 段列表由新到旧排列，层号随之不减，同一层的段相邻
+    for (size_t begin = 0; begin < runs.size();) {
+        size_t end = begin + 1;
+        while (end < runs.size() && runs[end].level == runs[begin].level) {
+            ++end;
+        }
+
+        if (end - begin >= fanout) {
+            first = begin;
+            last = end;
+            return true;
+        }
+        begin = end;
+    }
+    return false;
+}
+
+
+bool LsmStore::open_file_object() {
+    std::ifstream manifest(get_file_path());
+    std::string line;
+    if (!std::getline(manifest, line) || line != MANIFEST_MAGIC) {
+        return false;
+    }
+
+    std::uint64_t lsn = 0;
+    unsigned long next = 1;
+    std::vector<RunSlot> loaded;
+    while (std::getline(manifest, line)) {
+        if (line.compare(0, 4, "LSN|") == 0) {
+            lsn = std::stoull(line.substr(4));
+        } else if (line.compare(0, 5, "NEXT|") == 0) {
+            next = std::stoul(line.substr(5));
+        } else if (line.compare(0, 4, "RUN|") == 0) {
+            const size_t separator = line.find('|', 4);
+            if (separator == std::string::npos) {
+                return false;
+            }
+
+            const unsigned long number = std::stoul(line.substr(4, separator - 4));
+            const auto level = static_cast<unsigned>(std::stoul(line.substr(separator + 1)));
+            const auto run = std::make_shared<SortedRun>(run_path(number));
+            if (!run->load()) {
+                std::cerr << "Invalid run file: " << run_path(number) << std::endl;
+                return false;
+            }
+            loaded.push_back(RunSlot{run, number, level});
+        }
+    }
+
+    // 不在清单中的段来自中断的落盘或合并，以及合并后尚未删除的输入段
+    for (const unsigned long number: list_numbered_files(get_file_path() + ".run")) {
+        if (std::none_of(loaded.begin(), loaded.end(),
+                         [number](const RunSlot &slot) { return slot.number == number; })) {
+            std::remove(run_path(number).c_str());
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(store_mutex);
+    runs = std::move(loaded);
+    memtable.clear();
+    immutable.reset();
+    last_lsn = lsn;
+    memtable_lsn = lsn;
+    next_number = next;
+    is_open = true;
+    return true;
+}
+
+
+bool LsmStore::close_file_object() {
+    std::lock_guard<std::mutex> lock(store_mutex);
+    if (!is_open) {
+        return false;
+    }
+
+    runs.clear();
+    memtable.clear();
+    immutable.reset();
+    is_open = false;
+    return true;
+}
+
+
+bool LsmStore::write(const ItemSource &source, const std::uint64_t lsn) {
+    std::lock_guard<std::mutex> flushing(flush_mutex);
+    std::lock_guard<std::mutex> compacting(compaction_mutex);
+
+    unsigned long number;
+    {
+        std::lock_guard<std::mutex> lock(store_mutex);
+        number = next_number++;
+    }
+
+    const auto run = std::make_shared<SortedRun>(run_path(number));
+    const bool written = run->write([&source](const EntryVisitor &emit) {
+        std::string payload;
+        source([&emit, &payload](const Item &item) {
+            payload.clear();
+            append_item_payload(payload, item);
+            emit(item.code, LsmEntryType::SET, payload.data(), static_cast<uint32_t>(payload.size()));
+        });
+    });
+    if (!written) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(store_mutex);
+    std::vector<RunSlot> previous = std::move(runs);
+    runs.assign(1, RunSlot{run, number, BASE_RUN_LEVEL});
+    const std::uint64_t previous_lsn = last_lsn;
+    last_lsn = lsn;
+
+    if (!write_manifest()) {
+        run->mark_obsolete();
+        runs = std::move(previous);
+        last_lsn = previous_lsn;
+        return false;
+    }
+
+    for (auto &slot: previous) {
+        slot.run->mark_obsolete();
+    }
+    memtable.clear();
+    immutable.reset();
+    memtable_lsn = lsn;
+    is_open = true;
+    return true;
+}
+
+
+void LsmStore::apply(const Operation &operation, const std::uint64_t lsn) {
+    LsmEntry entry{LsmEntryType::SET, std::string()};
+    switch (operation.type) {
+        case OperationType::INSERT_ITEM:
+            entry.payload = operation.payload;
+            break;
+        case OperationType::UPDATE_ITEM:
+            entry.type = LsmEntryType::UPDATED;
+            entry.payload = operation.payload;
+            break;
+        case OperationType::DELETE_ITEM:
+            entry.type = LsmEntryType::DELETED;
+            break;
+    }
+
+    std::lock_guard<std::mutex> lock(store_mutex);
+    const auto found = memtable.find(operation.code);
+    if (found == memtable.end()) {
+        memtable.emplace(operation.code, std::move(entry));
+    } else {
+        fold_entry(found->second, std::move(entry));
+    }
+    memtable_lsn = std::max(memtable_lsn, lsn);
+}
+
+
+bool LsmStore::flush() {
+    std::lock_guard<std::mutex> flushing(flush_mutex);
+
+    std::shared_ptr<const std::map<int, LsmEntry>> sealed;
+    std::uint64_t lsn;
+    unsigned long number;
+    {
+        std::lock_guard<std::mutex> lock(store_mutex);
+        if (memtable.empty()) {
+            return true;
+        }
+
+        // 封存当前内存表，写出期间的新操作进入新的内存表
+        sealed = std::make_shared<std::map<int, LsmEntry>>(std::move(memtable));
+        memtable.clear();
+        immutable = sealed;
+        lsn = memtable_lsn;
+        number = next_number++;
+    }
+
+    const auto run = std::make_shared<SortedRun>(run_path(number));
+    const bool written = run->write([&sealed](const EntryVisitor &emit) {
+        for (const auto &pair: *sealed) {
+            emit(pair.first, pair.second.type, pair.second.payload.data(),
+                 static_cast<uint32_t>(pair.second.payload.size()));
+        }
+    });
+
+    std::lock_guard<std::mutex> lock(store_mutex);
+    immutable.reset();
+    if (!written) {
+        // 封存的修改放回内存表，写出期间的新操作叠加在其上
+        std::map<int, LsmEntry> restored(*sealed);
+        for (auto &pair: memtable) {
+            const auto found = restored.find(pair.first);
+            if (found == restored.end()) {
+                restored.emplace(pair.first, std::move(pair.second));
+            } else {
+                fold_entry(found->second, std::move(pair.second));
+            }
+        }
+        memtable = std::move(restored);
+        return false;
+    }
+
+    runs.insert(runs.begin(), RunSlot{run, number, 0});
+    last_lsn = std::max(last_lsn, lsn);
+    return write_manifest();
+}
+
+
+bool LsmStore::needs_compaction() const {
+    std::lock_guard<std::mutex> lock(store_mutex);
+    size_t first = 0;
+    size_t last = 0;
+    return find_compaction(first, last);
+}
+
+
+bool LsmStore::compact() {
+    std::lock_guard<std::mutex> compacting(compaction_mutex);
+
+    std::vector<RunSlot> inputs;
+    bool bottom;
+    unsigned long number;
+    {
+        std::lock_guard<std::mutex> lock(store_mutex);
+        size_t first = 0;
+        size_t last = 0;
+        if (!find_compaction(first, last)) {
+            return false;
+        }
+
+        inputs.assign(runs.begin() + static_cast<std::ptrdiff_t>(first), runs.begin() + static_cast<std::ptrdiff_t>(last));
+        bottom = last == runs.size();
+        number = next_number++;
+    }
+
+    std::vector<LayerCursor> layers;
+    layers.reserve(inputs.size());
+    for (const auto &slot: inputs) {
+        layers.emplace_back(*slot.run);
+    }
+
+    const auto output = std::make_shared<SortedRun>(run_path(number));
+    if (!output->write([&layers, bottom](const EntryVisitor &emit) { merge_layers(layers, bottom, emit); })) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(store_mutex);
+    // 合并期间新段只插入到列表前部，输入段仍然相邻
+    const auto first = std::find_if(runs.begin(), runs.end(), [&inputs](const RunSlot &slot) {
+        return slot.run == inputs.front().run;
+    });
+    const auto position = runs.erase(first, first + static_cast<std::ptrdiff_t>(inputs.size()));
+    const auto installed = runs.insert(position, RunSlot{output, number, inputs.front().level + 1});
+
+    if (!write_manifest()) {
+        runs.insert(runs.erase(installed), inputs.begin(), inputs.end());
+        output->mark_obsolete();
+        return false;
+    }
+
+    for (auto &slot: inputs) {
+        slot.run->mark_obsolete(); // 正在扫描的读者释放后删除
+    }
+    return true;
+}
+
+
+void LsmStore::scan(const ItemVisitor &visit) const {
+    std::map<int, LsmEntry> table;
+    std::shared_ptr<const std::map<int, LsmEntry>> sealed;
+    std::vector<std::shared_ptr<SortedRun>> snapshot;
+    {
+        std::lock_guard<std::mutex> lock(store_mutex);
+        table = memtable;
+        sealed = immutable;
+        for (const auto &slot: runs) {
+            snapshot.push_back(slot.run);
+        }
+    }
+
+    std::vector<LayerCursor> layers;
+    layers.reserve(snapshot.size() + 2);
+    layers.emplace_back(table);
+    if (sealed) {
+        layers.emplace_back(*sealed);
+    }
+    for (const auto &run: snapshot) {
+        layers.emplace_back(*run);
+    }
+
+    merge_layers(layers, true, [&visit](int, LsmEntryType, const char *payload, const uint32_t length) {
+        visit(parse_item_payload(payload, length));
+    });
+}
+
+
+std::uint64_t LsmStore::get_last_lsn() const {
+    std::lock_guard<std::mutex> lock(store_mutex);
+    return last_lsn;
+}
+
+
+size_t LsmStore::run_count() const {
+    std::lock_guard<std::mutex> lock(store_mutex);
+    return runs.size();
+}
+
+
+std::uint64_t LsmStore::read_lsn(const std::string &path) {
+    std::ifstream manifest(path);
+    std::string line;
+    if (!std::getline(manifest, line) || line != MANIFEST_MAGIC) {
+        return 0;
+    }
+
+    while (std::getline(manifest, line)) {
+        if (line.compare(0, 4, "LSN|") == 0) {
+            return std::stoull(line.substr(4));
+        }
+    }
+    return 0;
+}
+
+
+bool LsmStore::is_lsm(const std::string &path) {
+    std::ifstream manifest(path);
+    std::string line;
+    return std::getline(manifest, line) && line == MANIFEST_MAGIC;
+}
+
+
+void LsmStore::remove_runs(const std::string &path) {
+    for (const unsigned long number: list_numbered_files(path + ".run")) {
+        std::remove((path + ".run." + std::to_string(number)).c_str());
+    }
+}
@@ -104,12 +104,11 @@ namespace ui{
 
         // 初始化品牌信息
         item.brand_list.clear();
-        item.brand_number = 0;
 
         // 添加品牌流程
-        while(item.brand_number < MAX_NUMBER) {
+        while(item.brand_list.size() < MAX_NUMBER) {
             std::cout << std::endl
-                      << "当前品牌数：" << item.brand_number
+                      << "当前品牌数：" << item.brand_list.size()
                       << "/" << MAX_NUMBER << std::endl;
 
             const std::string answer = input_string("添加品牌？(y/n): ");
@@ -117,7 +116,6 @@ namespace ui{
 
             Brand brand = get_brand();
             item.brand_list.push_back(brand);
-            item.brand_number++;
         }
 
         item.quantity = 0;
@@ -1,10 +1,31 @@
 ﻿#include <gtest/gtest.h>
+#include <atomic>
+#include <cstdlib>
 #include <fstream>
+#include <new>
 #include "../include/engine.h"
 
 const std::string TEST_DATA_FILE = "test_data.csv";
 const std::string TEST_LOG_FILE = "test_log.csv";
 
+namespace {
+    std::atomic<unsigned long long> allocations(0); ///< 经由operator new的堆分配次数
+}
+
+// 统计堆分配次数，供加载测试断言
+void *operator new(const std::size_t size) {
+    ++allocations;
+    void *p = std::malloc(size == 0 ? 1 : size);
+    if (p == nullptr) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void operator delete(void *p) noexcept {
+    std::free(p);
+}
+
 // 测试固件类
 class EngineTest : public ::testing::Test {
 protected:
@@ -24,7 +45,7 @@ protected:
     }
 
     static Item createTestItem(int code) {
-        return {"Item" + std::to_string(code), code, "Red", 100, {}, 0};
+        return {"Item" + std::to_string(code), code, "Red", 100, {}};
     }
 
     Engine* engine = nullptr;
@@ -81,7 +102,7 @@ TEST_F(EngineTest, CacheBehavior) {
 // 测试复合查询
 TEST_F(EngineTest, ComplexQuery) {
     for(int i=10; i<20; i++) {
-        engine->insert({ "TestItem", i, "Blue", i*10, {}, 0 });
+        engine->insert({ "TestItem", i, "Blue", i*10, {} });
     }
 
     auto results = engine->select()
@@ -114,16 +135,239 @@ TEST_F(EngineTest, PersistenceRecovery) {
     EXPECT_EQ(result.size(), 1);
 }
 
+// 测试跨越检查点阈值后的持久化
+TEST_F(EngineTest, CheckpointKeepsAllItems) {
+    {
+        Engine localEngine(3, 5, TEST_LOG_FILE, TEST_DATA_FILE);
+        for (int i = 30; i < 42; i++) {
+            localEngine.insert(createTestItem(i));
+        }
+        localEngine.del(31);
+        localEngine.update({"Renamed", 40, "Green", 1, {}});
+    }
+
+    Engine newEngine(3, 5, TEST_LOG_FILE, TEST_DATA_FILE);
+    EXPECT_EQ(newEngine.select().all().size(), 11);
+    EXPECT_EQ(newEngine.select_by_code(31).size(), 0);
+    EXPECT_EQ(newEngine.select_by_code(40)[0].name, "Renamed");
+}
+
 // 测试模糊查询
 TEST_F(EngineTest, LikeQuery) {
-    engine->insert({"Apple", 20, "Red", 50, {}, 0});
-    engine->insert({"App", 21, "Green", 30, {}, 0});
-    engine->insert({"Banana", 22, "Yellow", 40, {}, 0});
+    engine->insert({"Apple", 20, "Red", 50, {}});
+    engine->insert({"App", 21, "Green", 30, {}});
+    engine->insert({"Banana", 22, "Yellow", 40, {}});
 
     auto results = engine->select_by_name_like("App");
     EXPECT_EQ(results.size(), 2);
 }
 
+// 测试槽位存储：更新移到末尾，删除与墓碑压缩不改变其余商品的扫描顺序
+TEST_F(EngineTest, ScanOrderAfterUpdateAndDelete) {
+    for (int i = 1; i <= 10; i++) {
+        engine->insert(createTestItem(i));
+    }
+    engine->update({"Updated", 3, "Blue", 1, {}});
+    for (int code : {2, 4, 5, 6, 7, 8}) {
+        engine->del(code);
+    }
+
+    std::vector<int> codes;
+    for (const auto &item : engine->select().all()) {
+        codes.push_back(item.code);
+    }
+    EXPECT_EQ(codes, std::vector<int>({1, 9, 10, 3}));
+    EXPECT_EQ(engine->select_by_code(3)[0].name, "Updated");
+    EXPECT_THROW(engine->del(5), std::out_of_range);
+}
+
+// 测试常驻槽位：名称、色调与品牌以驻留编号保存，还原后与插入时一致，墓碑压缩后品牌仍归属原商品
+TEST_F(EngineTest, ResidentItemsRoundTrip) {
+    std::vector<Item> items;
+    for (int i = 1; i <= 12; i++) {
+        Item item = createTestItem(i);
+        for (int brand = 0; brand < i % 4; ++brand) {
+            item.brand_list.push_back(Brand{"Brand" + std::to_string(brand), i * 10 + brand, brand, 0.5 * i});
+        }
+        items.push_back(item);
+        engine->insert(item);
+    }
+    items[2] = {"Renamed", 3, "Blue", 7, {Brand{"Solo", 31, 1, 9.5}}};
+    engine->update(items[2]);
+    items[3].quantity = 1;
+    engine->update(items[3]);
+    for (int code : {1, 2, 5, 6, 7, 8, 9}) {
+        EXPECT_EQ(engine->del(code), items[code - 1]);
+    }
+
+    for (int code : {3, 4, 10, 11, 12}) {
+        const auto result = engine->select_by_code(code);
+        ASSERT_EQ(result.size(), 1);
+        EXPECT_EQ(result[0], items[code - 1]);
+    }
+    EXPECT_EQ(engine->select_by_name("Renamed")[0].code, 3);
+    EXPECT_EQ(engine->select_by_name("Item4")[0], items[3]);
+    EXPECT_TRUE(engine->select_by_name("Item3").empty());
+    EXPECT_EQ(engine->select().all().size(), 5);
+}
+
+// 测试检查点：槽位按插入顺序排列，槽位索引按编码有序，写出的数据文件按编码升序
+TEST_F(EngineTest, CheckpointWritesInCodeOrder) {
+    {
+        Engine localEngine(3, 100, TEST_LOG_FILE, TEST_DATA_FILE);
+        for (int code : {7, 3, 9, 1, 5, 8, 2}) {
+            localEngine.insert(createTestItem(code));
+        }
+        localEngine.update({"Updated", 3, "Blue", 1, {}});
+        for (int code : {9, 5, 8, 2}) {
+            localEngine.del(code); // 墓碑多于有效槽位时压缩并重建槽位索引
+        }
+        localEngine.insert(createTestItem(4));
+    }
+
+    std::vector<int> codes;
+    DataFile file(TEST_DATA_FILE);
+    ASSERT_TRUE(file.open_file_object());
+    file.scan([&codes](const Item &item) { codes.push_back(item.code); });
+    file.close_file_object();
+    EXPECT_EQ(codes, std::vector<int>({1, 3, 4, 7}));
+}
+
+// 测试列式镜像：插入、更新、删除后列扫描与聚合结果与商品数据一致
+TEST_F(EngineTest, ColumnStoreMirror) {
+    for (int i = 1; i <= 6; i++) {
+        engine->insert(createTestItem(i));
+    }
+    engine->update({"Updated", 2, "Blue", 5, {Brand{"Acme", 1, 5, 2.0}}});
+    engine->update({"Updated", 3, "Blue", 7, {Brand{"Acme", 1, 3, 1.5}, Brand{"Other", 2, 4, 1.0}}});
+    for (int code : {1, 4, 5}) {
+        engine->del(code); // 失效行多于有效行时触发压缩
+    }
+
+    const ColumnStore &columns = engine->column_store();
+    EXPECT_EQ(columns.size(), 3);
+    EXPECT_EQ(columns.total_quantity(), 112);
+    EXPECT_DOUBLE_EQ(columns.stock_value(), 18.5);
+    EXPECT_EQ(columns.codes_below_quantity(10), std::vector<int>({2, 3}));
+    EXPECT_EQ(columns.codes_with_brand("Acme"), std::vector<int>({2, 3}));
+    EXPECT_TRUE(columns.codes_with_brand("Missing").empty());
+
+    const auto by_colour = columns.quantity_by_colour();
+    ASSERT_EQ(by_colour.size(), 2);
+    EXPECT_EQ(by_colour[0], std::make_pair(std::string("Red"), 100LL));
+    EXPECT_EQ(by_colour[1], std::make_pair(std::string("Blue"), 12LL));
+}
+
+// 测试批量插入：整批一次写入数据文件，不逐条追加日志
+TEST_F(EngineTest, BulkInsert) {
+    engine->insert(createTestItem(1));
+    engine->insert(createTestItem(2));
+
+    // 批内重复与已存在的编码被跳过
+    EXPECT_EQ(engine->bulk_insert({createTestItem(5), createTestItem(3), createTestItem(3), createTestItem(2),
+                                   createTestItem(4)}), 3);
+    EXPECT_EQ(engine->select_by_code(3)[0].name, "Item3");
+    EXPECT_EQ(engine->select_by_name("Item4")[0].code, 4);
+    EXPECT_EQ(std::ifstream(TEST_LOG_FILE, std::ios::ate).tellg(), 0);
+
+    // 从CSV数据文件导入
+    const std::string import_path = "test_import.csv";
+    DataFile source(import_path);
+    source.write([this](const ItemVisitor &visit) {
+        for (int i = 5; i < 8; i++) {
+            visit(createTestItem(i));
+        }
+    }, 0);
+    source.close_file_object();
+    EXPECT_EQ(engine->import_file(import_path), 2);
+    EXPECT_EQ(engine->import_file("missing.csv"), 0);
+    std::remove(import_path.c_str());
+
+    delete engine;
+    engine = new Engine(3, 5, TEST_LOG_FILE, TEST_DATA_FILE);
+    EXPECT_EQ(engine->select().all().size(), 7);
+    EXPECT_EQ(engine->select_by_code(7)[0].name, "Item7");
+}
+
+// 测试按需加载模式：只常驻目录与索引，商品从快照读入缓存
+TEST_F(EngineTest, DemandPaging) {
+    delete engine;
+    engine = nullptr;
+
+    EngineConfig config;
+    config.demand_paging = true;
+    {
+        Engine localEngine(3, 5, TEST_LOG_FILE, TEST_DATA_FILE, config);
+        for (int i = 50; i < 70; i++) {
+            localEngine.insert(createTestItem(i)); // 每5条触发一次检查点，快照随之重新映射
+        }
+        localEngine.del(55);
+        localEngine.update({"Renamed", 60, "Green", 1, {Brand{"Brand", 1, 2, 3.5}}});
+        EXPECT_THROW(localEngine.del(55), std::out_of_range);
+
+        EXPECT_EQ(localEngine.select_by_code(60)[0].name, "Renamed");
+        EXPECT_EQ(localEngine.select_by_name("Item52")[0].code, 52);
+        EXPECT_EQ(localEngine.select().all().size(), 19);
+    }
+
+    // 重新打开时只读取编码与名称，商品在访问时解码
+    Engine newEngine(3, 5, TEST_LOG_FILE, TEST_DATA_FILE, config);
+    const std::vector<Item> items = newEngine.select().all();
+    ASSERT_EQ(items.size(), 19);
+    EXPECT_EQ(items.front().code, 50);
+    EXPECT_EQ(newEngine.select_by_code(55).size(), 0);
+    EXPECT_EQ(newEngine.select_by_code(60)[0].brand_list.front().price, 3.5);
+    EXPECT_EQ(newEngine.select_by_name("Renamed")[0].code, 60);
+    EXPECT_EQ(newEngine.select().where([](const Item &item) { return item.code > 60; }).limit(3).size(), 3);
+
+    // 列式镜像在首次使用时构建，之后随修改同步
+    EXPECT_EQ(newEngine.column_store().size(), 19);
+    newEngine.del(61);
+    EXPECT_EQ(newEngine.column_store().size(), 18);
+    EXPECT_EQ(newEngine.column_store().codes_with_brand("Brand"), std::vector<int>({60}));
+
+    engine = new Engine(3, 5, TEST_LOG_FILE, TEST_DATA_FILE);
+}
+
+// 加载数据文件的堆分配次数：常驻商品、品牌与索引都从少量大块内存分配，不随商品数量增长
+TEST_F(EngineTest, LoadAllocationsDoNotGrowWithItems) {
+    const std::string data_path = "test_load_data.csv";
+    const std::string log_path = "test_load_log.csv";
+    const auto load_allocations = [&data_path, &log_path](const int count) {
+        std::remove(data_path.c_str());
+        std::remove(log_path.c_str());
+        std::list<Item> items;
+        for (int code = 0; code < count; ++code) {
+            // 名称长于短字符串优化的容量，每个商品的名称都不同
+            Item item{"Summer T-Shirt " + std::to_string(code), code, "Coral Red", code % 500, {}};
+            for (int brand = 0; brand < 1 + code % 3; ++brand) {
+                item.brand_list.push_back(Brand{"Simple Style Clothing Co. " + std::to_string(brand),
+                                                code * 3 + brand, brand, 12.5});
+            }
+            items.push_back(item);
+        }
+        DataFile file(data_path);
+        EXPECT_TRUE(file.write(items));
+        file.close_file_object();
+
+        const unsigned long long before = allocations;
+        std::unique_ptr<Engine> loaded(new Engine(3, 5, log_path, data_path));
+        const unsigned long long used = allocations - before;
+        EXPECT_EQ(loaded->select_by_code(count - 1)[0], items.back());
+        loaded.reset();
+        std::remove(data_path.c_str());
+        std::remove(log_path.c_str());
+        return used;
+    };
+
+    // 商品数量翻倍，多出的分配只来自数组与内存块的倍增及按窗口创建的解析线程
+    const int count = 20000;
+    const unsigned long long small = load_allocations(count);
+    const unsigned long long large = load_allocations(2 * count);
+    EXPECT_LT(large, static_cast<unsigned long long>(count / 20));
+    EXPECT_LT(large, small + count / 100);
+}
+
 int main(int argc, char **argv) {
     testing::InitGoogleTest(&argc, argv);
     return RUN_ALL_TESTS();
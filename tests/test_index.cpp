@@ -1,4 +1,6 @@
 ﻿#include "gtest/gtest.h"
+#include <algorithm>
+#include "../include/cache.h"
 #include "../include/index.h"
 
 class IndexTest : public ::testing::Test {
@@ -72,3 +74,68 @@ TEST_F(IndexTest, MultiCodeHandling) {
 //     ::testing::InitGoogleTest(&argc, argv);
 //     return RUN_ALL_TESTS();
 // }
+
+TEST(StringPoolTest, SharedAcrossIndexAndCache) {
+    // 同一字符串只驻留一次，编号与视图保持稳定
+    StringPool pool;
+    const std::uint32_t id = pool.intern("apple");
+    const StringRef ref = pool.view(id);
+    for (int i = 0; i < 20000; ++i) {
+        pool.intern("name" + std::to_string(i)); // 跨越多个内存块
+    }
+    EXPECT_EQ(pool.intern(std::string("apple")), id);
+    EXPECT_EQ(pool.view(id).data, ref.data);
+    EXPECT_EQ(pool.str(id), "apple");
+    pool.intern(std::string(2 * StringPool::BLOCK_SIZE, 'x'));
+    EXPECT_EQ(pool.str(pool.intern("tail")), "tail");
+
+    // 索引与缓存共用驻留池，名称不重复存放
+    Index index(pool);
+    LRUCache cache(2, pool);
+    const std::size_t before = pool.size();
+    index.insert("apple", 1);
+    cache.insert(Item{"apple", 1, "Red", 1, {}});
+    EXPECT_EQ(pool.size(), before);
+    EXPECT_EQ(index.select("apple"), 1);
+    EXPECT_EQ(cache.select("apple").code, 1);
+    EXPECT_THROW(cache.select("missing"), std::out_of_range);
+    EXPECT_FALSE(cache.del("missing"));
+    EXPECT_EQ(index.del(1), std::vector<std::string>({"apple"}));
+}
+
+// 测试驻留池回收：引用归零的字符串移除，归还的字节累积后压缩内存区域，存活编号不变
+TEST(StringPoolTest, ReleaseReclaimsUnreferencedStrings) {
+    StringPool pool;
+    const std::uint32_t kept = pool.intern("kept");
+    const std::uint32_t shared = pool.intern("shared");
+    EXPECT_EQ(pool.intern("shared"), shared);
+    pool.release(shared);
+    std::uint32_t id = 0;
+    EXPECT_TRUE(pool.find("shared", id));
+    pool.release(shared);
+    EXPECT_FALSE(pool.find("shared", id));
+    EXPECT_EQ(pool.size(), 1u);
+
+    // 反复驻留又归还的字符串不会让内存区域无限增长
+    for (int i = 0; i < 100000; ++i) {
+        pool.release(pool.intern("churn" + std::to_string(i)));
+    }
+    EXPECT_LT(pool.size_bytes(), 2 * StringPool::BLOCK_SIZE);
+    EXPECT_EQ(pool.str(kept), "kept");
+    EXPECT_TRUE(pool.find("kept", id));
+    EXPECT_EQ(id, kept);
+
+    // 索引与缓存删除或改名后归还名称
+    Index index(pool);
+    LRUCache cache(1, pool);
+    index.insert("apple", 1);
+    cache.insert(Item{"apple", 1, "Red", 1, {}});
+    cache.insert(Item{"pear", 1, "Red", 1, {}});
+    EXPECT_THROW(cache.select("apple"), std::out_of_range);
+    index.del(1);
+    EXPECT_FALSE(pool.find("apple", id));
+    cache.insert(Item{"plum", 2, "Red", 1, {}}); // 淘汰pear
+    EXPECT_FALSE(pool.find("pear", id));
+    EXPECT_TRUE(cache.del(2));
+    EXPECT_EQ(pool.size(), 1u);
+}
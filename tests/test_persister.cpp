@@ -1,6 +1,9 @@
 ﻿#include <gtest/gtest.h>
 #include <fstream>
 #include <cstdio>
+#include <iterator>
+#include <stdexcept>
+#include <thread>
 
 #include "../include/persister.h"
 
@@ -30,7 +33,7 @@ TEST_F(PersistTest, SelectEmptyList) {
 }
 
 TEST_F(PersistTest, InsertAndSelect) {
-    const Item item1 = {"夏季短袖T恤",1001,"珊瑚红",150,{Brand{"棉质世家", 2001, 80, 89.99f},Brand{"简约风", 2002, 70, 79.50f}},2};;
+    const Item item1 = {"夏季短袖T恤",1001,"珊瑚红",150,{Brand{"棉质世家", 2001, 80, 89.99f},Brand{"简约风", 2002, 70, 79.50f}}};;
     persist->insert(item1);
 
     const std::list<Item> items = persist->select();
@@ -39,10 +42,10 @@ TEST_F(PersistTest, InsertAndSelect) {
 }
 
 TEST_F(PersistTest, UpdateAndSelect) {
-    const Item item1 = {"夏季短袖T恤",1001,"珊瑚红",150,{Brand{"棉质世家", 2001, 80, 89.99f},Brand{"简约风", 2002, 70, 79.50f}},2};;
+    const Item item1 = {"夏季短袖T恤",1001,"珊瑚红",150,{Brand{"棉质世家", 2001, 80, 89.99f},Brand{"简约风", 2002, 70, 79.50f}}};;
     persist->insert(item1);
 
-    const Item item2 = {"破洞牛仔裤",1001,"水洗蓝",75,{Brand{"Levi's", 3001, 30, 399.0f},Brand{"Lee", 3002, 25, 359.0f},Brand{"七匹狼", 3003, 20, 289.0f}},3};
+    const Item item2 = {"破洞牛仔裤",1001,"水洗蓝",75,{Brand{"Levi's", 3001, 30, 399.0f},Brand{"Lee", 3002, 25, 359.0f},Brand{"七匹狼", 3003, 20, 289.0f}}};
     persist->update(item2);
 
     const std::list<Item> items = persist->select();
@@ -51,7 +54,7 @@ TEST_F(PersistTest, UpdateAndSelect) {
 }
 
 TEST_F(PersistTest, DeleteAndSelect) {
-    const Item item1 = {"夏季短袖T恤",1001,"珊瑚红",150,{Brand{"棉质世家", 2001, 80, 89.99f},Brand{"简约风", 2002, 70, 79.50f}},2};;
+    const Item item1 = {"夏季短袖T恤",1001,"珊瑚红",150,{Brand{"棉质世家", 2001, 80, 89.99f},Brand{"简约风", 2002, 70, 79.50f}}};;
     persist->insert(item1);
 
     persist->del(1001);
@@ -61,10 +64,10 @@ TEST_F(PersistTest, DeleteAndSelect) {
 }
 
 TEST_F(PersistTest, FlushAndSelect) {
-    const Item item1 = {"夏季短袖T恤",1001,"珊瑚红",150,{Brand{"棉质世家", 2001, 80, 89.99f},Brand{"简约风", 2002, 70, 79.50f}},2};;
+    const Item item1 = {"夏季短袖T恤",1001,"珊瑚红",150,{Brand{"棉质世家", 2001, 80, 89.99f},Brand{"简约风", 2002, 70, 79.50f}}};;
     persist->insert(item1);
 
-    const Item item2 = {"破洞牛仔裤",2005,"水洗蓝",75,{Brand{"Levi's", 3001, 30, 399.0f},Brand{"Lee", 3002, 25, 359.0f},Brand{"七匹狼", 3003, 20, 289.0f}},3};
+    const Item item2 = {"破洞牛仔裤",2005,"水洗蓝",75,{Brand{"Levi's", 3001, 30, 399.0f},Brand{"Lee", 3002, 25, 359.0f},Brand{"七匹狼", 3003, 20, 289.0f}}};
     persist->insert(item2);
 
     persist->flush();
@@ -76,8 +79,34 @@ TEST_F(PersistTest, FlushAndSelect) {
     EXPECT_EQ(*it, item2);
 }
 
+TEST_F(PersistTest, FlushWritesInCodeOrder) {
+    persist->insert(Item{"Item30", 30, "Red", 1, {}});
+    persist->insert(Item{"Item10", 10, "Red", 1, {}});
+    persist->insert(Item{"Item20", 20, "Red", 1, {}});
+    persist->flush();
+
+    // 重放按编码查找，数据文件直接按编码升序写出
+    persist->update(Item{"Item10", 10, "Blue", 2, {}});
+    persist->del(20);
+    persist->insert(Item{"Item5", 5, "Red", 1, {}});
+    persist->update(Item{"Missing", 15, "Red", 1, {}});
+    persist->flush();
+
+    DataFile file(data_file_path);
+    file.open_file_object();
+    const std::list<Item> items = file.read();
+    file.close_file_object();
+
+    ASSERT_EQ(items.size(), 3);
+    auto it = items.begin();
+    EXPECT_EQ((it++)->code, 5);
+    EXPECT_EQ(it->code, 10);
+    EXPECT_EQ((it++)->colour, "Blue");
+    EXPECT_EQ(it->code, 30);
+}
+
 TEST_F(PersistTest, CloseAndReopenSelect) {
-    const Item item1 = {"夏季短袖T恤",1001,"珊瑚红",150,{Brand{"棉质世家", 2001, 80, 89.99f},Brand{"简约风", 2002, 70, 79.50f}},2};;
+    const Item item1 = {"夏季短袖T恤",1001,"珊瑚红",150,{Brand{"棉质世家", 2001, 80, 89.99f},Brand{"简约风", 2002, 70, 79.50f}}};;
     persist->insert(item1);
 
     persist->close();
@@ -88,6 +117,449 @@ TEST_F(PersistTest, CloseAndReopenSelect) {
     EXPECT_EQ(items.front().code, item1.code);
 }
 
+TEST_F(PersistTest, BinaryLogReplay) {
+    std::remove("test_binary_operations.txt");
+    PersistConfig config;
+    config.log_format = LogFormat::BINARY;
+
+    const Item item1 = {"夏季短袖T恤",1001,"珊瑚红",150,{Brand{"棉质世家", 2001, 80, 89.99f},Brand{"简约风", 2002, 70, 79.50f}}};
+    const Item item2 = {"破洞牛仔裤",1001,"水洗蓝",75,{Brand{"Levi's", 3001, 30, 399.0f}}};
+    const Item item3 = {"羊毛围巾",1003,"驼色",12,{}};
+    {
+        Persist binary(data_file_path, "test_binary_operations.txt", 10, config);
+        binary.insert(item1);
+        binary.update(item2);
+        binary.insert(item3);
+        binary.del(1003);
+        ASSERT_EQ(binary.select().size(), 1);
+    }
+
+    Persist reopened(data_file_path, "test_binary_operations.txt", 10, config);
+    const std::list<Item> items = reopened.select();
+    ASSERT_EQ(items.size(), 1);
+    EXPECT_EQ(items.front(), item2);
+
+    reopened.close();
+    std::remove("test_binary_operations.txt");
+}
+
+TEST_F(PersistTest, CorruptedLogIsNotDiscarded) {
+    const std::string log_path = "test_corrupted_operations.txt";
+    std::remove(log_path.c_str());
+    std::streamoff damaged;
+    {
+        OperationFile log(log_path, LogFormat::BINARY);
+        ASSERT_TRUE(log.open_file_object());
+        for (int code = 1; code <= 3; ++code) {
+            log.append(Operation{OperationType::INSERT_ITEM, code, "ITEM|Item" + std::to_string(code) + ",1,Red,10", 0});
+        }
+        damaged = log.offsets()[1] + 20;
+    }
+    std::fstream raw(log_path, std::ios::in | std::ios::out | std::ios::binary);
+    raw.seekp(damaged);
+    raw.write("#", 1);
+    raw.close();
+    const auto length = std::ifstream(log_path, std::ios::ate | std::ios::binary).tellg();
+
+    // 读取与合并都报错，日志不被清空，损坏之后的记录仍留在文件中
+    PersistConfig config;
+    config.log_format = LogFormat::BINARY;
+    Persist damaged_persist(data_file_path, log_path, 10, config);
+    EXPECT_THROW(damaged_persist.select(), std::runtime_error);
+    EXPECT_THROW(damaged_persist.flush(), std::runtime_error);
+    EXPECT_FALSE(damaged_persist.close());
+    EXPECT_EQ(std::ifstream(log_path, std::ios::ate | std::ios::binary).tellg(), length);
+
+    std::remove(log_path.c_str());
+}
+
+TEST_F(PersistTest, SnapshotDataFormat) {
+    const Item item1 = {"夏季短袖T恤",1001,"珊瑚红",150,{Brand{"棉质世家", 2001, 80, 89.99f},Brand{"简约风", 2002, 70, 79.50f}}};
+    persist->insert(item1);
+    persist->close();
+    delete persist;
+
+    // 现有CSV数据文件在下一次刷新时转换为二进制快照
+    PersistConfig config;
+    config.data_format = DataFormat::SNAPSHOT;
+    persist = new Persist(data_file_path, operation_file_path, 10, config);
+
+    const Item item2 = {"羊毛围巾",1003,"驼色",12,{}};
+    persist->insert(item2);
+    persist->flush();
+    EXPECT_TRUE(SnapshotFile::is_snapshot(data_file_path));
+
+    const std::list<Item> items = persist->select();
+    ASSERT_EQ(items.size(), 2);
+    EXPECT_EQ(items.front(), item1);
+    EXPECT_EQ(items.back(), item2);
+}
+
+TEST_F(PersistTest, PagedDataFormat) {
+    persist->close();
+    delete persist;
+
+    PersistConfig config;
+    config.data_format = DataFormat::PAGED;
+    config.page_size = 512;
+    persist = new Persist(data_file_path, operation_file_path, 1000, config);
+    for (int code = 1; code <= 100; ++code) {
+        persist->insert(Item{"Item" + std::to_string(code), code, "Red", code, {}});
+    }
+    persist->flush();
+    ASSERT_TRUE(PagedFile::is_paged(data_file_path));
+
+    // 之后的刷新只改写受影响的页
+    persist->update(Item{"Changed", 50, "Blue", 1, {Brand{"Brand", 1, 1, 2.5}}});
+    persist->del(60);
+    persist->insert(Item{"New", 500, "Green", 1, {}});
+    persist->update(Item{"Missing", 700, "Green", 1, {}});
+    persist->flush();
+
+    persist->close();
+    delete persist;
+    persist = new Persist(data_file_path, operation_file_path, 1000, config);
+    const std::list<Item> items = persist->select();
+    ASSERT_EQ(items.size(), 100);
+    EXPECT_EQ(std::next(items.begin(), 49)->name, "Changed");
+    EXPECT_EQ(std::next(items.begin(), 49)->brand_number(), 1);
+    EXPECT_EQ(std::next(items.begin(), 59)->code, 61);
+    EXPECT_EQ(items.back().code, 500);
+}
+
+TEST_F(PersistTest, LsmDataFormat) {
+    const Item existing = {"羊毛围巾",1003,"驼色",12,{}};
+    persist->insert(existing);
+    persist->flush();
+    persist->close();
+    delete persist;
+
+    // 已有的CSV数据文件转换为基础段，之后每次检查点只写出内存表
+    PersistConfig config;
+    config.data_format = DataFormat::LSM;
+    config.background_checkpoint = false;
+    config.lsm_fanout = 2;
+    persist = new Persist(data_file_path, operation_file_path, 5, config);
+    ASSERT_TRUE(LsmStore::is_lsm(data_file_path));
+    for (int code = 1; code <= 20; ++code) {
+        persist->insert(Item{"Item" + std::to_string(code), code, "Red", code, {}});
+    }
+    persist->update(Item{"Changed", 7, "Blue", 1, {Brand{"Brand", 1, 1, 2.5}}});
+    persist->del(8);
+    persist->update(Item{"Missing", 700, "Green", 1, {}});
+
+    std::list<Item> items = persist->select();
+    ASSERT_EQ(items.size(), 20);
+    EXPECT_EQ(std::next(items.begin(), 6)->name, "Changed");
+    EXPECT_EQ(std::next(items.begin(), 7)->code, 9);
+    EXPECT_EQ(items.back(), existing);
+
+    // 重新打开时日志中尚未写成段的操作重放进内存表
+    persist->close();
+    delete persist;
+    persist = new Persist(data_file_path, operation_file_path, 5, config);
+    EXPECT_EQ(persist->select(), items);
+
+    // 换回CSV格式时段文件随清单一起被替换
+    persist->close();
+    delete persist;
+    persist = new Persist(data_file_path, operation_file_path, 5);
+    persist->insert(Item{"New", 2000, "Green", 1, {}});
+    persist->flush();
+    EXPECT_FALSE(LsmStore::is_lsm(data_file_path));
+    items.push_back(Item{"New", 2000, "Green", 1, {}});
+    EXPECT_EQ(persist->select(), items);
+}
+
+TEST_F(PersistTest, ShardedDataFiles) {
+    const Item existing = {"羊毛围巾",1003,"驼色",12,{}};
+    persist->insert(existing);
+    persist->close();
+    delete persist;
+
+    // 未分片的数据文件与日志迁移到各分片后删除
+    PersistConfig config;
+    config.shards = 3;
+    config.background_checkpoint = false;
+    persist = new Persist(data_file_path, operation_file_path, 5, config);
+    EXPECT_FALSE(std::ifstream(data_file_path).good());
+    EXPECT_FALSE(std::ifstream(operation_file_path).good());
+    for (int index = 0; index < 3; ++index) {
+        // 分片数据文件记录原日志的序列号，原有记录不会在分片上再次重放
+        DataFile shard(data_file_path + ".shard" + std::to_string(index));
+        shard.open_file_object();
+        EXPECT_EQ(shard.read_lsn(), 1);
+        shard.close_file_object();
+    }
+    for (int code = 1; code <= 20; ++code) {
+        persist->insert(Item{"Item" + std::to_string(code), code, "Red", code, {}});
+    }
+    persist->update(Item{"Changed", 7, "Blue", 1, {}});
+    persist->del(8);
+
+    std::list<Item> items = persist->select();
+    ASSERT_EQ(items.size(), 20);
+    EXPECT_EQ(std::next(items.begin(), 6)->name, "Changed");
+    EXPECT_EQ(std::next(items.begin(), 7)->code, 9);
+    EXPECT_EQ(items.back(), existing);
+
+    // 各分片只写出属于自己的商品，重新打开后归并结果不变；并行检查点只遍历一次数据来源
+    int passes = 0;
+    persist->set_state_source([&items, &passes](const ItemVisitor &visit) {
+        ++passes;
+        for (const auto &item: items) {
+            visit(item);
+        }
+    });
+    EXPECT_GT(persist->flush(), 0);
+    EXPECT_EQ(passes, 1);
+    EXPECT_FALSE(persist->has_pending_log());
+    persist->close();
+    delete persist;
+    persist = new Persist(data_file_path, operation_file_path, 5, config);
+    EXPECT_EQ(persist->select(), items);
+
+    // 区间分片：边界数量必须为分片数减一
+    persist->close();
+    delete persist;
+    const std::string range_data = data_file_path + ".range";
+    const std::string range_log = operation_file_path + ".range";
+    config.shard_scheme = ShardScheme::RANGE;
+    EXPECT_THROW(Persist(range_data, range_log, 5, config), std::invalid_argument);
+    config.shard_bounds = {10, 1000};
+    persist = new Persist(range_data, range_log, 5, config);
+    for (const auto &item: items) {
+        persist->insert(item);
+    }
+    persist->close();
+    delete persist;
+
+    // 编码9在第一个分片，编码1003在最后一个分片
+    int last_code = 0;
+    DataFile first(range_data + ".shard0");
+    first.open_file_object();
+    first.scan([&last_code](const Item &item) { last_code = item.code; });
+    first.close_file_object();
+    EXPECT_EQ(last_code, 9);
+    persist = new Persist(range_data, range_log, 5, config);
+    EXPECT_EQ(persist->select(), items);
+    persist->close();
+
+    for (std::size_t index = 0; index < 3; ++index) {
+        for (const auto &path: {data_file_path, operation_file_path, range_data, range_log}) {
+            std::remove((path + ".shard" + std::to_string(index)).c_str());
+        }
+    }
+}
+
+TEST_F(PersistTest, CheckpointFromStateSource) {
+    std::list<Item> state = {{"羊毛围巾",1003,"驼色",12,{}}};
+    persist->set_state_source([&state](const ItemVisitor &visit) {
+        for (const auto &item: state) {
+            visit(item);
+        }
+    });
+
+    // 没有任何修改时检查点不写数据文件
+    std::remove(data_file_path.c_str());
+    persist->checkpoint();
+    EXPECT_FALSE(std::ifstream(data_file_path).good());
+
+    // 检查点写出的是内存状态，而不是数据文件与日志的合并结果
+    const Item item1 = {"夏季短袖T恤",1001,"珊瑚红",150,{Brand{"棉质世家", 2001, 80, 89.99f}}};
+    persist->insert(item1);
+    state.push_front(item1);
+    EXPECT_EQ(persist->checkpoint(), 1);
+
+    persist->set_state_source(nullptr);
+    const std::list<Item> items = persist->select();
+    ASSERT_EQ(items.size(), 2);
+    EXPECT_EQ(items.front(), item1);
+    EXPECT_EQ(items.back().code, 1003);
+}
+
+TEST_F(PersistTest, StateSourceThresholdCheckpointRunsInBackground) {
+    // 默认配置启用后台检查点：注册内存数据来源后达到阈值时写入方也只轮转日志，不读取内存状态、不等待合并
+    Persist background(data_file_path, "test_state_background_operations.txt", 3);
+    std::list<Item> state;
+    int state_reads = 0;
+    background.set_state_source([&state, &state_reads](const ItemVisitor &visit) {
+        ++state_reads;
+        for (const auto &item: state) {
+            visit(item);
+        }
+    });
+    for (int code = 1; code <= 7; ++code) {
+        state.push_back(Item{"Item" + std::to_string(code), code, "Red", code, {}});
+        ASSERT_TRUE(background.insert(state.back()));
+    }
+    EXPECT_EQ(state_reads, 0);
+    EXPECT_EQ(background.select().size(), 7);
+
+    // 显式检查点写出内存状态并丢弃全部日志
+    background.checkpoint();
+    EXPECT_EQ(state_reads, 1);
+    EXPECT_FALSE(std::ifstream("test_state_background_operations.txt.1").good());
+
+    DataFile file(data_file_path);
+    file.open_file_object();
+    int count = 0;
+    file.scan([&count](const Item &) { ++count; });
+    file.close_file_object();
+    EXPECT_EQ(count, 7);
+
+    background.close();
+    std::remove("test_state_background_operations.txt");
+}
+
+TEST_F(PersistTest, BackgroundCheckpoint) {
+    PersistConfig config;
+    config.max_checkpoint_lag = 2;
+    Persist background(data_file_path, "test_background_operations.txt", 3, config);
+
+    // 达到阈值后日志被轮转，后台线程合并封存段，前台持续追加
+    for (int code = 1; code <= 25; ++code) {
+        ASSERT_TRUE(background.insert(Item{"Item" + std::to_string(code), code, "Red", code, {}}));
+    }
+    background.del(7);
+
+    const std::list<Item> items = background.select();
+    ASSERT_EQ(items.size(), 24);
+    EXPECT_EQ(items.front().code, 1);
+    EXPECT_EQ(items.back().code, 25);
+
+    // select()不等待后台合并；关闭时合并全部封存段
+    background.close();
+    EXPECT_FALSE(std::ifstream("test_background_operations.txt.1").good());
+    std::remove("test_background_operations.txt");
+}
+
+TEST_F(PersistTest, RecoverySkipsAppliedRecords) {
+    persist->insert(Item{"Item1", 1, "Red", 10, {}});
+    persist->update(Item{"Item1", 1, "Red", 20, {}});
+    persist->flush(); // 数据文件记录LSN 2
+    persist->close();
+    delete persist;
+
+    // 模拟数据文件已写入、日志尚未清空时崩溃：日志中仍有已合并的记录
+    std::ofstream log(operation_file_path, std::ios::trunc);
+    log << "[insert]@1\nITEM|Item1,1,Red,10\n\n";
+    log << "[update]@2\nITEM|Item1,1,Red,20\n\n";
+    log << "[insert]@3\nITEM|Item2,2,Blue,5\n\n";
+    log.close();
+
+    persist = new Persist(data_file_path, operation_file_path, 10);
+    const std::list<Item> items = persist->select();
+    ASSERT_EQ(items.size(), 2); // 只重放LSN 3
+    EXPECT_EQ(items.front().quantity, 20);
+    EXPECT_EQ(items.back().code, 2);
+
+    // 新记录的序列号接在已有记录之后
+    persist->del(2);
+    std::ifstream reopened(operation_file_path);
+    const std::string content((std::istreambuf_iterator<char>(reopened)), std::istreambuf_iterator<char>());
+    EXPECT_NE(content.find("[delete]2@4"), std::string::npos);
+}
+
+TEST_F(PersistTest, GroupCommitDurability) {
+    const std::string group_path = "test_group_operations.txt";
+    std::remove(group_path.c_str());
+
+    PersistConfig config;
+    config.durability = Durability::GROUP;
+    config.group_commit_records = 100;
+    config.group_commit_interval_us = 1000;
+    Persist group(data_file_path, group_path, 100, config);
+
+    // 未攒满一组时由后台线程在等待超时后提交
+    group.insert(Item{"Item1", 1, "Red", 1, {}});
+    group.insert(Item{"Item2", 2, "Red", 2, {}});
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+    std::ifstream log(group_path, std::ios::binary);
+    const std::string content((std::istreambuf_iterator<char>(log)), std::istreambuf_iterator<char>());
+    EXPECT_NE(content.find("ITEM|Item2"), std::string::npos);
+    log.close();
+
+    group.close();
+    Persist reopened(data_file_path, group_path, 100);
+    EXPECT_EQ(reopened.select().size(), 2);
+    reopened.close();
+    std::remove(group_path.c_str());
+}
+
+TEST_F(PersistTest, ScanOverlaysLog) {
+    for (const DataFormat format: {DataFormat::CSV, DataFormat::SNAPSHOT}) {
+        persist->close();
+        delete persist;
+        std::remove(data_file_path.c_str());
+        std::remove(operation_file_path.c_str());
+
+        PersistConfig config;
+        config.data_format = format;
+        persist = new Persist(data_file_path, operation_file_path, 100, config);
+        for (int code = 1; code <= 5; ++code) {
+            persist->insert(Item{"Item" + std::to_string(code), code * 10, "Red", code, {}});
+        }
+        persist->flush();
+
+        // 日志中的插入、更新、删除在扫描时叠加到数据文件上
+        persist->insert(Item{"New", 5, "Blue", 1, {Brand{"B", 1, 1, 1.5}}});
+        persist->insert(Item{"New", 35, "Blue", 1, {}});
+        persist->update(Item{"Changed", 20, "Green", 7, {}});
+        persist->del(30);
+        persist->update(Item{"Missing", 99, "Green", 7, {}}); // 更新不存在的商品不产生效果
+        persist->insert(Item{"Last", 60, "Blue", 1, {}});
+        persist->del(60);
+        persist->insert(Item{"Last", 70, "Blue", 1, {}});
+
+        std::vector<int> codes;
+        persist->scan([&codes](const Item &item) { codes.push_back(item.code); });
+        EXPECT_EQ(codes, (std::vector<int>{5, 10, 20, 35, 40, 50, 70}));
+
+        const std::list<Item> items = persist->select();
+        ASSERT_EQ(items.size(), 7);
+        EXPECT_EQ(items.front().brand_number(), 1);
+        EXPECT_EQ(std::next(items.begin(), 2)->name, "Changed");
+    }
+}
+
+TEST_F(PersistTest, CompactedReplay) {
+    const std::string compact_path = "test_compact_operations.txt";
+    std::remove(compact_path.c_str());
+
+    PersistConfig config;
+    config.compact_sealed_segments = true;
+    {
+        Persist compacting(data_file_path, compact_path, 8, config);
+
+        // 盘点时同一商品被反复更新，合并前压缩为每个商品一条有效记录
+        compacting.insert(Item{"Item1", 1, "Red", 0, {}});
+        compacting.insert(Item{"Item2", 2, "Red", 0, {}});
+        for (int quantity = 1; quantity <= 20; ++quantity) {
+            compacting.update(Item{"Item1", 1, "Red", quantity, {}});
+        }
+        compacting.del(2);
+        compacting.insert(Item{"Item2", 2, "Blue", 5, {}});
+        compacting.insert(Item{"Item3", 3, "Red", 1, {}});
+        compacting.del(3);
+
+        const std::list<Item> items = compacting.select();
+        ASSERT_EQ(items.size(), 2);
+        EXPECT_EQ(items.front().quantity, 20);
+        EXPECT_EQ(items.back().colour, "Blue");
+    }
+
+    Persist reopened(data_file_path, compact_path, 8);
+    const std::list<Item> items = reopened.select();
+    ASSERT_EQ(items.size(), 2);
+    EXPECT_EQ(items.front().quantity, 20);
+    EXPECT_EQ(items.back().colour, "Blue");
+
+    reopened.close();
+    std::remove(compact_path.c_str());
+}
+
 // int main(int argc, char* argv[]) {
 //     ::testing::InitGoogleTest(&argc, argv);
 //     return RUN_ALL_TESTS();
@@ -1,7 +1,67 @@
 ﻿#include <gtest/gtest.h>
+#include <cstdint>
 #include <cstdio>
+#include <fstream>
+#include <stdexcept>
+#include "../include/region.h"
 #include "../include/storage.h"
 
+// 测试品牌容器：上限内存放在对象内部，超出上限整体迁入堆上，复制与移动保持内容
+TEST(BrandListTest, InlineAndSpill) {
+    BrandList brands{Brand{"Brand0", 0, 0, 1.5}};
+    const int inline_capacity = static_cast<int>(BrandList::INLINE_CAPACITY);
+    for (int i = 1; i < inline_capacity; ++i) {
+        brands.emplace_back("Brand" + std::to_string(i), i, i, 1.5);
+    }
+    const Brand *inline_data = brands.data();
+    BrandList copy = brands;
+    EXPECT_EQ(copy, brands);
+
+    for (int i = inline_capacity; i <= MAX_NUMBER; ++i) {
+        brands.push_back(Brand{"Extra" + std::to_string(i), i, 1, 2.5});
+    }
+    ASSERT_EQ(brands.size(), MAX_NUMBER + 1);
+    EXPECT_NE(brands.data(), inline_data);
+    EXPECT_EQ(brands.front().name, "Brand0");
+    EXPECT_EQ(brands.back().name, "Extra" + std::to_string(MAX_NUMBER));
+    EXPECT_NE(copy, brands);
+
+    BrandList moved = std::move(brands);
+    EXPECT_EQ(moved.size(), MAX_NUMBER + 1);
+    EXPECT_TRUE(brands.empty());
+    copy = moved;
+    EXPECT_EQ(copy, moved);
+
+    moved.clear();
+    moved.push_back(Brand{"Again", 1, 1, 1.0});
+    EXPECT_EQ(moved.size(), 1);
+    EXPECT_EQ(moved.begin()->name, "Again");
+}
+
+// 测试区域分配器：容器节点从少量大块中分配，对齐正确，释放后整体归还
+TEST(RegionTest, AllocatorBackedContainers) {
+    Region region(256);
+    std::list<Item, RegionAllocator<Item>> items{RegionAllocator<Item>(region)};
+    for (int code = 0; code < 1000; ++code) {
+        items.push_back(Item{"Item" + std::to_string(code), code, "Red", code, {}});
+    }
+    EXPECT_EQ(items.back().code, 999);
+    EXPECT_LT(region.block_count(), 20u);
+    for (const auto &item: items) {
+        EXPECT_EQ(reinterpret_cast<std::uintptr_t>(&item) % alignof(Item), 0u);
+    }
+
+    void *large = region.allocate(2 * Region::MAX_BLOCK_SIZE, 8);
+    ASSERT_NE(large, nullptr);
+    items.push_back(Item{"After", 1000, "Red", 1, {}}); // 超大分配之后当前块继续可用
+    EXPECT_EQ(items.size(), 1001u);
+
+    items.clear();
+    region.release();
+    EXPECT_EQ(region.block_count(), 0u);
+    EXPECT_EQ(region.size_bytes(), 0u);
+}
+
 // 测试基类 BaseFile
 TEST(BaseFileTest, FileLifecycle) {
     BaseFile file("test.txt");
@@ -20,11 +80,9 @@ TEST(WriteDataFileTest, WriteItems) {
 
     std::list<Item> items;
     items.emplace_back(Item{"Item1", 1, "Red", 10});
-    items.back().brand_number = 1;
     items.back().brand_list.emplace_back(Brand{"Brand1", 101, 5, 9.99});
 
     items.emplace_back(Item{"Item2", 2, "Blue", 20});
-    items.back().brand_number = 2;
     items.back().brand_list.emplace_back(Brand{"Brand2", 102, 10, 12.99});
     items.back().brand_list.emplace_back(Brand{"Brand3", 103, 15, 14.99});
 
@@ -60,6 +118,103 @@ TEST(ReadDataFileTest, ReadItems) {
     std::remove("test.txt");
 }
 
+TEST(DataFileTest, ParallelReadMatchesSequential) {
+    std::list<Item> items;
+    for (int code = 1; code <= 500; ++code) {
+        Item item{"Item" + std::to_string(code), code, "Red", code, {}};
+        for (int brand = 0; brand < code % 4; ++brand) {
+            item.brand_list.push_back(Brand{"Brand" + std::to_string(brand), brand, code, 1.5f});
+        }
+        items.push_back(item);
+    }
+
+    DataFile file("test.txt");
+    ASSERT_TRUE(file.write(items, 42));
+    ASSERT_EQ(file.read_lsn(), 42);
+
+    // 切分为多个区段并行解析，结果应与单线程逐行解析一致
+    const std::list<Item> sequential = file.read(1);
+    for (const unsigned int workers: {2u, 3u, 8u}) {
+        const std::list<Item> parallel = file.read(workers);
+        ASSERT_EQ(parallel.size(), items.size());
+        EXPECT_TRUE(parallel == sequential);
+        EXPECT_TRUE(parallel == items);
+    }
+
+    file.close_file_object();
+    std::remove("test.txt");
+}
+
+TEST(DataFileTest, ScanAcrossWindows) {
+    std::list<Item> items;
+    for (int code = 1; code <= 40000; ++code) {
+        Item item{"Item" + std::to_string(code), code, "Red", code, {}};
+        for (int brand = 0; brand < code % 4; ++brand) {
+            item.brand_list.push_back(Brand{"Brand" + std::to_string(brand), brand, code, 1.5f});
+        }
+        items.push_back(item);
+    }
+
+    DataFile file("test.txt");
+    ASSERT_TRUE(file.write(items, 7));
+
+    // 文件大于单个读取窗口，跨窗口的商品及其品牌行不能被拆开或遗漏
+    for (const unsigned int workers: {1u, 2u, 0u}) {
+        std::list<Item> scanned;
+        ASSERT_TRUE(file.scan([&scanned](const Item &item) { scanned.push_back(item); }, workers));
+        ASSERT_EQ(scanned.size(), items.size());
+        EXPECT_TRUE(scanned == items);
+    }
+    EXPECT_EQ(file.read_lsn(), 7);
+
+    file.close_file_object();
+    std::remove("test.txt");
+}
+
+TEST(DataFileTest, QuotedFieldsAndPrices) {
+    const std::list<Item> items = {
+        {"Shirt, \"Summer\"", 1, "Red,Blue", 10, {Brand{"A \"B\", C", 11, 5, 9.99}}},
+        {"Scarf", 2, "\"Grey\"", 20, {Brand{"D", 21, 1, 1234567.891}, Brand{"E", 22, 2, 0.1 + 0.2}}},
+    };
+
+    DataFile file("test.txt");
+    ASSERT_TRUE(file.write(items));
+
+    // 带引号的字段可包含逗号与转义引号，价格按double精度往返
+    const std::list<Item> result = file.read();
+    EXPECT_TRUE(result == items);
+
+    file.close_file_object();
+    std::remove("test.txt");
+}
+
+TEST(DataFileTest, AtomicReplace) {
+    std::remove("test.txt");
+    DataFile file("test.txt");
+    ASSERT_TRUE(file.write(std::list<Item>{{"Item1", 1, "Red", 10, {}}}, 1));
+
+#ifndef _WIN32
+    // 写入前已打开的读者继续看到完整的上一代内容
+    std::ifstream reader("test.txt");
+    ASSERT_TRUE(file.write(std::list<Item>{{"Item2", 2, "Blue", 20, {}}}, 2));
+    std::string line;
+    std::getline(reader, line);
+    EXPECT_EQ(line, "LSN|1");
+    reader.close();
+#else
+    ASSERT_TRUE(file.write(std::list<Item>{{"Item2", 2, "Blue", 20, {}}}, 2));
+#endif
+    EXPECT_FALSE(std::ifstream("test.txt.tmp").good());
+
+    EXPECT_EQ(file.read_lsn(), 2);
+    const std::list<Item> items = file.read();
+    ASSERT_EQ(items.size(), 1);
+    EXPECT_EQ(items.front().code, 2);
+
+    file.close_file_object();
+    std::remove("test.txt");
+}
+
 // 测试OperationFile类
 TEST(OperationFileTest, AppendPop) {
     OperationFile file("log.txt");
@@ -91,6 +246,392 @@ TEST(OperationFileTest, Clear) {
     std::remove("log.txt");
 }
 
+TEST(OperationFileTest, SizeTracksRecords) {
+    std::remove("log.txt");
+    {
+        OperationFile file("log.txt");
+        ASSERT_TRUE(file.open_file_object());
+
+        file.append("[insert]\nITEM|Item1,1,Red,10\nBRAND|Brand1,101,5,9.99\n");
+        file.append("[delete]1\n");
+        ASSERT_EQ(file.size(), 2);
+        ASSERT_EQ(file.offsets().size(), 2);
+        ASSERT_EQ(file.offsets()[1], file.length() - 11);
+    }
+
+    // 重新打开后计数与偏移应与写入时一致
+    OperationFile file("log.txt");
+    ASSERT_TRUE(file.open_file_object());
+    ASSERT_EQ(file.size(), 2);
+    ASSERT_EQ(file.offsets()[0], 0);
+
+    file.clear();
+    ASSERT_EQ(file.size(), 0);
+    ASSERT_EQ(file.length(), 0);
+
+    file.close_file_object();
+    std::remove("log.txt");
+}
+
+TEST(OperationFileTest, RotateSegments) {
+    std::remove("log.txt");
+    OperationFile file("log.txt");
+    ASSERT_TRUE(file.open_file_object());
+
+    file.append("[delete]1");
+    ASSERT_TRUE(file.rotate());
+    file.append("[delete]2");
+    ASSERT_TRUE(file.rotate());
+    file.append("[delete]3");
+
+    // 轮转只重命名活动日志段，原路径上是新的空日志段
+    ASSERT_EQ(file.size(), 1);
+    const std::vector<std::string> segments = file.sealed_segments();
+    ASSERT_EQ(segments.size(), 2);
+    EXPECT_EQ(segments[0], "log.txt.1");
+    EXPECT_EQ(segments[1], "log.txt.2");
+
+    // 重新打开后能识别已有的封存段
+    file.close_file_object();
+    ASSERT_TRUE(file.open_file_object());
+    ASSERT_EQ(file.sealed_segments().size(), 2);
+
+    file.remove_sealed(1);
+    EXPECT_FALSE(std::ifstream("log.txt.1").good());
+    ASSERT_EQ(file.sealed_segments().size(), 1);
+    EXPECT_EQ(file.sealed_segments().front(), "log.txt.2");
+
+    EXPECT_EQ(file.pop(), "[delete]3");
+    EXPECT_EQ(file.length(), 0);
+
+    file.remove_sealed(1);
+    file.close_file_object();
+    std::remove("log.txt");
+}
+
+TEST(OperationFileTest, BinaryAppendRead) {
+    std::remove("log.bin");
+    OperationFile file("log.bin", LogFormat::BINARY);
+    ASSERT_TRUE(file.open_file_object());
+    ASSERT_EQ(file.get_format(), LogFormat::BINARY);
+
+    ASSERT_TRUE(file.append(Operation{OperationType::INSERT_ITEM, 1, "ITEM|Item1,1,Red,10\nBRAND|Brand1,101,5,9.99", 0}));
+    ASSERT_TRUE(file.append(Operation{OperationType::DELETE_ITEM, 1, "", 0}));
+    ASSERT_FALSE(file.append("Operation 1")); // 二进制日志不接受原始文本行
+    ASSERT_EQ(file.size(), 2);
+
+    const std::list<Operation> operations = file.read_operations();
+    ASSERT_EQ(operations.size(), 2);
+    EXPECT_EQ(operations.front().type, OperationType::INSERT_ITEM);
+    EXPECT_EQ(operations.front().code, 1);
+    EXPECT_EQ(operations.front().payload, "ITEM|Item1,1,Red,10\nBRAND|Brand1,101,5,9.99");
+    EXPECT_EQ(operations.back().type, OperationType::DELETE_ITEM);
+
+    EXPECT_EQ(file.pop(), "[delete]1@2");
+    EXPECT_EQ(file.size(), 1);
+
+    file.close_file_object();
+    std::remove("log.bin");
+}
+
+TEST(OperationFileTest, BinaryTornTail) {
+    std::remove("log.bin");
+    std::streamoff length;
+    {
+        OperationFile file("log.bin", LogFormat::BINARY);
+        ASSERT_TRUE(file.open_file_object());
+        file.append(Operation{OperationType::INSERT_ITEM, 1, "ITEM|Item1,1,Red,10", 0});
+        file.append(Operation{OperationType::INSERT_ITEM, 2, "ITEM|Item2,2,Blue,20", 0});
+        length = file.length();
+    }
+
+    // 模拟最后一条记录只写入了一半
+    std::fstream raw("log.bin", std::ios::in | std::ios::out | std::ios::binary);
+    raw.seekp(length - 3);
+    raw.write("\xFF\xFF\xFF", 3);
+    raw.close();
+
+    OperationFile file("log.bin", LogFormat::BINARY);
+    ASSERT_TRUE(file.open_file_object());
+    ASSERT_EQ(file.size(), 1);
+
+    const std::list<Operation> operations = file.read_operations();
+    ASSERT_EQ(operations.size(), 1);
+    EXPECT_EQ(operations.front().code, 1);
+
+    // 截断后可以继续正常追加
+    ASSERT_TRUE(file.append(Operation{OperationType::DELETE_ITEM, 1, "", 0}));
+    EXPECT_EQ(file.read_operations().size(), 2);
+
+    file.close_file_object();
+    std::remove("log.bin");
+}
+
+TEST(OperationFileTest, SyncDurability) {
+    std::remove("log.bin");
+    std::remove("log.bin.1");
+    OperationFile file("log.bin", LogFormat::BINARY);
+    ASSERT_TRUE(file.open_file_object());
+    file.set_durability(Durability::SYNC, 1, 0);
+
+    // 每条记录写入并同步成功后才计入偏移表与文件长度
+    for (int code = 1; code <= 3; ++code) {
+        ASSERT_TRUE(file.append(Operation{OperationType::DELETE_ITEM, code, "", 0}));
+        EXPECT_EQ(file.size(), code);
+        EXPECT_EQ(std::ifstream("log.bin", std::ios::ate | std::ios::binary).tellg(), file.length());
+    }
+
+    // 轮转后同步的是新的活动日志
+    ASSERT_TRUE(file.rotate());
+    ASSERT_TRUE(file.append(Operation{OperationType::DELETE_ITEM, 4, "", 0}));
+    EXPECT_EQ(file.read_operations().size(), 1);
+
+    file.close_file_object();
+    std::remove("log.bin");
+    std::remove("log.bin.1");
+}
+
+TEST(OperationFileTest, BinaryMidLogCorruption) {
+    std::remove("log.bin");
+    std::vector<std::streamoff> offsets;
+    std::streamoff length;
+    {
+        OperationFile file("log.bin", LogFormat::BINARY);
+        ASSERT_TRUE(file.open_file_object());
+        for (int code = 1; code <= 4; ++code) {
+            file.append(Operation{OperationType::INSERT_ITEM, code, "ITEM|Item" + std::to_string(code) + ",1,Red,10", 0});
+        }
+        offsets = file.offsets();
+        length = file.length();
+    }
+
+    // 第二条记录的负载损坏：打开时只校验最后一帧，读取时报错而不是丢弃其后的两条记录
+    std::fstream raw("log.bin", std::ios::in | std::ios::out | std::ios::binary);
+    raw.seekp(offsets[1] + 20);
+    raw.write("#", 1);
+    raw.close();
+    {
+        OperationFile file("log.bin", LogFormat::BINARY);
+        ASSERT_TRUE(file.open_file_object());
+        EXPECT_EQ(file.size(), 4);
+        try {
+            file.read_operations();
+            FAIL() << "corrupted record was skipped";
+        } catch (const std::runtime_error &error) {
+            EXPECT_NE(std::string(error.what()).find("LSN gap after 1 up to 3"), std::string::npos);
+        }
+    }
+
+    // 第二条记录的长度前缀损坏：其后仍有完整的记录，打开失败且不截断文件
+    raw.open("log.bin", std::ios::in | std::ios::out | std::ios::binary);
+    raw.seekp(offsets[1]);
+    raw.write("\xFF\xFF\x00\x00", 4);
+    raw.close();
+    {
+        OperationFile file("log.bin", LogFormat::BINARY);
+        EXPECT_THROW(file.open_file_object(), std::runtime_error);
+    }
+    EXPECT_EQ(std::ifstream("log.bin", std::ios::ate | std::ios::binary).tellg(), length);
+
+    std::remove("log.bin");
+}
+
+TEST(OperationFileTest, RewriteKeepsLsn) {
+    for (const LogFormat format: {LogFormat::TEXT, LogFormat::BINARY}) {
+        std::remove("log.bin");
+        OperationFile file("log.bin", format);
+        ASSERT_TRUE(file.open_file_object());
+        file.append(Operation{OperationType::INSERT_ITEM, 1, "ITEM|Item1,1,Red,10", 0});
+        file.append(Operation{OperationType::UPDATE_ITEM, 1, "ITEM|Item1,1,Red,20", 0});
+        file.append(Operation{OperationType::DELETE_ITEM, 2, "", 0});
+
+        // 改写后记录保留原序列号，索引按新内容重建，之后继续追加
+        ASSERT_TRUE(file.rewrite({Operation{OperationType::INSERT_ITEM, 1, "ITEM|Item1,1,Red,20", 2},
+                                  Operation{OperationType::DELETE_ITEM, 2, "", 3}}));
+        ASSERT_EQ(file.size(), 2);
+        ASSERT_TRUE(file.append(Operation{OperationType::DELETE_ITEM, 1, "", 0}));
+        file.close_file_object();
+
+        ASSERT_TRUE(file.open_file_object());
+        EXPECT_EQ(file.get_format(), format);
+        const std::list<Operation> operations = file.read_operations();
+        ASSERT_EQ(operations.size(), 3);
+        EXPECT_EQ(operations.front().payload, "ITEM|Item1,1,Red,20");
+        EXPECT_EQ(operations.front().lsn, 2);
+        EXPECT_EQ(operations.back().lsn, 4);
+        EXPECT_FALSE(std::ifstream("log.bin.tmp").good());
+
+        file.close_file_object();
+    }
+    std::remove("log.bin");
+}
+
+// 测试SnapshotFile类
+TEST(SnapshotFileTest, WriteReadConvert) {
+    std::list<Item> items;
+    items.emplace_back(Item{"Item1", 1, "Red", 10});
+    items.back().brand_list.emplace_back(Brand{"Brand1", 101, 5, 9.5});
+    items.emplace_back(Item{"Item 2", 2, "Red", 20});
+    items.back().brand_list.emplace_back(Brand{"Brand1", 102, 10, 12.5});
+    items.back().brand_list.emplace_back(Brand{"Brand\"3", 103, 15, 14.25});
+    items.emplace_back(Item{"Item3", 3, "Blue", 0, {}});
+
+    SnapshotFile snapshot("test.snap");
+    ASSERT_TRUE(snapshot.write(items));
+    ASSERT_TRUE(SnapshotFile::is_snapshot("test.snap"));
+    ASSERT_EQ(snapshot.read(), items);
+
+    // 快照 -> CSV -> 快照 往返转换后内容不变
+    ASSERT_TRUE(SnapshotFile::convert_to_csv("test.snap", "test.csv"));
+    ASSERT_FALSE(SnapshotFile::is_snapshot("test.csv"));
+    ASSERT_TRUE(SnapshotFile::convert_from_csv("test.csv", "test2.snap"));
+    ASSERT_EQ(SnapshotFile("test2.snap").read(), items);
+
+    std::remove("test.snap");
+    std::remove("test2.snap");
+    std::remove("test.csv");
+}
+
+// 测试PagedFile类
+TEST(PagedFileTest, WriteApplyScan) {
+    std::remove("test.pages");
+    std::list<Item> items;
+    for (int code = 1; code <= 200; ++code) {
+        items.push_back(Item{"Item" + std::to_string(code), code, "Red", code, {Brand{"Brand", code, 1, 2.5}}});
+    }
+
+    PagedFile file("test.pages", 512);
+    ASSERT_TRUE(file.write([&items](const ItemVisitor &visit) {
+        for (const auto &item: items) {
+            visit(item);
+        }
+    }, 7));
+    ASSERT_TRUE(PagedFile::is_paged("test.pages"));
+    const std::uint32_t pages = file.get_page_count();
+    EXPECT_GT(pages, 10u);
+    EXPECT_EQ(file.get_last_lsn(), 7u);
+
+    // 只改写包含变化商品的页与文件头；单页放不下的商品占用追加的连续页
+    Item updated{"Changed", 100, "Blue", 1, {}};
+    Item inserted{"New", 1000, "Green", 5, {}};
+    Item large{"Large", 500, "Black", 1, {}};
+    for (int i = 0; i < 40; ++i) {
+        large.brand_list.push_back(Brand{"Brand" + std::to_string(i), i, i, 1.25});
+    }
+    ASSERT_TRUE(file.apply({{100, &updated}, {150, nullptr}, {500, &large}, {1000, &inserted}}, 9));
+    EXPECT_LE(file.get_written_pages(), 10u);
+    EXPECT_TRUE(file.contains(500));
+    EXPECT_FALSE(file.contains(150));
+
+    // 重新打开后由页头重建目录；按编码升序读出
+    file.close_file_object();
+    ASSERT_TRUE(file.open_file_object());
+    EXPECT_EQ(file.get_last_lsn(), 9u);
+    EXPECT_TRUE(file.contains(1000));
+
+    MappedFile image;
+    ASSERT_TRUE(image.map("test.pages"));
+    EXPECT_EQ(PagedFile::read_lsn(image), 9u);
+    std::vector<Item> result;
+    ASSERT_TRUE(PagedFile::scan(image, [&result](const Item &item) { result.push_back(item); }));
+    image.unmap();
+
+    ASSERT_EQ(result.size(), 201);
+    EXPECT_EQ(result.front(), items.front());
+    EXPECT_EQ(result[99], updated);
+    EXPECT_EQ(result[199], large);
+    EXPECT_EQ(result.back(), inserted);
+
+    // 删除连续页中的商品后，释放的页留给普通记录使用，不再增加页数
+    ASSERT_TRUE(file.apply({{500, nullptr}}, 10));
+    const std::uint32_t grown = file.get_page_count();
+    std::vector<Item> extra;
+    for (int code = 2000; code < 2010; ++code) {
+        extra.push_back(Item{"Extra", code, "Red", 1, {}});
+    }
+    std::map<int, const Item *> changes;
+    for (const auto &item: extra) {
+        changes[item.code] = &item;
+    }
+    ASSERT_TRUE(file.apply(changes, 11));
+    EXPECT_EQ(file.get_page_count(), grown);
+
+    // 不完整的重做日志被丢弃，数据文件保持不变
+    file.close_file_object();
+    std::ofstream("test.pages.journal") << "IMSJRNL1 torn";
+    ASSERT_TRUE(file.open_file_object());
+    EXPECT_FALSE(std::ifstream("test.pages.journal").good());
+    EXPECT_EQ(file.get_last_lsn(), 11u);
+
+    file.close_file_object();
+    std::remove("test.pages");
+}
+
+TEST(LsmStoreTest, FlushCompactScan) {
+    std::remove("test.lsm");
+    LsmStore::remove_runs("test.lsm");
+    EXPECT_FALSE(LsmStore("test.lsm").open_file_object()); // 不创建缺失的清单
+
+    const auto payload = [](const Item &item) {
+        std::string text = "ITEM|" + item.name + "," + std::to_string(item.code) + "," + item.colour + "," +
+                           std::to_string(item.quantity);
+        return text;
+    };
+
+    LsmStore store("test.lsm", 2);
+    ASSERT_TRUE(store.write([](const ItemVisitor &visit) {
+        for (int code = 1; code <= 10; ++code) {
+            visit(Item{"Base", code, "Red", code, {}});
+        }
+    }, 5));
+    EXPECT_EQ(store.run_count(), 1u);
+
+    // 每次落盘产生一个新段，不改写已有的段
+    store.apply(Operation{OperationType::UPDATE_ITEM, 3, payload(Item{"Changed", 3, "Blue", 30, {}}), 6}, 6);
+    store.apply(Operation{OperationType::DELETE_ITEM, 4, std::string(), 7}, 7);
+    ASSERT_TRUE(store.flush());
+    store.apply(Operation{OperationType::INSERT_ITEM, 20, payload(Item{"New", 20, "Green", 1, {}}), 8}, 8);
+    store.apply(Operation{OperationType::UPDATE_ITEM, 30, payload(Item{"Missing", 30, "Green", 1, {}}), 9}, 9);
+    store.apply(Operation{OperationType::DELETE_ITEM, 20, std::string(), 10}, 10);
+    store.apply(Operation{OperationType::INSERT_ITEM, 20, payload(Item{"Again", 20, "Green", 2, {}}), 11}, 11);
+    ASSERT_TRUE(store.flush());
+    EXPECT_EQ(store.run_count(), 3u);
+    EXPECT_EQ(store.get_last_lsn(), 11u);
+
+    // 第0层的两个段合并为第1层的一个段，基础段不参与
+    EXPECT_TRUE(store.needs_compaction());
+    ASSERT_TRUE(store.compact());
+    EXPECT_FALSE(store.needs_compaction());
+    EXPECT_EQ(store.run_count(), 2u);
+
+    store.apply(Operation{OperationType::UPDATE_ITEM, 5, payload(Item{"Memtable", 5, "Black", 50, {}}), 12}, 12);
+    std::vector<Item> result;
+    store.scan([&result](const Item &item) { result.push_back(item); });
+    ASSERT_EQ(result.size(), 10u);
+    EXPECT_EQ(result[2].name, "Changed");
+    EXPECT_EQ(result[3].code, 5);
+    EXPECT_EQ(result[3].name, "Memtable");
+    EXPECT_EQ(result.back().name, "Again");
+
+    // 重新打开后内存表中未落盘的修改不再存在，段文件与序列号保留；遗留的段文件被删除
+    std::ofstream("test.lsm.run.99") << "orphan";
+    store.close_file_object();
+    LsmStore reopened("test.lsm", 2);
+    ASSERT_TRUE(reopened.open_file_object());
+    EXPECT_FALSE(std::ifstream("test.lsm.run.99").good());
+    EXPECT_EQ(reopened.get_last_lsn(), 11u);
+    EXPECT_EQ(LsmStore::read_lsn("test.lsm"), 11u);
+
+    result.clear();
+    reopened.scan([&result](const Item &item) { result.push_back(item); });
+    ASSERT_EQ(result.size(), 10u);
+    EXPECT_EQ(result[3].name, "Base");
+
+    reopened.close_file_object();
+    LsmStore::remove_runs("test.lsm");
+    std::remove("test.lsm");
+}
+
 // int main(int argc, char* argv[]) {
 //     ::testing::InitGoogleTest(&argc, argv);
 //     return RUN_ALL_TESTS();